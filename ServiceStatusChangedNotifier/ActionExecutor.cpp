@@ -0,0 +1,794 @@
+/*
+   ActionExecutor.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(_WIN32)
+#include <Windows.h> // Windows headers first
+#elif defined(__linux__)
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "ActionExecutor.h"
+
+#include "MonotonicClock.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <stop_token>
+#include <thread>
+
+#if defined(__linux__)
+extern char **environ;
+#endif
+
+namespace {
+
+constexpr auto kReadSlice{std::chrono::milliseconds(100)}; // (Stop() checks)
+constexpr auto kSpawnRetryDelay{std::chrono::milliseconds(1000)};
+constexpr auto kExitGracePeriod{std::chrono::milliseconds(100)};
+
+// AppendNumber
+template <typename Number>
+void AppendNumber(std::string &text, const Number number) {
+  std::array<char, 24> digits{}; // (Any 64-bit integer)
+  const auto [end, error]{
+      std::to_chars(digits.data(), digits.data() + digits.size(), number)};
+  if (error == std::errc{}) {
+    text.append(digits.data(), end);
+  }
+}
+
+#if defined(_WIN32)
+
+std::wstring Utf8ToWide(const std::string_view utf8) {
+  std::wstring wide(
+      MultiByteToWideChar(CP_UTF8, 0, utf8.data(),
+                          static_cast<int>(utf8.size()), nullptr, 0),
+      L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.size()),
+                      wide.data(), static_cast<int>(wide.size()));
+  return wide;
+}
+
+// AppendQuotedArgument
+// CommandLineToArgvW rules: backslashes are literal unless they precede a
+// quote.
+void AppendQuotedArgument(std::wstring &command_line,
+                          const std::wstring &argument) {
+  if (!command_line.empty()) {
+    command_line += L' ';
+  }
+  if (!argument.empty() &&
+      argument.find_first_of(L" \t\"") == std::wstring::npos) {
+    command_line += argument;
+    return;
+  }
+  command_line += L'"';
+  std::size_t backslashes{0};
+  for (const auto character : argument) {
+    if (character == L'\\') {
+      ++backslashes;
+      continue;
+    }
+    command_line.append(character == L'"' ? backslashes * 2 + 1 : backslashes,
+                        L'\\');
+    command_line += character;
+    backslashes = 0;
+  }
+  command_line.append(backslashes * 2, L'\\');
+  command_line += L'"';
+}
+
+#endif
+
+} // namespace
+
+// WorkerSlot
+class ActionExecutor::WorkerSlot final {
+public:
+  explicit WorkerSlot(ActionExecutor &action_executor)
+      : action_executor_{action_executor} {}
+  ~WorkerSlot() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  WorkerSlot(const WorkerSlot &) = delete;
+  WorkerSlot &operator=(const WorkerSlot &) = delete;
+
+  // Delete move constructor and move assignment operator
+  WorkerSlot(WorkerSlot &&) = delete;
+  WorkerSlot &operator=(WorkerSlot &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start the worker process (pre-started) and its feeding thread. Returns
+  // false if the process could not be started (the thread keeps trying).
+  bool Start() {
+    const bool spawned{Spawn()};
+    thread_ = std::jthread(
+        [this](const std::stop_token &stop_token) { Run(stop_token); });
+    return spawned;
+  }
+
+  void RequestStop() noexcept { thread_.request_stop(); }
+
+  void Stop() noexcept {
+    if (thread_.joinable()) {
+      thread_.request_stop();
+      thread_.join();
+    }
+    Close(false);
+  }
+
+private:
+  void Run(const std::stop_token &stop_token) noexcept;
+
+  // Read and report answers until the whole batch is answered; false if the
+  // worker had to be closed.
+  bool CollectAnswers(const std::stop_token &stop_token,
+                      std::vector<PendingAction> &batch) noexcept;
+
+  // (Platform specific:)
+  bool Spawn() noexcept;
+  void Close(bool kill) noexcept;
+  [[nodiscard]] bool IsOpen() const noexcept;
+  bool Write(std::string_view data) noexcept;
+  // Bytes read (0: timed out; -1: the worker is gone).
+  std::ptrdiff_t Read(char *buffer, std::size_t size,
+                      std::chrono::milliseconds timeout) noexcept;
+
+  ActionExecutor &action_executor_;
+  std::size_t actions_since_start_{0};
+  std::string input_{}; // (Answer bytes not yet parsed)
+
+#if defined(_WIN32)
+  HANDLE process_{nullptr};
+  HANDLE stdin_write_{nullptr};
+  HANDLE stdout_read_{nullptr}; // (Overlapped named pipe)
+  HANDLE read_event_{nullptr};
+#elif defined(__linux__)
+  pid_t pid_{-1};
+  int socket_{-1}; // (The worker's stdin and stdout)
+#endif
+
+  std::jthread thread_{}; // (Last: joined first on destruction)
+};
+
+// Run
+// The feeding thread: take a batch, write it, collect its answers; restart
+// the worker when it is gone (or due for recycling).
+void ActionExecutor::WorkerSlot::Run(
+    const std::stop_token &stop_token) noexcept {
+  const ActionExecutorOptions &options{action_executor_.options_};
+  std::vector<PendingAction> batch;
+  std::string request;
+
+  while (!stop_token.stop_requested()) {
+    if (!IsOpen() && !Spawn()) {
+      std::unique_lock lock(action_executor_.mutex_);
+      action_executor_.condition_.wait_for(lock, stop_token, kSpawnRetryDelay,
+                                           [] { return false; });
+      continue;
+    }
+
+    batch.clear();
+    {
+      std::unique_lock lock(action_executor_.mutex_);
+      if (!action_executor_.condition_.wait(lock, stop_token, [this] {
+            return !action_executor_.queue_.empty();
+          })) {
+        break; // (Stop())
+      }
+      auto count{std::min(std::max<std::size_t>(options.batch_size, 1),
+                          action_executor_.queue_.size())};
+      if (options.max_actions_per_worker != 0) {
+        count = std::min(count, options.max_actions_per_worker -
+                                    actions_since_start_);
+      }
+      try {
+        for (std::size_t index{0}; index < count; ++index) {
+          batch.push_back(std::move(action_executor_.queue_.front()));
+          action_executor_.queue_.pop_front();
+        }
+      } catch (...) {
+        // (Out of memory: send what was taken.)
+      }
+    }
+    if (batch.empty()) {
+      continue;
+    }
+    actions_since_start_ += batch.size();
+    action_executor_.batches_.fetch_add(1, std::memory_order_relaxed);
+
+    request.clear();
+    bool written{false};
+    try {
+      for (const auto &pending_action : batch) {
+        AppendNumber(request, pending_action.id);
+        request += '\t';
+        AppendNumber(request, pending_action.current_state);
+        request += '\t';
+        request += pending_action.service_name;
+        request += '\n';
+      }
+      written = Write(request); // <-- BATCH
+    } catch (...) {
+    }
+    if (!written) {
+      for (const auto &pending_action : batch) {
+        action_executor_.Report(pending_action, ActionOutcome::kCrashed, -1);
+      }
+      Close(true);
+      continue;
+    }
+
+    if (CollectAnswers(stop_token, batch) &&
+        options.max_actions_per_worker != 0 &&
+        actions_since_start_ >= options.max_actions_per_worker) {
+      Close(false); // (Recycle)
+    }
+  }
+}
+
+// CollectAnswers
+bool ActionExecutor::WorkerSlot::CollectAnswers(
+    const std::stop_token &stop_token,
+    std::vector<PendingAction> &batch) noexcept {
+  const auto timeout{action_executor_.options_.action_timeout};
+  auto unanswered{batch.size()};
+  auto deadline{std::chrono::steady_clock::now() + timeout};
+  std::array<char, 4096> buffer{};
+
+  while (unanswered != 0) {
+    const auto now{std::chrono::steady_clock::now()};
+    ActionOutcome failure{ActionOutcome::kCrashed};
+    std::ptrdiff_t size{0};
+    if (stop_token.stop_requested()) {
+      failure = ActionOutcome::kCancelled;
+      size = -1;
+    } else if (now >= deadline) {
+      failure = ActionOutcome::kTimedOut;
+      size = -1;
+    } else {
+      size = Read(buffer.data(), buffer.size(),
+                  std::min(kReadSlice,
+                           std::chrono::ceil<std::chrono::milliseconds>(
+                               deadline - now)));
+    }
+
+    if (size < 0) { // (Gone, hung or stopping)
+      Close(true);
+      bool blamed{failure == ActionOutcome::kCancelled};
+      for (auto pending_action{batch.rbegin()}; pending_action != batch.rend();
+           ++pending_action) {
+        if (pending_action->id == 0) {
+          continue;
+        }
+        if (--unanswered == 0 && !blamed) {
+          action_executor_.Report(*pending_action, failure, -1); // (Oldest)
+          continue;
+        }
+        if (failure != ActionOutcome::kCancelled) {
+          try {
+            const std::scoped_lock lock(action_executor_.mutex_);
+            action_executor_.queue_.push_front(std::move(*pending_action));
+            continue; // (Again, on any worker)
+          } catch (...) {
+            // (Out of memory: reported below.)
+          }
+        }
+        action_executor_.Report(*pending_action, failure, -1);
+      }
+      action_executor_.condition_.notify_all();
+      return false;
+    }
+
+    try {
+      input_.append(buffer.data(), static_cast<std::size_t>(size));
+    } catch (...) {
+      continue;
+    }
+    std::size_t line_start{0};
+    for (auto line_end{input_.find('\n')}; line_end != std::string::npos;
+         line_end = input_.find('\n', line_start)) {
+      // <id> TAB <status>
+      const char *const first{input_.data() + line_start};
+      const char *const last{input_.data() + line_end};
+      line_start = line_end + 1;
+      std::uint64_t id{0};
+      int status{0};
+      const auto [id_end, id_error]{std::from_chars(first, last, id)};
+      if (id_error != std::errc{} || id_end == last || *id_end != '\t' ||
+          std::from_chars(id_end + 1, last, status).ec != std::errc{}) {
+        continue; // (Not an answer: ignored.)
+      }
+      if (const auto found{std::ranges::find(batch, id, &PendingAction::id)};
+          id != 0 && found != batch.end()) {
+        action_executor_.Report(*found,
+                                status == 0 ? ActionOutcome::kSucceeded
+                                            : ActionOutcome::kFailed,
+                                status);
+        found->id = 0; // (Answered)
+        --unanswered;
+        deadline = std::chrono::steady_clock::now() + timeout;
+      }
+    }
+    input_.erase(0, line_start);
+  }
+  return true;
+}
+
+#if defined(_WIN32)
+
+// Spawn
+// stdin: an anonymous pipe; stdout: a named pipe opened for overlapped reads
+// (so a read can time out). Only the two child ends are inherited
+// (PROC_THREAD_ATTRIBUTE_HANDLE_LIST), so a worker never holds another
+// worker's pipe open.
+bool ActionExecutor::WorkerSlot::Spawn() noexcept {
+  Close(true);
+  input_.clear();
+  actions_since_start_ = 0;
+
+  try {
+    static std::atomic<std::uint64_t> pipe_counter{0};
+    const std::wstring pipe_name{
+        L"\\\\.\\pipe\\ServiceStatusChangedNotifier-" +
+        std::to_wstring(GetCurrentProcessId()) + L"-" +
+        std::to_wstring(pipe_counter.fetch_add(1))};
+
+    SECURITY_ATTRIBUTES inheritable{sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
+    HANDLE stdin_read{nullptr};
+    if (!CreatePipe(&stdin_read, &stdin_write_, &inheritable, 64 * 1024)) {
+      stdin_write_ = nullptr;
+      return false;
+    }
+    SetHandleInformation(stdin_write_, HANDLE_FLAG_INHERIT, 0);
+
+    stdout_read_ = CreateNamedPipeW(
+        pipe_name.c_str(),
+        PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED |
+            FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, 64 * 1024,
+        64 * 1024, 0, nullptr);
+    const HANDLE stdout_write{
+        stdout_read_ == INVALID_HANDLE_VALUE
+            ? INVALID_HANDLE_VALUE
+            : CreateFileW(pipe_name.c_str(), GENERIC_WRITE, 0, &inheritable,
+                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)};
+    if (stdout_read_ == INVALID_HANDLE_VALUE) {
+      stdout_read_ = nullptr;
+    }
+    read_event_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    bool created{false};
+    if (stdout_read_ && stdout_write != INVALID_HANDLE_VALUE && read_event_) {
+      std::wstring command_line;
+      for (const auto &argument : action_executor_.options_.command) {
+        AppendQuotedArgument(command_line, Utf8ToWide(argument));
+      }
+
+      SIZE_T attribute_list_size{0};
+      InitializeProcThreadAttributeList(nullptr, 1, 0, &attribute_list_size);
+      std::vector<std::byte> attribute_list_buffer(attribute_list_size);
+      const auto attribute_list{reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(
+          attribute_list_buffer.data())};
+      HANDLE inherited_handles[]{stdin_read, stdout_write};
+      if (InitializeProcThreadAttributeList(attribute_list, 1, 0,
+                                            &attribute_list_size)) {
+        STARTUPINFOEXW startup_info{};
+        startup_info.StartupInfo.cb = sizeof(STARTUPINFOEXW);
+        startup_info.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+        startup_info.StartupInfo.hStdInput = stdin_read;
+        startup_info.StartupInfo.hStdOutput = stdout_write;
+        startup_info.StartupInfo.hStdError = nullptr;
+        startup_info.lpAttributeList = attribute_list;
+
+        PROCESS_INFORMATION process_information{};
+        created =
+            UpdateProcThreadAttribute(attribute_list, 0,
+                                      PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
+                                      inherited_handles,
+                                      sizeof(inherited_handles), nullptr,
+                                      nullptr) &&
+            CreateProcessW(nullptr, command_line.data(), nullptr, nullptr,
+                           TRUE,
+                           EXTENDED_STARTUPINFO_PRESENT | CREATE_NO_WINDOW,
+                           nullptr, nullptr, &startup_info.StartupInfo,
+                           &process_information);
+        DeleteProcThreadAttributeList(attribute_list);
+        if (created) {
+          CloseHandle(process_information.hThread);
+          process_ = process_information.hProcess;
+        }
+      }
+    }
+
+    CloseHandle(stdin_read); // (The child's ends: the child holds them now.)
+    if (stdout_write != INVALID_HANDLE_VALUE) {
+      CloseHandle(stdout_write);
+    }
+    if (!created) {
+      Close(true);
+      return false;
+    }
+  } catch (...) {
+    Close(true);
+    return false;
+  }
+
+  action_executor_.worker_starts_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+// Close
+void ActionExecutor::WorkerSlot::Close(const bool kill) noexcept {
+  if (process_ && kill) {
+    TerminateProcess(process_, 1);
+  }
+  if (stdin_write_) {
+    CloseHandle(stdin_write_); // (EOF: a well-behaved worker exits.)
+    stdin_write_ = nullptr;
+  }
+  if (process_) {
+    if (WaitForSingleObject(process_, static_cast<DWORD>(
+                                          kExitGracePeriod.count())) !=
+        WAIT_OBJECT_0) {
+      TerminateProcess(process_, 1);
+      WaitForSingleObject(process_, INFINITE);
+    }
+    CloseHandle(process_);
+    process_ = nullptr;
+  }
+  for (HANDLE *const handle : {&stdout_read_, &read_event_}) {
+    if (*handle) {
+      CloseHandle(*handle);
+      *handle = nullptr;
+    }
+  }
+}
+
+// IsOpen
+bool ActionExecutor::WorkerSlot::IsOpen() const noexcept {
+  return process_ != nullptr;
+}
+
+// Write
+bool ActionExecutor::WorkerSlot::Write(std::string_view data) noexcept {
+  while (!data.empty()) {
+    DWORD written{0};
+    if (!WriteFile(stdin_write_, data.data(), static_cast<DWORD>(data.size()),
+                   &written, nullptr)) {
+      return false;
+    }
+    data.remove_prefix(written);
+  }
+  return true;
+}
+
+// Read
+std::ptrdiff_t ActionExecutor::WorkerSlot::Read(
+    char *const buffer, const std::size_t size,
+    const std::chrono::milliseconds timeout) noexcept {
+  OVERLAPPED overlapped{};
+  overlapped.hEvent = read_event_;
+  ResetEvent(read_event_);
+  DWORD bytes_read{0};
+  if (!ReadFile(stdout_read_, buffer, static_cast<DWORD>(size), nullptr,
+                &overlapped)) {
+    if (GetLastError() != ERROR_IO_PENDING) {
+      return -1; // (ERROR_BROKEN_PIPE: the worker exited)
+    }
+    if (WaitForSingleObject(read_event_, static_cast<DWORD>(timeout.count())) !=
+        WAIT_OBJECT_0) {
+      CancelIoEx(stdout_read_, &overlapped);
+      return GetOverlappedResult(stdout_read_, &overlapped, &bytes_read, TRUE)
+                 ? static_cast<std::ptrdiff_t>(bytes_read)
+                 : 0; // (ERROR_OPERATION_ABORTED: timed out)
+    }
+  }
+  if (!GetOverlappedResult(stdout_read_, &overlapped, &bytes_read, FALSE)) {
+    return -1;
+  }
+  return static_cast<std::ptrdiff_t>(bytes_read);
+}
+
+#elif defined(__linux__)
+
+// Spawn
+// One Unix socket pair: the worker's end becomes its stdin and stdout (the
+// executor's end is close-on-exec, so no worker inherits another's).
+bool ActionExecutor::WorkerSlot::Spawn() noexcept {
+  Close(true);
+  input_.clear();
+  actions_since_start_ = 0;
+
+  const auto &command{action_executor_.options_.command};
+  if (command.empty()) {
+    return false;
+  }
+  int sockets[2]{-1, -1};
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0) {
+    return false;
+  }
+
+  bool spawned{false};
+  try {
+    std::vector<char *> arguments;
+    for (const auto &argument : command) {
+      arguments.push_back(const_cast<char *>(argument.c_str()));
+    }
+    arguments.push_back(nullptr);
+
+    posix_spawn_file_actions_t file_actions;
+    if (posix_spawn_file_actions_init(&file_actions) == 0) {
+      spawned = posix_spawn_file_actions_adddup2(&file_actions, sockets[1],
+                                                 STDIN_FILENO) == 0 &&
+                posix_spawn_file_actions_adddup2(&file_actions, sockets[1],
+                                                 STDOUT_FILENO) == 0 &&
+                posix_spawnp(&pid_, arguments[0], &file_actions, nullptr,
+                             arguments.data(), environ) == 0; // (PATH)
+      posix_spawn_file_actions_destroy(&file_actions);
+    }
+  } catch (...) {
+  }
+
+  close(sockets[1]); // (The worker's end)
+  if (!spawned) {
+    pid_ = -1;
+    close(sockets[0]);
+    return false;
+  }
+  socket_ = sockets[0];
+  action_executor_.worker_starts_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+// Close
+void ActionExecutor::WorkerSlot::Close(const bool kill) noexcept {
+  if (pid_ > 0 && kill) {
+    ::kill(pid_, SIGKILL);
+  }
+  if (socket_ >= 0) {
+    close(socket_); // (EOF: a well-behaved worker exits.)
+    socket_ = -1;
+  }
+  if (pid_ > 0) {
+    const auto deadline{std::chrono::steady_clock::now() + kExitGracePeriod};
+    while (waitpid(pid_, nullptr, WNOHANG) == 0) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        ::kill(pid_, SIGKILL);
+        waitpid(pid_, nullptr, 0);
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    pid_ = -1;
+  }
+}
+
+// IsOpen
+bool ActionExecutor::WorkerSlot::IsOpen() const noexcept { return pid_ > 0; }
+
+// Write
+// (MSG_NOSIGNAL: a dead worker is an error, not SIGPIPE.)
+bool ActionExecutor::WorkerSlot::Write(std::string_view data) noexcept {
+  while (!data.empty()) {
+    const auto written{send(socket_, data.data(), data.size(), MSG_NOSIGNAL)};
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data.remove_prefix(static_cast<std::size_t>(written));
+  }
+  return true;
+}
+
+// Read
+std::ptrdiff_t ActionExecutor::WorkerSlot::Read(
+    char *const buffer, const std::size_t size,
+    const std::chrono::milliseconds timeout) noexcept {
+  pollfd poll_fd{socket_, POLLIN, 0};
+  const int ready{poll(&poll_fd, 1, static_cast<int>(timeout.count()))};
+  if (ready == 0 || (ready < 0 && errno == EINTR)) {
+    return 0;
+  }
+  if (ready < 0) {
+    return -1;
+  }
+  const auto size_read{recv(socket_, buffer, size, 0)};
+  if (size_read < 0 && errno == EINTR) {
+    return 0;
+  }
+  return size_read > 0 ? size_read : -1; // (0: EOF, the worker exited)
+}
+
+#else
+
+bool ActionExecutor::WorkerSlot::Spawn() noexcept { return false; }
+void ActionExecutor::WorkerSlot::Close(bool) noexcept {}
+bool ActionExecutor::WorkerSlot::IsOpen() const noexcept { return false; }
+bool ActionExecutor::WorkerSlot::Write(std::string_view) noexcept {
+  return false;
+}
+std::ptrdiff_t
+ActionExecutor::WorkerSlot::Read(char *, std::size_t,
+                                 std::chrono::milliseconds) noexcept {
+  return -1;
+}
+
+#endif
+
+// ActionExecutor
+ActionExecutor::ActionExecutor() = default;
+
+// ~ActionExecutor
+ActionExecutor::~ActionExecutor() { Stop(); }
+
+// Start
+bool ActionExecutor::Start(const ActionExecutorOptions &options,
+                           const ResultFunction &result_function) {
+  Stop();
+
+  options_ = options;
+  result_function_ = result_function;
+  {
+    const std::scoped_lock lock(mutex_);
+    running_ = true;
+  }
+
+  bool any_started{false};
+  const auto worker_count{std::max<std::size_t>(options.worker_count, 1)};
+  for (std::size_t index{0}; index < worker_count; ++index) {
+    any_started |=
+        worker_slots_.emplace_back(std::make_unique<WorkerSlot>(*this))
+            ->Start();
+  }
+  if (!any_started) {
+    Stop();
+  }
+  return any_started;
+}
+
+// Stop
+void ActionExecutor::Stop() noexcept {
+  {
+    const std::scoped_lock lock(mutex_);
+    running_ = false; // (Submit() rejects from now on.)
+  }
+  for (const auto &worker_slot : worker_slots_) {
+    worker_slot->RequestStop(); // (All at once: they stop in parallel.)
+  }
+  for (const auto &worker_slot : worker_slots_) {
+    worker_slot->Stop();
+  }
+  worker_slots_.clear();
+
+  std::deque<PendingAction> queue;
+  {
+    const std::scoped_lock lock(mutex_);
+    queue.swap(queue_);
+  }
+  for (const auto &pending_action : queue) {
+    Report(pending_action, ActionOutcome::kCancelled, -1);
+  }
+}
+
+// Submit
+std::uint64_t
+ActionExecutor::Submit(const std::string_view service_name,
+                       const std::uint32_t current_state) noexcept {
+  try {
+    PendingAction pending_action{0, MonotonicNanoseconds(), current_state,
+                                 std::string(service_name)};
+    // (A name must stay on its line.)
+    std::ranges::replace_if(
+        pending_action.service_name,
+        [](const char character) {
+          return character == '\t' || character == '\n';
+        },
+        ' ');
+    {
+      const std::scoped_lock lock(mutex_);
+      if (running_ && queue_.size() < options_.queue_capacity) {
+        pending_action.id = next_id_.fetch_add(1, std::memory_order_relaxed);
+        queue_.push_back(pending_action);
+      }
+    }
+    if (pending_action.id != 0) {
+      submitted_.fetch_add(1, std::memory_order_relaxed);
+      condition_.notify_one();
+      return pending_action.id;
+    }
+  } catch (...) {
+    // (Out of memory)
+  }
+  rejected_.fetch_add(1, std::memory_order_relaxed);
+  return 0;
+}
+
+#if defined(_WIN32)
+
+// Submit
+std::uint64_t
+ActionExecutor::Submit(const std::wstring_view service_name,
+                       const std::uint32_t current_state) noexcept {
+  try {
+    std::string utf8(WideCharToMultiByte(CP_UTF8, 0, service_name.data(),
+                                         static_cast<int>(service_name.size()),
+                                         nullptr, 0, nullptr, nullptr),
+                     '\0');
+    WideCharToMultiByte(CP_UTF8, 0, service_name.data(),
+                        static_cast<int>(service_name.size()), utf8.data(),
+                        static_cast<int>(utf8.size()), nullptr, nullptr);
+    return Submit(std::string_view(utf8), current_state);
+  } catch (...) {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+  }
+}
+
+#endif
+
+// GetStatistics
+ActionExecutorStatistics ActionExecutor::GetStatistics() const {
+  ActionExecutorStatistics statistics;
+  statistics.submitted = submitted_.load(std::memory_order_relaxed);
+  statistics.rejected = rejected_.load(std::memory_order_relaxed);
+  for (std::size_t outcome{0}; outcome < std::size(outcomes_); ++outcome) {
+    statistics.outcomes[outcome] =
+        outcomes_[outcome].load(std::memory_order_relaxed);
+  }
+  statistics.worker_starts = worker_starts_.load(std::memory_order_relaxed);
+  statistics.batches = batches_.load(std::memory_order_relaxed);
+  statistics.latency = latency_recorder_.Snapshot().front();
+  return statistics;
+}
+
+// Report
+void ActionExecutor::Report(const PendingAction &pending_action,
+                            const ActionOutcome outcome,
+                            const int status) noexcept {
+  const auto latency{MonotonicNanoseconds() - pending_action.submit_time};
+  latency_recorder_.Record(0, latency);
+  outcomes_[static_cast<std::size_t>(outcome)].fetch_add(
+      1, std::memory_order_relaxed);
+
+  if (result_function_) {
+    try {
+      result_function_({pending_action.id, pending_action.service_name,
+                        pending_action.current_state, outcome, status,
+                        latency}); // <-- RESULT
+    } catch (...) {
+      // (The feeding thread must survive a throwing result function.)
+    }
+  }
+}
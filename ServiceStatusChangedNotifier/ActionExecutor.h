@@ -0,0 +1,184 @@
+#ifndef AMITG_FC_ACTION_EXECUTOR
+#define AMITG_FC_ACTION_EXECUTOR
+
+/*
+   ActionExecutor.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "LatencyHistogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ActionOutcome
+enum class ActionOutcome : std::uint8_t {
+  kSucceeded, // (The worker answered status 0)
+  kFailed,    // (The worker answered a non-zero status)
+  kCrashed,   // (The worker exited while running it; it is restarted)
+  kTimedOut,  // (No answer within action_timeout; the worker is killed and
+              // restarted)
+  kCancelled, // (Still queued at Stop())
+  kCount
+};
+
+inline constexpr std::size_t kActionOutcomeCount{
+    static_cast<std::size_t>(ActionOutcome::kCount)};
+
+// ActionResult
+struct ActionResult {
+  std::uint64_t id{0}; // (Returned by Submit())
+  std::string service_name{};
+  std::uint32_t current_state{0};
+  ActionOutcome outcome{ActionOutcome::kSucceeded};
+  int status{0};             // (As answered by the worker)
+  std::int64_t latency{0};   // (Nanoseconds: Submit() -> result)
+};
+
+// ActionExecutorOptions
+struct ActionExecutorOptions {
+  // The worker program and its arguments (UTF-8; command[0] is the program: a
+  // path, or a name searched in PATH). No shell is involved.
+  std::vector<std::string> command{};
+  std::size_t worker_count{4};
+  std::size_t batch_size{32}; // (Requests written to a worker at once)
+  // The longest a worker may go without answering while it has requests.
+  std::chrono::milliseconds action_timeout{30000};
+  // Restart a worker after this many actions (0: never; 1: one process per
+  // action, as if spawned per event).
+  std::size_t max_actions_per_worker{0};
+  std::size_t queue_capacity{65536}; // (Submit() fails beyond it)
+};
+
+// ActionExecutorStatistics
+struct ActionExecutorStatistics {
+  std::uint64_t submitted{0};
+  std::uint64_t rejected{0}; // (Queue full, or not started)
+  std::uint64_t outcomes[kActionOutcomeCount]{}; // (Index: ActionOutcome)
+  std::uint64_t worker_starts{0};
+  std::uint64_t batches{0};
+  LatencyHistogramSnapshot latency{}; // (Submit() -> result, ns)
+};
+
+// ActionExecutor
+// Runs actions in a pool of pre-started worker processes, so that an action
+// that shells out costs a line on a pipe rather than a process start, and a
+// crashing or hanging script cannot stall the notifier.
+//
+// Submit() only queues the action (it is safe on the SCM callback thread or
+// a dispatcher worker). One thread per worker writes the queued actions to
+// its worker's stdin in batches and reads the answers from its stdout, in any
+// order; results are reported asynchronously to the ResultFunction, on that
+// thread. A worker that exits is restarted (kCrashed); one that stays silent
+// for action_timeout is killed and restarted (kTimedOut). Either outcome goes
+// to the oldest unanswered action of the batch (the one a worker that works
+// in order was running); the rest of the batch is queued again, ahead of
+// newer actions.
+//
+// The protocol is one line per action, in UTF-8:
+//	- request:  <id> TAB <current state> TAB <service name> LF
+//	- answer:   <id> TAB <status> LF (status 0: success)
+// Windows: anonymous pipe for stdin, overlapped named pipe for stdout; Linux:
+// one Unix socket pair for both.
+class ActionExecutor final {
+public:
+  using ResultFunction = std::function<void(const ActionResult &result)>;
+
+  ActionExecutor();
+  ~ActionExecutor(); // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  ActionExecutor(const ActionExecutor &) = delete;
+  ActionExecutor &operator=(const ActionExecutor &) = delete;
+
+  // Delete move constructor and move assignment operator
+  ActionExecutor(ActionExecutor &&) = delete;
+  ActionExecutor &operator=(ActionExecutor &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start the workers (replaces a previous Start()). Returns false if no
+  // worker could be started.
+  bool Start(const ActionExecutorOptions &options,
+             const ResultFunction &result_function);
+
+  // Stop: actions not answered yet are reported as kCancelled; the workers'
+  // stdin is closed (a worker still running shortly after is killed).
+  void Stop() noexcept;
+
+  // Queue an action (any thread, without blocking). Returns its id, or 0 if
+  // rejected (queue full, not started, out of memory).
+  std::uint64_t Submit(std::string_view service_name,
+                       std::uint32_t current_state) noexcept;
+
+#if defined(_WIN32)
+  std::uint64_t Submit(std::wstring_view service_name,
+                       std::uint32_t current_state) noexcept;
+#endif
+
+  [[nodiscard]] ActionExecutorStatistics GetStatistics() const;
+
+private:
+  struct PendingAction {
+    std::uint64_t id{0};
+    std::int64_t submit_time{0};
+    std::uint32_t current_state{0};
+    std::string service_name{};
+  };
+
+  class WorkerSlot; // (A worker process and the thread that feeds it)
+
+  void Report(const PendingAction &pending_action, ActionOutcome outcome,
+              int status) noexcept;
+
+  ActionExecutorOptions options_{};
+  ResultFunction result_function_{};
+
+  std::atomic<std::uint64_t> next_id_{1};
+  std::atomic<std::uint64_t> submitted_{0};
+  std::atomic<std::uint64_t> rejected_{0};
+  std::atomic<std::uint64_t> outcomes_[kActionOutcomeCount]{};
+  std::atomic<std::uint64_t> worker_starts_{0};
+  std::atomic<std::uint64_t> batches_{0};
+  LatencyRecorder latency_recorder_{1};
+
+  std::mutex mutex_{};
+  std::condition_variable_any condition_{};
+  std::deque<PendingAction> queue_{}; // (Guarded by mutex_)
+  bool running_{false};               // (Guarded by mutex_)
+
+  std::vector<std::unique_ptr<WorkerSlot>>
+      worker_slots_{}; // (Last: stopped first on destruction)
+};
+
+#endif
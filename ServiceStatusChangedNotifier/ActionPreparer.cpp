@@ -0,0 +1,153 @@
+/*
+   ActionPreparer.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ActionPreparer.h"
+
+#include <algorithm>
+
+// Start
+void ActionPreparer::Start() {
+  if (!threads_.empty()) {
+    return;
+  }
+  const auto thread_count{std::max<std::size_t>(options_.thread_count, 1)};
+  threads_.reserve(thread_count);
+  for (std::size_t index{0}; index < thread_count; ++index) {
+    threads_.emplace_back(
+        [this](const std::stop_token &stop_token) { Run(stop_token); });
+  }
+}
+
+// Stop
+void ActionPreparer::Stop() noexcept {
+  for (auto &thread : threads_) {
+    thread.request_stop(); // (Wakes the condition variable)
+  }
+  threads_.clear(); // (Joins)
+
+  std::deque<std::shared_ptr<Preparation>> queue;
+  {
+    const std::scoped_lock lock(mutex_);
+    queue.swap(queue_);
+  }
+  for (const auto &preparation : queue) {
+    Cancel(*preparation);
+  }
+}
+
+// Prepare
+std::shared_ptr<Preparation>
+ActionPreparer::Prepare(const std::wstring_view service_name,
+                        const std::uint32_t pending_state) noexcept {
+  try {
+    auto preparation{
+        std::make_shared<Preparation>(service_name, pending_state)};
+    {
+      const std::scoped_lock lock(mutex_);
+      queue_.push_back(preparation);
+    }
+    condition_.notify_one();
+    return preparation;
+  } catch (...) {
+    return nullptr; // (Out of memory: the action does the work itself.)
+  }
+}
+
+// Take
+std::shared_ptr<void> ActionPreparer::Take(Preparation &preparation) noexcept {
+  auto state{Preparation::State::kQueued};
+  if (preparation.state_.compare_exchange_strong(
+          state, Preparation::State::kCancelled, std::memory_order_acquire)) {
+    cancelled_.fetch_add(1, std::memory_order_relaxed); // (Not started yet)
+    return nullptr;
+  }
+  while (state == Preparation::State::kRunning) {
+    preparation.state_.wait(state, std::memory_order_acquire);
+    state = preparation.state_.load(std::memory_order_acquire);
+  }
+  if (state != Preparation::State::kDone) {
+    return nullptr;
+  }
+  used_.fetch_add(1, std::memory_order_relaxed);
+  return std::move(preparation.result_);
+}
+
+// Cancel
+// Counted once: a queued preparation that is cancelled here, or a running one
+// whose stop is requested here (a done, taken or already cancelled one is
+// left as is).
+void ActionPreparer::Cancel(Preparation &preparation) noexcept {
+  auto state{Preparation::State::kQueued};
+  if (preparation.state_.compare_exchange_strong(
+          state, Preparation::State::kCancelled)) {
+    cancelled_.fetch_add(1, std::memory_order_relaxed); // (Never runs)
+    return;
+  }
+  if (state == Preparation::State::kRunning &&
+      preparation.stop_source_.request_stop()) {
+    cancelled_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// GetStatistics
+PreparationStatistics ActionPreparer::GetStatistics() const noexcept {
+  return {started_.load(std::memory_order_relaxed),
+          used_.load(std::memory_order_relaxed),
+          cancelled_.load(std::memory_order_relaxed)};
+}
+
+// Run
+// A preparer thread: claim the next queued preparation (a cancelled or
+// taken one is skipped), run the prepare function, publish the result.
+void ActionPreparer::Run(const std::stop_token &stop_token) noexcept {
+  for (;;) {
+    std::shared_ptr<Preparation> preparation;
+    {
+      std::unique_lock lock(mutex_);
+      if (!condition_.wait(lock, stop_token,
+                           [this] { return !queue_.empty(); })) {
+        return; // (Stop())
+      }
+      preparation = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    auto state{Preparation::State::kQueued};
+    if (!preparation->state_.compare_exchange_strong(
+            state, Preparation::State::kRunning, std::memory_order_relaxed)) {
+      continue;
+    }
+    started_.fetch_add(1, std::memory_order_relaxed);
+
+    try {
+      preparation->result_ = prepare_function_(
+          preparation->service_name_, preparation->pending_state_,
+          preparation->stop_source_.get_token()); // <-- PREPARE
+    } catch (...) {
+      // (Nothing prepared: the final action does the work itself.)
+    }
+    preparation->state_.store(Preparation::State::kDone,
+                              std::memory_order_release);
+    preparation->state_.notify_all();
+  }
+}
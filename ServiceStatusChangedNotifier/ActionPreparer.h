@@ -0,0 +1,189 @@
+#ifndef AMITG_FC_ACTION_PREPARER
+#define AMITG_FC_ACTION_PREPARER
+
+/*
+   ActionPreparer.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ServiceNotify.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// PreparationOptions
+struct PreparationOptions {
+  // Pending states that start a preparation (any of STOP_PENDING,
+  // START_PENDING, CONTINUE_PENDING, PAUSE_PENDING).
+  std::uint32_t pending_mask{SERVICE_NOTIFY_STOP_PENDING};
+  std::size_t thread_count{1}; // (Preparations run in parallel)
+};
+
+// PreparationStatistics
+struct PreparationStatistics {
+  std::uint64_t started{0};   // (Prepare function called)
+  std::uint64_t used{0};      // (Handed to the final action)
+  std::uint64_t cancelled{0}; // (The service did not reach the final state,
+                              // or the final action came first)
+};
+
+// PreparedState
+// The state a pending state is expected to end in (STOP_PENDING -> STOPPED,
+// START_PENDING / CONTINUE_PENDING -> RUNNING, PAUSE_PENDING -> PAUSED); 0
+// for any other state.
+[[nodiscard]] constexpr std::uint32_t
+PreparedState(const std::uint32_t pending_state) noexcept {
+  switch (pending_state) {
+  case SERVICE_NOTIFY_STOP_PENDING:
+    return SERVICE_NOTIFY_STOPPED;
+  case SERVICE_NOTIFY_START_PENDING:
+  case SERVICE_NOTIFY_CONTINUE_PENDING:
+    return SERVICE_NOTIFY_RUNNING;
+  case SERVICE_NOTIFY_PAUSE_PENDING:
+    return SERVICE_NOTIFY_PAUSED;
+  default:
+    return 0;
+  }
+}
+
+// Preparation
+// The speculative work started for one pending state.
+class Preparation final {
+public:
+  Preparation(const std::wstring_view service_name,
+              const std::uint32_t pending_state)
+      : service_name_{service_name}, pending_state_{pending_state} {}
+  ~Preparation() = default;
+
+  // Delete copy constructor and copy assignment operator
+  Preparation(const Preparation &) = delete;
+  Preparation &operator=(const Preparation &) = delete;
+
+  // Delete move constructor and move assignment operator
+  Preparation(Preparation &&) = delete;
+  Preparation &operator=(Preparation &&) = delete;
+
+  [[nodiscard]] std::uint32_t PendingState() const noexcept {
+    return pending_state_;
+  }
+
+private:
+  friend class ActionPreparer;
+
+  enum class State : std::uint8_t { kQueued, kRunning, kDone, kCancelled };
+
+  const std::wstring service_name_;
+  const std::uint32_t pending_state_;
+  std::atomic<State> state_{State::kQueued};
+  std::stop_source stop_source_{};
+  std::shared_ptr<void> result_{}; // (Written before state_ becomes kDone)
+};
+
+// ActionPreparer
+// Runs a prepare function speculatively on entry to a pending state (e.g.
+// collect a dump while a service is STOP_PENDING), so that the action for the
+// state that follows (STOPPED) finds its expensive part already done.
+//
+// Prepare() queues the work for the preparer threads and returns at once
+// (callable from the SCM callback). Take() hands the result to the final
+// action: it waits for a preparation in progress, but claims one that has
+// not started yet (the action then does the work itself, no later than it
+// would have without speculation). Cancel() stops a preparation whose
+// service went elsewhere: a queued one never runs, a running one sees its
+// stop_token set.
+class ActionPreparer final {
+public:
+  // Returns the prepared context (any type; nullptr: nothing prepared). Runs
+  // on a preparer thread; should return early once stop_token is set.
+  using PrepareFunction = std::function<std::shared_ptr<void>(
+      const std::wstring &service_name, std::uint32_t pending_state,
+      std::stop_token stop_token)>;
+
+  ActionPreparer(const PrepareFunction &prepare_function,
+                 const PreparationOptions &options)
+      : prepare_function_{prepare_function}, options_{options} {}
+  ~ActionPreparer() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  ActionPreparer(const ActionPreparer &) = delete;
+  ActionPreparer &operator=(const ActionPreparer &) = delete;
+
+  // Delete move constructor and move assignment operator
+  ActionPreparer(ActionPreparer &&) = delete;
+  ActionPreparer &operator=(ActionPreparer &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start the preparer threads (no-op if started).
+  void Start();
+
+  // Stop: queued preparations are cancelled, running ones are finished
+  // (joins the preparer threads).
+  void Stop() noexcept;
+
+  [[nodiscard]] const PreparationOptions &Options() const noexcept {
+    return options_;
+  }
+
+  // Start preparing (any thread). Returns nullptr if out of memory.
+  [[nodiscard]] std::shared_ptr<Preparation>
+  Prepare(std::wstring_view service_name, std::uint32_t pending_state) noexcept;
+
+  // The prepared context for the final action (see above); nullptr if
+  // nothing was prepared.
+  [[nodiscard]] std::shared_ptr<void> Take(Preparation &preparation) noexcept;
+
+  // Idempotent (a preparation is counted as cancelled at most once).
+  void Cancel(Preparation &preparation) noexcept;
+
+  [[nodiscard]] PreparationStatistics GetStatistics() const noexcept;
+
+private:
+  void Run(const std::stop_token &stop_token) noexcept;
+
+  const PrepareFunction prepare_function_;
+  const PreparationOptions options_;
+
+  std::atomic<std::uint64_t> started_{0};
+  std::atomic<std::uint64_t> used_{0};
+  std::atomic<std::uint64_t> cancelled_{0};
+
+  std::mutex mutex_{};
+  std::condition_variable_any condition_{};
+  std::deque<std::shared_ptr<Preparation>> queue_{}; // (Guarded by mutex_)
+
+  std::vector<std::jthread> threads_{}; // (Last: joined first on destruction)
+};
+
+#endif
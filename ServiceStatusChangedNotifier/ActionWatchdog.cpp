@@ -0,0 +1,178 @@
+/*
+   ActionWatchdog.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ActionWatchdog.h"
+
+#include "MonotonicClock.h"
+
+#include <chrono>
+#include <utility>
+
+// Start
+void ActionWatchdog::Start() {
+  if (!thread_.joinable()) {
+    thread_ = std::jthread(
+        [this](const std::stop_token &stop_token) { Run(stop_token); });
+  }
+}
+
+// Stop
+void ActionWatchdog::Stop() noexcept {
+  if (thread_.joinable()) {
+    thread_.request_stop(); // (Wakes the condition variable)
+    thread_.join();
+  }
+}
+
+// Arm
+void ActionWatchdog::Arm(WatchedAction &watched_action) noexcept {
+  watched_action.overrun = false;
+  bool earliest{false};
+  {
+    const std::scoped_lock lock(mutex_);
+    try {
+      heap_.push_back(&watched_action);
+    } catch (...) {
+      watched_action.heap_index = kNotInHeap; // (Out of memory: not watched)
+      return;
+    }
+    watched_action.heap_index = heap_.size() - 1;
+    SiftUp(watched_action.heap_index);
+    earliest = watched_action.heap_index == 0;
+  }
+  watched_.fetch_add(1, std::memory_order_relaxed);
+  if (earliest) {
+    condition_.notify_one(); // (The watchdog sleeps until a later deadline.)
+  }
+}
+
+// Disarm
+bool ActionWatchdog::Disarm(WatchedAction &watched_action,
+                            const std::int64_t end_time) noexcept {
+  {
+    const std::scoped_lock lock(mutex_);
+    if (!watched_action.overrun) {
+      if (watched_action.heap_index != kNotInHeap) {
+        RemoveAt(watched_action.heap_index);
+      }
+      return false;
+    }
+  }
+  overrun_recorder_.Record(0, end_time - watched_action.deadline);
+  return true;
+}
+
+// GetStatistics
+ActionWatchdogStatistics ActionWatchdog::GetStatistics() const {
+  return {watched_.load(std::memory_order_relaxed),
+          overruns_.load(std::memory_order_relaxed),
+          overrun_recorder_.Snapshot().front()};
+}
+
+// Run
+// Sleep until the earliest deadline; report the actions past theirs.
+void ActionWatchdog::Run(const std::stop_token &stop_token) noexcept {
+  std::unique_lock lock(mutex_);
+  while (!stop_token.stop_requested()) {
+    if (heap_.empty()) {
+      condition_.wait(lock, stop_token, [this] { return !heap_.empty(); });
+      continue;
+    }
+
+    WatchedAction &earliest{*heap_.front()};
+    const auto deadline{earliest.deadline};
+    if (const auto now{MonotonicNanoseconds()}; deadline > now) {
+      // (Woken early only by an earlier deadline.)
+      condition_.wait_for(lock, stop_token,
+                          std::chrono::nanoseconds(deadline - now),
+                          [this, deadline] {
+                            return !heap_.empty() &&
+                                   heap_.front()->deadline < deadline;
+                          });
+      continue;
+    }
+
+    RemoveAt(0);
+    earliest.overrun = true; // (Disarm() records its overrun time.)
+    const WatchedAction watched_action{earliest};
+    overruns_.fetch_add(1, std::memory_order_relaxed);
+
+    lock.unlock();
+    if (overrun_function_) {
+      try {
+        overrun_function_(watched_action); // <-- OVERRUN
+      } catch (...) {
+        // (The watchdog thread must survive a throwing overrun function.)
+      }
+    }
+    lock.lock();
+  }
+}
+
+// SiftUp
+void ActionWatchdog::SiftUp(std::size_t index) noexcept {
+  while (index != 0) {
+    const auto parent{(index - 1) / 2};
+    if (heap_[parent]->deadline <= heap_[index]->deadline) {
+      break;
+    }
+    std::swap(heap_[parent], heap_[index]);
+    heap_[index]->heap_index = index;
+    heap_[parent]->heap_index = parent;
+    index = parent;
+  }
+}
+
+// SiftDown
+void ActionWatchdog::SiftDown(std::size_t index) noexcept {
+  for (;;) {
+    auto earliest{index};
+    for (const auto child : {2 * index + 1, 2 * index + 2}) {
+      if (child < heap_.size() &&
+          heap_[child]->deadline < heap_[earliest]->deadline) {
+        earliest = child;
+      }
+    }
+    if (earliest == index) {
+      break;
+    }
+    std::swap(heap_[earliest], heap_[index]);
+    heap_[index]->heap_index = index;
+    heap_[earliest]->heap_index = earliest;
+    index = earliest;
+  }
+}
+
+// RemoveAt
+void ActionWatchdog::RemoveAt(const std::size_t index) noexcept {
+  heap_[index]->heap_index = kNotInHeap;
+  if (index != heap_.size() - 1) {
+    heap_[index] = heap_.back();
+    heap_[index]->heap_index = index;
+    heap_.pop_back();
+    SiftDown(index);
+    SiftUp(index);
+  } else {
+    heap_.pop_back();
+  }
+}
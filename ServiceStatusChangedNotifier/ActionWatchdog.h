@@ -0,0 +1,138 @@
+#ifndef AMITG_FC_ACTION_WATCHDOG
+#define AMITG_FC_ACTION_WATCHDOG
+
+/*
+   ActionWatchdog.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "LatencyHistogram.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+// WatchedAction
+// A running action under watch. Lives on the stack of the thread that runs
+// the action, from Arm() to Disarm().
+struct WatchedAction {
+  void *context{nullptr}; // (Passed back to the OverrunFunction)
+  std::uint32_t service_id{0};
+  std::uint32_t state{0};
+  std::uint64_t sequence{0};
+  std::int64_t start_time{0}; // (MonotonicNanoseconds())
+  std::int64_t deadline{0};   // (MonotonicNanoseconds())
+
+  // (The watchdog's, guarded by its mutex:)
+  std::size_t heap_index{0}; // (kNotInHeap: overrun, or not watched)
+  bool overrun{false};
+};
+
+// ActionWatchdogStatistics
+struct ActionWatchdogStatistics {
+  std::uint64_t watched{0};  // (Armed)
+  std::uint64_t overruns{0}; // (Still running at their deadline)
+  LatencyHistogramSnapshot
+      overrun_time{}; // (Deadline -> action end, ns, of the overrun actions)
+};
+
+// ActionWatchdog
+// Detects actions that run past their deadline, with one timer shared by all
+// of them rather than a thread (or a timer) per action.
+//
+// The armed actions are kept in a min-heap by deadline (each records its heap
+// index, so Disarm() removes it in O(log n)); the heap holds at most one
+// action per thread running actions. The watchdog thread sleeps until the
+// earliest deadline, and is woken only when an Arm() brings that deadline
+// forward. An action still armed at its deadline is reported once, on the
+// watchdog thread, while it still runs (an action that starts already late
+// is reported at once).
+class ActionWatchdog final {
+public:
+  // Called once per overrun action, on the watchdog thread (with a copy of
+  // the WatchedAction: the action may end meanwhile).
+  using OverrunFunction =
+      std::function<void(const WatchedAction &watched_action)>;
+
+  static constexpr std::size_t kNotInHeap{static_cast<std::size_t>(-1)};
+
+  explicit ActionWatchdog(const OverrunFunction &overrun_function)
+      : overrun_function_{overrun_function} {}
+  ~ActionWatchdog() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  ActionWatchdog(const ActionWatchdog &) = delete;
+  ActionWatchdog &operator=(const ActionWatchdog &) = delete;
+
+  // Delete move constructor and move assignment operator
+  ActionWatchdog(ActionWatchdog &&) = delete;
+  ActionWatchdog &operator=(ActionWatchdog &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start the watchdog thread (no-op if started).
+  void Start();
+
+  // Stop reporting (joins the watchdog thread). Armed actions stay armed
+  // until disarmed.
+  void Stop() noexcept;
+
+  // Watch an action from its start (any thread). If out of memory, the
+  // action is not watched.
+  void Arm(WatchedAction &watched_action) noexcept;
+
+  // Stop watching it (the thread that armed it, at the action's end);
+  // returns true if it overran.
+  bool Disarm(WatchedAction &watched_action, std::int64_t end_time) noexcept;
+
+  [[nodiscard]] ActionWatchdogStatistics GetStatistics() const;
+
+private:
+  void Run(const std::stop_token &stop_token) noexcept;
+
+  // Heap maintenance (under mutex_):
+  void SiftUp(std::size_t index) noexcept;
+  void SiftDown(std::size_t index) noexcept;
+  void RemoveAt(std::size_t index) noexcept;
+
+  const OverrunFunction overrun_function_;
+
+  std::atomic<std::uint64_t> watched_{0};
+  std::atomic<std::uint64_t> overruns_{0};
+  LatencyRecorder overrun_recorder_{1};
+
+  std::mutex mutex_{};
+  std::condition_variable_any condition_{};
+  std::vector<WatchedAction *> heap_{}; // (Guarded by mutex_. Min-heap by
+                                        // deadline)
+
+  std::jthread thread_{}; // (Last: joined first on destruction)
+};
+
+#endif
@@ -0,0 +1,262 @@
+/*
+   CgroupEventsNotifier.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "CgroupEventsNotifier.h"
+
+#include "InotifyBatch.h"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <array>
+#include <string_view>
+
+namespace {
+
+// The parent directories: cgroups created, removed or renamed.
+constexpr std::uint32_t kDirectoryMask{IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                       IN_MOVED_TO | IN_ONLYDIR};
+
+// CgroupEventsState
+// Parses a cgroup.events body ("populated 1\nfrozen 0\n") into a
+// SERVICE_NOTIFY_xxx state, without allocating.
+std::uint32_t CgroupEventsState(std::string_view body) noexcept {
+  bool populated{false};
+  bool frozen{false};
+  while (!body.empty()) {
+    const auto end_of_line{body.find('\n')};
+    const auto line{body.substr(0, end_of_line)};
+    body.remove_prefix(end_of_line == std::string_view::npos ? body.size()
+                                                             : end_of_line + 1);
+    if (line.starts_with("populated ")) {
+      populated = line.ends_with('1');
+    } else if (line.starts_with("frozen ")) {
+      frozen = line.ends_with('1');
+    }
+  }
+  if (!populated) {
+    return SERVICE_NOTIFY_STOPPED;
+  }
+  return frozen ? SERVICE_NOTIFY_PAUSED : SERVICE_NOTIFY_RUNNING;
+}
+
+} // namespace
+
+// Start
+void CgroupEventsNotifier::Start(
+    const std::vector<std::string> &service_list,
+    const std::uint32_t notify_mask,
+    const ActionFunction &action_function) noexcept {
+  Stop();
+
+  notify_mask_ = notify_mask;
+  action_function_ = action_function;
+
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (inotify_fd_ < 0 || wake_fd_ < 0) {
+    Stop(); // (Closes whatever was opened.)
+    return;
+  }
+
+  try {
+    services_.reserve(service_list.size());
+    for (const auto &service_name : service_list) { // For each cgroup
+      auto cgroup_path{service_name};
+      while (cgroup_path.size() > 1 && cgroup_path.back() == '/') {
+        cgroup_path.pop_back();
+      }
+      const auto separator{cgroup_path.rfind('/')};
+
+      const auto service_index{static_cast<std::uint32_t>(services_.size())};
+      ServiceData &service_data{services_.emplace_back()};
+      service_data.service_name = service_name;
+      service_data.events_path = cgroup_path + "/cgroup.events";
+      service_data.cgroup_name = separator == std::string::npos
+                                     ? cgroup_path
+                                     : cgroup_path.substr(separator + 1);
+      if (!Attach(service_index)) {
+        services_.pop_back();
+        continue; // (No such cgroup, or not cgroup v2.)
+      }
+
+      const auto directory{separator == std::string::npos ? std::string(".")
+                           : separator == 0 ? std::string("/")
+                                            : cgroup_path.substr(0, separator)};
+      service_data.directory_watch =
+          inotify_add_watch(inotify_fd_, directory.c_str(), kDirectoryMask);
+      cgroup_names_.emplace(service_data.cgroup_name, service_index);
+
+      Refresh(service_data, false); // (Initial state: not notified.)
+    }
+  } catch (...) {
+    // (Out of memory: watch what was set up so far.)
+  }
+
+  watcher_thread_ = std::jthread(
+      [this](const std::stop_token &stop_token) { Run(stop_token); });
+}
+
+// Stop
+void CgroupEventsNotifier::Stop() noexcept {
+  if (watcher_thread_.joinable()) {
+    watcher_thread_.request_stop();
+    const std::uint64_t wake{1};
+    [[maybe_unused]] const auto written{write(wake_fd_, &wake, sizeof(wake))};
+    watcher_thread_.join();
+  }
+
+  for (const auto &service_data : services_) {
+    if (service_data.events_fd >= 0) {
+      close(service_data.events_fd);
+    }
+  }
+  services_.clear();
+  watches_.clear();
+  cgroup_names_.clear();
+
+  for (int *const fd : {&inotify_fd_, &wake_fd_}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+// Run
+// The watcher thread: wake up, drain all queued inotify records, mark the
+// changed cgroups (and those created, removed or replaced in their parent
+// directory), then refresh each of them once.
+void CgroupEventsNotifier::Run(const std::stop_token &stop_token) noexcept {
+  try {
+    InotifyChanges changes(services_.size());
+    RunInotifyBatches(
+        stop_token, inotify_fd_, wake_fd_, changes,
+        [this, &changes](const inotify_event &record) {
+          if (const auto found{watches_.find(record.wd)};
+              found != watches_.end()) {
+            changes.Mark(found->second,
+                         record.mask & IN_IGNORED
+                             ? InotifyChanges::Change::kReplaced
+                             : InotifyChanges::Change::kChanged);
+          } else if (record.len != 0 && (record.mask & IN_ISDIR)) {
+            const auto [first, last]{
+                cgroup_names_.equal_range(std::string_view(record.name))};
+            for (auto entry{first}; entry != last; ++entry) {
+              if (services_[entry->second].directory_watch == record.wd) {
+                changes.Mark(entry->second, InotifyChanges::Change::kReplaced);
+              }
+            }
+          }
+        },
+        [this](const std::uint32_t service_index, const bool replaced) {
+          ServiceData &service_data{services_[service_index]};
+          if (replaced) {
+            Detach(service_data);
+            if (!Attach(service_index)) {
+              SetState(service_data, SERVICE_NOTIFY_STOPPED, true); // (Gone)
+              return;
+            }
+          }
+          Refresh(service_data, true);
+        });
+  } catch (...) {
+    // (Out of memory: nothing is watched.)
+  }
+}
+
+// Attach
+bool CgroupEventsNotifier::Attach(const std::uint32_t service_index) noexcept {
+  ServiceData &service_data{services_[service_index]};
+  const int events_watch{inotify_add_watch(
+      inotify_fd_, service_data.events_path.c_str(), IN_MODIFY)};
+  if (events_watch < 0) {
+    return false;
+  }
+  try {
+    watches_[events_watch] = service_index;
+  } catch (...) {
+    inotify_rm_watch(inotify_fd_, events_watch);
+    return false; // (Out of memory)
+  }
+  service_data.events_watch = events_watch;
+  service_data.events_fd =
+      open(service_data.events_path.c_str(), O_RDONLY | O_CLOEXEC);
+  return true;
+}
+
+// Detach
+void CgroupEventsNotifier::Detach(ServiceData &service_data) noexcept {
+  if (service_data.events_watch >= 0) {
+    watches_.erase(service_data.events_watch);
+    inotify_rm_watch(inotify_fd_, service_data.events_watch);
+    service_data.events_watch = -1;
+  }
+  if (service_data.events_fd >= 0) {
+    close(service_data.events_fd);
+    service_data.events_fd = -1;
+  }
+}
+
+// Refresh
+void CgroupEventsNotifier::Refresh(ServiceData &service_data,
+                                   const bool notify) noexcept {
+  if (service_data.events_fd < 0) {
+    return;
+  }
+
+  std::array<char, 256> body{};
+  const auto size{pread(service_data.events_fd, body.data(), body.size(), 0)};
+  if (size < 0) {
+    return; // (The cgroup is being removed: its parent reports it.)
+  }
+
+  SetState(service_data,
+           CgroupEventsState({body.data(), static_cast<std::size_t>(size)}),
+           notify);
+}
+
+// SetState
+void CgroupEventsNotifier::SetState(ServiceData &service_data,
+                                    const std::uint32_t current_state,
+                                    const bool notify) noexcept {
+  if (current_state == service_data.current_state) {
+    return;
+  }
+  service_data.current_state = current_state;
+
+  if (notify && action_function_ &&
+      (current_state | notify_mask_) == notify_mask_) {
+    try {
+      action_function_(service_data.service_name, current_state); // <-- NOTIFY
+    } catch (...) {
+      // (The watcher thread must survive a throwing action.)
+    }
+  }
+}
+
+#endif
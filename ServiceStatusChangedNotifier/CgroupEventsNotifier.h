@@ -0,0 +1,138 @@
+#ifndef AMITG_FC_CGROUP_EVENTS_NOTIFIER
+#define AMITG_FC_CGROUP_EVENTS_NOTIFIER
+
+/*
+   CgroupEventsNotifier.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "ServiceNotify.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Linux (cgroup v2) implementation
+// Watches cgroups as "services": a service is a cgroup directory (e.g.
+// "/sys/fs/cgroup/system.slice/nginx.service"), and its state follows the
+// "populated" / "frozen" keys of its cgroup.events file:
+//	- populated 0             -> SERVICE_NOTIFY_STOPPED
+//	- populated 1, frozen 0   -> SERVICE_NOTIFY_RUNNING
+//	- populated 1, frozen 1   -> SERVICE_NOTIFY_PAUSED
+//
+// All cgroup.events files are watched through one inotify descriptor. A
+// wakeup drains every queued inotify record, de-duplicates the changed
+// cgroups, then re-reads each of them once (pread() on a descriptor kept
+// open): a mass stop costs one wakeup and one read per cgroup, not one per
+// record (RunInotifyBatches()). If the inotify queue overflowed, every cgroup
+// is re-read.
+//
+// The parent directories are watched too (a kept-open cgroup.events never
+// reports its own removal): a removed cgroup reports SERVICE_NOTIFY_STOPPED,
+// and one created again under the same path is watched again.
+class CgroupEventsNotifier final {
+public:
+  using ActionFunction = std::function<void(const std::string &service_name,
+                                            std::uint32_t current_state)>;
+
+  CgroupEventsNotifier() = default;
+  ~CgroupEventsNotifier() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  CgroupEventsNotifier(const CgroupEventsNotifier &) = delete;
+  CgroupEventsNotifier &operator=(const CgroupEventsNotifier &) = delete;
+
+  // Delete move constructor and move assignment operator
+  CgroupEventsNotifier(CgroupEventsNotifier &&) = delete;
+  CgroupEventsNotifier &operator=(CgroupEventsNotifier &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start watching the specified cgroup directories (replaces a previous
+  // Start(); a cgroup that does not exist is skipped). action_function is
+  // called on the watcher thread with the cgroup path as the service name.
+  void Start(const std::vector<std::string> &service_list,
+             std::uint32_t notify_mask,
+             const ActionFunction &action_function) noexcept;
+
+  // Stop watching (joins the watcher thread, closes all descriptors).
+  void Stop() noexcept;
+
+protected:
+  struct ServiceData {
+    std::string service_name{};
+    std::string events_path{}; // (<service_name>/cgroup.events)
+    std::string cgroup_name{}; // (The last path component)
+    int events_watch{-1};      // (Of cgroup.events)
+    int directory_watch{-1};   // (Of the parent directory)
+    int events_fd{-1};         // (cgroup.events, kept open for pread())
+    std::uint32_t current_state{SERVICE_NOTIFY_STOPPED};
+  };
+
+  // (Heterogeneous lookup: find an inotify record name without a
+  // std::string.)
+  struct NameHash {
+    using is_transparent = void;
+    std::size_t operator()(const std::string_view name) const noexcept {
+      return std::hash<std::string_view>{}(name);
+    }
+  };
+
+  void Run(const std::stop_token &stop_token) noexcept;
+
+  // Watch and open the cgroup's cgroup.events; false if it has none.
+  bool Attach(std::uint32_t service_index) noexcept;
+  void Detach(ServiceData &service_data) noexcept;
+
+  // Re-read cgroup.events; notify if the state changed.
+  void Refresh(ServiceData &service_data, bool notify) noexcept;
+
+  void SetState(ServiceData &service_data, std::uint32_t current_state,
+                bool notify) noexcept;
+
+  std::vector<ServiceData> services_{}; // (Index: service index)
+  std::unordered_map<int, std::uint32_t>
+      watches_{}; // Key: cgroup.events watch descriptor, Value: service index
+  std::unordered_multimap<std::string, std::uint32_t, NameHash, std::equal_to<>>
+      cgroup_names_{}; // Key: cgroup name (records of the parent directories),
+                       // Value: service index
+
+  std::uint32_t notify_mask_{0};
+  ActionFunction action_function_{};
+
+  int inotify_fd_{-1};
+  int wake_fd_{-1}; // (eventfd: wakes the watcher thread on Stop())
+
+  std::jthread watcher_thread_{}; // (Last: joined first on destruction)
+};
+
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+/*
+   EventCorrelator.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "EventCorrelator.h"
+
+#include "MonotonicClock.h"
+
+#include <algorithm>
+
+// AddPattern
+std::uint32_t
+EventCorrelator::AddPattern(const std::vector<CorrelationTerm> &terms,
+                            const std::chrono::nanoseconds window,
+                            const std::uint32_t min_count,
+                            const IncidentFunction &incident_function) {
+  PatternData &pattern_data{patterns_.emplace_back()};
+  pattern_data.slots.reserve(terms.size());
+  for (const auto &term : terms) {
+    pattern_data.slots.push_back({term.service_id, term.state_mask});
+  }
+  pattern_data.window_length = window.count();
+  pattern_data.min_count =
+      min_count != 0 && min_count < terms.size()
+          ? min_count
+          : static_cast<std::uint32_t>(terms.size());
+  pattern_data.incident_function = incident_function;
+  return static_cast<std::uint32_t>(patterns_.size() - 1);
+}
+
+// Build
+void EventCorrelator::Build() {
+  service_count_ = 0;
+  for (const auto &pattern_data : patterns_) {
+    for (const auto &slot : pattern_data.slots) {
+      service_count_ = std::max<std::size_t>(service_count_,
+                                             slot.service_id + std::size_t{1});
+    }
+  }
+
+  // (Counting sort of the (service, pattern, term) triples.)
+  term_offsets_.assign(service_count_ + 1, 0);
+  for (const auto &pattern_data : patterns_) {
+    for (const auto &slot : pattern_data.slots) {
+      ++term_offsets_[slot.service_id + 1];
+    }
+  }
+  for (std::size_t service_id{0}; service_id < service_count_; ++service_id) {
+    term_offsets_[service_id + 1] += term_offsets_[service_id];
+  }
+  term_references_.resize(term_offsets_.back());
+  std::vector<std::uint32_t> positions(term_offsets_.begin(),
+                                       term_offsets_.end() - 1);
+  for (std::uint32_t pattern_id{0}; pattern_id < patterns_.size();
+       ++pattern_id) {
+    const auto &slots{patterns_[pattern_id].slots};
+    for (std::uint32_t term{0}; term < slots.size(); ++term) {
+      term_references_[positions[slots[term].service_id]++] = {pattern_id,
+                                                               term};
+    }
+  }
+}
+
+// Update
+void EventCorrelator::Update(const std::uint32_t service_id,
+                             const std::uint32_t current_state) noexcept {
+  Update(service_id, current_state, MonotonicNanoseconds());
+}
+
+// Update
+void EventCorrelator::Update(const std::uint32_t service_id,
+                             const std::uint32_t current_state,
+                             const std::int64_t timestamp) noexcept {
+  if (service_id >= service_count_) {
+    return; // (No pattern references it)
+  }
+  for (auto index{term_offsets_[service_id]};
+       index < term_offsets_[service_id + 1]; ++index) {
+    const TermReference &reference{term_references_[index]};
+    Apply(patterns_[reference.pattern_id], reference.pattern_id,
+          reference.term, current_state, timestamp);
+  }
+}
+
+// WindowSize
+std::size_t EventCorrelator::WindowSize(const std::uint32_t pattern_id) {
+  PatternData &pattern_data{patterns_.at(pattern_id)};
+  const std::lock_guard lock(pattern_data.mutex);
+  return pattern_data.window.size();
+}
+
+// Apply
+void EventCorrelator::Apply(PatternData &pattern_data,
+                            const std::uint32_t pattern_id,
+                            const std::uint32_t term,
+                            const std::uint32_t current_state,
+                            const std::int64_t timestamp) noexcept {
+  const std::lock_guard lock(pattern_data.mutex);
+
+  // Expire: a term satisfied by a transition that left the window is no
+  // longer satisfied (entries superseded since are dropped as they expire).
+  pattern_data.latest = std::max(pattern_data.latest, timestamp);
+  const auto horizon{pattern_data.latest - pattern_data.window_length};
+  auto &window{pattern_data.window};
+  while (!window.empty() && window.front().timestamp < horizon) {
+    TermSlot &expired{pattern_data.slots[window.front().term]};
+    if (expired.satisfied && expired.timestamp == window.front().timestamp) {
+      expired.satisfied = false;
+      --pattern_data.satisfied;
+    }
+    window.pop_front();
+  }
+
+  TermSlot &slot{pattern_data.slots[term]};
+  if (!(current_state & slot.state_mask)) {
+    if (slot.satisfied) { // (Left the state)
+      slot.satisfied = false;
+      --pattern_data.satisfied;
+    }
+    slot.reported = false;
+    return;
+  }
+  if (slot.satisfied || slot.reported || timestamp < horizon) {
+    return; // (Still in the state since its entry / too late to correlate)
+  }
+
+  try {
+    // (Transitions may arrive slightly out of timestamp order.)
+    window.insert(std::upper_bound(window.begin(), window.end(), timestamp,
+                                   [](const std::int64_t value,
+                                      const WindowEntry &entry) {
+                                     return value < entry.timestamp;
+                                   }),
+                  {timestamp, term});
+  } catch (...) {
+    return; // (Out of memory: not correlated)
+  }
+  slot.satisfied = true;
+  slot.current_state = current_state;
+  slot.timestamp = timestamp;
+  ++pattern_data.satisfied;
+
+  if (pattern_data.satisfied < pattern_data.min_count) {
+    return;
+  }
+
+  // Complete: one incident, then start over.
+  try {
+    CorrelatedIncident incident{pattern_id};
+    incident.transitions.reserve(pattern_data.satisfied);
+    for (const auto &satisfied_slot : pattern_data.slots) {
+      if (satisfied_slot.satisfied) {
+        incident.transitions.push_back({satisfied_slot.service_id,
+                                        satisfied_slot.current_state,
+                                        satisfied_slot.timestamp});
+      }
+    }
+    std::ranges::sort(incident.transitions, {},
+                      &CorrelatedTransition::timestamp);
+    if (pattern_data.incident_function) {
+      pattern_data.incident_function(incident); // <-- NOTIFY
+    }
+  } catch (...) {
+    // (The updating thread must survive a throwing incident function.)
+  }
+  for (auto &reset_slot : pattern_data.slots) {
+    reset_slot.reported = reset_slot.satisfied;
+    reset_slot.satisfied = false;
+  }
+  pattern_data.satisfied = 0;
+  window.clear();
+}
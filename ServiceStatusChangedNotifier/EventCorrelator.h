@@ -0,0 +1,158 @@
+#ifndef AMITG_FC_EVENT_CORRELATOR
+#define AMITG_FC_EVENT_CORRELATOR
+
+/*
+   EventCorrelator.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ServiceCounters.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// CorrelationTerm
+// One service entering one of the state_mask states (SERVICE_NOTIFY_xxx).
+struct CorrelationTerm {
+  std::uint32_t service_id{0};
+  std::uint32_t state_mask{0};
+};
+
+// CorrelatedTransition
+struct CorrelatedTransition {
+  std::uint32_t service_id{0};
+  std::uint32_t current_state{0};
+  std::int64_t timestamp{0}; // (MonotonicNanoseconds())
+};
+
+// CorrelatedIncident
+// One grouped event for a pattern: the transitions that completed it, in
+// timestamp order.
+struct CorrelatedIncident {
+  std::uint32_t pattern_id{0};
+  std::vector<CorrelatedTransition> transitions{};
+};
+
+// EventCorrelator
+// Turns cascades ("A and B both stopped within 5s", "10 of these 50 services
+// stopped within 1s") into one incident instead of one alert per service.
+//
+// A pattern is a set of terms, a minimum count (default: all terms) and a
+// time window. A term is satisfied from the transition that enters its state
+// until the service leaves that state or the transition falls out of the
+// window. When min_count terms are satisfied at once, the pattern emits one
+// incident with their transitions and starts over (a reported term counts
+// again only after its service has left the state and re-entered it).
+//
+// A service -> (pattern, term) index (CSR) routes each transition to the
+// patterns that reference the service. Each pattern keeps a sliding window
+// of its recent matching transitions (expired from the front as time
+// advances) under its own lock, so memory is bounded by the window, not by
+// the history.
+class EventCorrelator final {
+public:
+  using IncidentFunction =
+      std::function<void(const CorrelatedIncident &incident)>;
+
+  EventCorrelator() = default;
+  ~EventCorrelator() = default;
+
+  // Delete copy constructor and copy assignment operator
+  EventCorrelator(const EventCorrelator &) = delete;
+  EventCorrelator &operator=(const EventCorrelator &) = delete;
+
+  // Delete move constructor and move assignment operator
+  EventCorrelator(EventCorrelator &&) = delete;
+  EventCorrelator &operator=(EventCorrelator &&) = delete;
+
+  // Define a pattern; returns its id (0, 1, ...). min_count 0: all terms. Add
+  // all patterns before Build(). incident_function is called on the updating
+  // thread, under the pattern's lock.
+  std::uint32_t AddPattern(const std::vector<CorrelationTerm> &terms,
+                           std::chrono::nanoseconds window,
+                           std::uint32_t min_count,
+                           const IncidentFunction &incident_function);
+
+  // Build the service -> terms index.
+  void Build();
+
+  // Record a transition (any thread, after Build()). The timestamp is taken
+  // here unless given (e.g. NotifierEvent::timestamp from an EventMerger, so
+  // transitions arrive in timestamp order).
+  void Update(std::uint32_t service_id, std::uint32_t current_state) noexcept;
+  void Update(std::uint32_t service_id, std::uint32_t current_state,
+              std::int64_t timestamp) noexcept;
+
+  // Transitions currently held in a pattern's window (including superseded
+  // ones not yet expired).
+  [[nodiscard]] std::size_t WindowSize(std::uint32_t pattern_id);
+
+protected:
+  struct WindowEntry {
+    std::int64_t timestamp{0};
+    std::uint32_t term{0};
+  };
+
+  struct TermSlot {
+    std::uint32_t service_id{0};
+    std::uint32_t state_mask{0};
+    std::uint32_t current_state{0};
+    std::int64_t timestamp{0}; // (Entered the state)
+    bool satisfied{false};
+    bool reported{false}; // (Part of an incident; still in the state)
+  };
+
+  struct alignas(kCacheLineSize) PatternData {
+    std::mutex mutex{};
+    std::vector<TermSlot> slots{};    // (Guarded by mutex; index: term)
+    std::deque<WindowEntry> window{}; // (Guarded by mutex; timestamp order)
+    std::uint32_t satisfied{0};       // (Guarded by mutex; slot count)
+    std::int64_t latest{0};           // (Guarded by mutex; newest timestamp)
+    std::int64_t window_length{0};    // (Nanoseconds)
+    std::uint32_t min_count{0};
+    IncidentFunction incident_function{};
+  };
+
+  struct TermReference {
+    std::uint32_t pattern_id{0};
+    std::uint32_t term{0};
+  };
+
+  // Expire, then apply the transition to one term; emits on completion.
+  void Apply(PatternData &pattern_data, std::uint32_t pattern_id,
+             std::uint32_t term, std::uint32_t current_state,
+             std::int64_t timestamp) noexcept;
+
+  std::deque<PatternData> patterns_{}; // (Index: pattern id; stable)
+
+  // Service -> terms index: the terms of service s are
+  // term_references_[term_offsets_[s], term_offsets_[s + 1]).
+  std::vector<std::uint32_t> term_offsets_{};
+  std::vector<TermReference> term_references_{};
+  std::size_t service_count_{0};
+};
+
+#endif
@@ -0,0 +1,236 @@
+/*
+   EventMerger.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "EventMerger.h"
+
+#include "MonotonicClock.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <utility>
+
+namespace {
+
+// EventLater
+// Heap order: the earliest timestamp on top (ties: the lower source first).
+constexpr auto EventLater{[](const NotifierEvent &left,
+                             const NotifierEvent &right) noexcept {
+  return left.timestamp != right.timestamp ? left.timestamp > right.timestamp
+                                           : left.source > right.source;
+}};
+
+} // namespace
+
+// SourceQueue
+EventMerger::SourceQueue::SourceQueue(const std::size_t capacity)
+    : mask_{std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1},
+      cells_{std::make_unique<Cell[]>(mask_ + 1)} {
+  for (std::size_t index{0}; index <= mask_; ++index) {
+    cells_[index].sequence.store(index, std::memory_order_relaxed);
+  }
+}
+
+// TryPush
+// A cell is free for position p when its sequence is p; once filled its
+// sequence becomes p + 1 (ready for the consumer at p).
+bool EventMerger::SourceQueue::TryPush(NotifierEvent &event) noexcept {
+  auto position{push_position_.load(std::memory_order_relaxed)};
+  for (;;) {
+    Cell &cell{cells_[position & mask_]};
+    const auto sequence{cell.sequence.load(std::memory_order_acquire)};
+    const auto difference{static_cast<std::ptrdiff_t>(sequence - position)};
+    if (difference == 0) {
+      if (push_position_.compare_exchange_weak(position, position + 1,
+                                               std::memory_order_relaxed)) {
+        cell.event = std::move(event);
+        cell.sequence.store(position + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (difference < 0) {
+      return false; // (Full)
+    } else {
+      position = push_position_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// TryPop
+bool EventMerger::SourceQueue::TryPop(NotifierEvent &event) noexcept {
+  Cell &cell{cells_[pop_position_ & mask_]};
+  if (cell.sequence.load(std::memory_order_acquire) != pop_position_ + 1) {
+    return false; // (Empty, or the next cell is still being filled)
+  }
+  event = std::move(cell.event);
+  cell.sequence.store(pop_position_ + mask_ + 1, std::memory_order_release);
+  ++pop_position_;
+  return true;
+}
+
+// Start
+void EventMerger::Start(const std::size_t source_count,
+                        const ConsumerFunction &consumer_function,
+                        const EventMergerOptions &options) noexcept {
+  Stop();
+
+  try {
+    consumer_function_ = consumer_function;
+    options_ = options;
+    for (std::size_t source{0}; source < source_count; ++source) {
+      sources_.push_back(
+          std::make_unique<SourceQueue>(options_.queue_capacity));
+    }
+    heap_.reserve(source_count * (options_.queue_capacity + 1));
+  } catch (...) {
+    sources_.clear(); // (Out of memory: Push() fails.)
+    return;
+  }
+  last_delivered_ = std::numeric_limits<std::int64_t>::min();
+
+  merge_thread_ = std::jthread(
+      [this](const std::stop_token &stop_token) { Run(stop_token); });
+}
+
+// Stop
+void EventMerger::Stop() noexcept {
+  if (merge_thread_.joinable()) {
+    merge_thread_.request_stop(); // (Wakes the condition variable)
+    merge_thread_.join();
+  }
+  sources_.clear();
+  heap_.clear();
+}
+
+// Push
+bool EventMerger::Push(const std::uint32_t source,
+                       const std::string &service_name,
+                       const std::uint32_t current_state) noexcept {
+  return Push(source, service_name, current_state, MonotonicNanoseconds());
+}
+
+// Push
+bool EventMerger::Push(const std::uint32_t source,
+                       const std::string &service_name,
+                       const std::uint32_t current_state,
+                       const std::int64_t timestamp) noexcept {
+  if (source >= sources_.size()) {
+    return false;
+  }
+
+  try {
+    NotifierEvent event{timestamp, source, current_state, service_name};
+    if (!sources_[source]->TryPush(event)) {
+      drops_.Add();
+      return false;
+    }
+  } catch (...) {
+    drops_.Add(); // (Out of memory copying the name)
+    return false;
+  }
+
+  // (Pairs with the fence in Run(): either the merge thread sees this event
+  // before it sleeps, or this thread sees it sleeping and wakes it.)
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed)) {
+    const std::lock_guard lock(mutex_);
+    woken_ = true;
+    condition_.notify_one();
+  }
+  return true;
+}
+
+// Run
+// The merge thread: drain, deliver up to the watermark, then sleep until the
+// oldest held-back event is due or a producer pushes.
+void EventMerger::Run(const std::stop_token &stop_token) noexcept {
+  const auto lateness{
+      std::chrono::duration_cast<std::chrono::nanoseconds>(options_.lateness)
+          .count()};
+
+  while (!stop_token.stop_requested()) {
+    Drain();
+    Deliver(MonotonicNanoseconds() - lateness);
+
+    std::unique_lock lock(mutex_);
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!Drain()) {
+      const auto woken{[this] { return woken_; }};
+      if (heap_.empty()) {
+        condition_.wait(lock, stop_token, woken);
+      } else {
+        const std::chrono::steady_clock::time_point due{
+            std::chrono::nanoseconds(heap_.front().timestamp + lateness)};
+        condition_.wait_until(lock, stop_token, due, woken);
+      }
+    }
+    woken_ = false;
+    sleeping_.store(false, std::memory_order_relaxed);
+  }
+
+  // (Stop(): deliver everything still held back, in order.)
+  Drain();
+  Deliver(std::numeric_limits<std::int64_t>::max());
+}
+
+// Drain
+bool EventMerger::Drain() noexcept {
+  bool drained{false};
+  NotifierEvent event;
+  for (const auto &source : sources_) {
+    while (source->TryPop(event)) {
+      drained = true;
+      try {
+        heap_.push_back(std::move(event)); // (Reserved: rarely allocates)
+      } catch (...) {
+        drops_.Add();
+        continue;
+      }
+      std::ranges::push_heap(heap_, EventLater);
+    }
+  }
+  return drained;
+}
+
+// Deliver
+void EventMerger::Deliver(const std::int64_t watermark) noexcept {
+  while (!heap_.empty() && heap_.front().timestamp <= watermark) {
+    std::ranges::pop_heap(heap_, EventLater);
+    const NotifierEvent event{std::move(heap_.back())};
+    heap_.pop_back();
+
+    if (event.timestamp < last_delivered_) {
+      late_.fetch_add(1, std::memory_order_relaxed); // (Behind the watermark)
+    } else {
+      last_delivered_ = event.timestamp;
+    }
+
+    if (consumer_function_) {
+      try {
+        consumer_function_(event); // <-- DELIVER
+      } catch (...) {
+        // (The merge thread must survive a throwing consumer.)
+      }
+    }
+  }
+}
@@ -0,0 +1,162 @@
+#ifndef AMITG_FC_EVENT_MERGER
+#define AMITG_FC_EVENT_MERGER
+
+/*
+   EventMerger.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ServiceCounters.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// NotifierEvent
+// One state change, as reported by any backend.
+struct NotifierEvent {
+  std::int64_t timestamp{0}; // (MonotonicNanoseconds(), stamped at ingress)
+  std::uint32_t source{0};   // (Source index given to Push())
+  std::uint32_t current_state{0}; // (SERVICE_NOTIFY_xxx)
+  std::string service_name{};
+};
+
+// EventMergerOptions
+struct EventMergerOptions {
+  // How long an event is held back for events of other sources that carry an
+  // earlier timestamp but have not been seen yet. Larger: fewer late events;
+  // smaller: lower delivery latency.
+  std::chrono::microseconds lateness{2000};
+  std::size_t queue_capacity{4096}; // (Per source; rounded up to a power of
+                                    // two)
+};
+
+// EventMerger
+// Merges the events of several backends (SCM, process, cgroup, readiness
+// socket, ...) into one stream ordered by timestamp.
+//
+// Each source has its own bounded, lock-free multi-producer queue, so backend
+// threads never contend with one another. The merge thread drains all queues
+// into a min-heap and delivers an event once the watermark (now - lateness)
+// has passed its timestamp. An event that still arrives behind the watermark
+// is delivered right away and counted as late.
+class EventMerger final {
+public:
+  using ConsumerFunction = std::function<void(const NotifierEvent &event)>;
+
+  EventMerger() = default;
+  ~EventMerger() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  EventMerger(const EventMerger &) = delete;
+  EventMerger &operator=(const EventMerger &) = delete;
+
+  // Delete move constructor and move assignment operator
+  EventMerger(EventMerger &&) = delete;
+  EventMerger &operator=(EventMerger &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start merging source_count sources (replaces a previous Start()).
+  // consumer_function is called on the merge thread, in timestamp order.
+  void Start(std::size_t source_count,
+             const ConsumerFunction &consumer_function,
+             const EventMergerOptions &options = {}) noexcept;
+
+  // Stop merging: events still held back are delivered first. (Producers must
+  // have stopped pushing.)
+  void Stop() noexcept;
+
+  // Push an event of 'source' (any thread). The timestamp is taken here unless
+  // given. Returns false (and counts a drop) if the source queue is full.
+  bool Push(std::uint32_t source, const std::string &service_name,
+            std::uint32_t current_state) noexcept;
+  bool Push(std::uint32_t source, const std::string &service_name,
+            std::uint32_t current_state, std::int64_t timestamp) noexcept;
+
+  [[nodiscard]] std::uint64_t DropCount() const noexcept {
+    return drops_.Load();
+  }
+  [[nodiscard]] std::uint64_t LateCount() const noexcept {
+    return late_.load(std::memory_order_relaxed);
+  }
+
+protected:
+  // SourceQueue
+  // Bounded multi-producer queue (sequence-numbered cells; a producer claims
+  // a cell with one compare-exchange). Single consumer: the merge thread.
+  class SourceQueue final {
+  public:
+    explicit SourceQueue(std::size_t capacity);
+
+    bool TryPush(NotifierEvent &event) noexcept;
+    bool TryPop(NotifierEvent &event) noexcept;
+
+  private:
+    struct Cell {
+      std::atomic<std::size_t> sequence{0};
+      NotifierEvent event{};
+    };
+
+    const std::size_t mask_;
+    const std::unique_ptr<Cell[]> cells_;
+    alignas(kCacheLineSize) std::atomic<std::size_t> push_position_{0};
+    alignas(kCacheLineSize) std::size_t pop_position_{0};
+  };
+
+  void Run(const std::stop_token &stop_token) noexcept;
+
+  // Move every queued event into the heap; returns false if all were empty.
+  bool Drain() noexcept;
+
+  // Deliver the held-back events whose timestamp is at or before 'watermark'.
+  void Deliver(std::int64_t watermark) noexcept;
+
+  std::vector<std::unique_ptr<SourceQueue>> sources_{}; // (Index: source)
+  std::vector<NotifierEvent> heap_{}; // (Merge thread only; min-heap)
+
+  ConsumerFunction consumer_function_{};
+  EventMergerOptions options_{};
+
+  std::int64_t last_delivered_{0}; // (Merge thread only)
+  ShardedCounter drops_{};
+  std::atomic<std::uint64_t> late_{0};
+
+  // (Producers take the mutex only to wake a sleeping merge thread.)
+  std::atomic<bool> sleeping_{false};
+  std::mutex mutex_{};
+  std::condition_variable_any condition_{};
+  bool woken_{false}; // (Guarded by mutex_)
+
+  std::jthread merge_thread_{}; // (Last: joined first on destruction)
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef AMITG_FC_INOTIFY_BATCH
+#define AMITG_FC_INOTIFY_BATCH
+
+/*
+   InotifyBatch.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <stop_token>
+#include <vector>
+
+// InotifyChanges
+// The services marked by one inotify batch, each once, in marking order. A
+// replacement (the watched file or directory was created, removed or
+// replaced: watch it again) outranks a change of its contents.
+class InotifyChanges final {
+public:
+  enum class Change : std::uint8_t { kNone, kChanged, kReplaced };
+
+  explicit InotifyChanges(const std::size_t service_count)
+      : changes_(service_count) {
+    marked_.reserve(service_count);
+  }
+  ~InotifyChanges() = default;
+
+  // Delete copy constructor and copy assignment operator
+  InotifyChanges(const InotifyChanges &) = delete;
+  InotifyChanges &operator=(const InotifyChanges &) = delete;
+
+  // Delete move constructor and move assignment operator
+  InotifyChanges(InotifyChanges &&) = delete;
+  InotifyChanges &operator=(InotifyChanges &&) = delete;
+
+  void Mark(const std::uint32_t service_index,
+            const Change change = Change::kChanged) noexcept {
+    Change &marked{changes_[service_index]};
+    if (marked == Change::kNone) {
+      marked_.push_back(service_index); // (Reserved: no allocation)
+    }
+    if (change > marked) {
+      marked = change;
+    }
+  }
+
+  // Records were lost (IN_Q_OVERFLOW): every service may have changed.
+  void MarkAll() noexcept {
+    for (std::uint32_t service_index{0}; service_index < changes_.size();
+         ++service_index) {
+      Mark(service_index);
+    }
+  }
+
+  // Call visit(service_index, replaced) once per marked service; clears the
+  // marks.
+  template <typename Visit> void Flush(Visit visit) noexcept {
+    for (const auto service_index : marked_) {
+      const bool replaced{changes_[service_index] == Change::kReplaced};
+      changes_[service_index] = Change::kNone;
+      visit(service_index, replaced);
+    }
+    marked_.clear();
+  }
+
+private:
+  std::vector<Change> changes_; // (Index: service index)
+  std::vector<std::uint32_t> marked_{};
+};
+
+// RunInotifyBatches
+// The watcher thread loop of the inotify backends: wait for inotify_fd (or
+// wake_fd: return), drain every queued record (one read() per buffer full),
+// pass each to mark(record) (which marks 'changes'), then call
+// refresh(service_index, replaced) once per marked service. A burst costs one
+// wakeup and one refresh per service, not one per record; an overflowed
+// queue (IN_Q_OVERFLOW) marks every service. Returns on error, on wake_fd,
+// or once a stop is requested.
+template <typename MarkFunction, typename RefreshFunction>
+void RunInotifyBatches(const std::stop_token &stop_token, const int inotify_fd,
+                       const int wake_fd, InotifyChanges &changes,
+                       MarkFunction mark, RefreshFunction refresh) noexcept {
+  alignas(inotify_event) std::array<char, 64 * 1024> buffer{};
+  std::array<pollfd, 2> poll_fds{{{inotify_fd, POLLIN, 0},
+                                  {wake_fd, POLLIN, 0}}};
+
+  while (!stop_token.stop_requested()) {
+    if (poll(poll_fds.data(), poll_fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    if (poll_fds[1].revents != 0) {
+      return; // (Stop())
+    }
+
+    bool overflowed{false};
+    for (;;) {
+      const auto size{read(inotify_fd, buffer.data(), buffer.size())};
+      if (size <= 0) {
+        break;
+      }
+      for (std::size_t offset{0}; offset < static_cast<std::size_t>(size);) {
+        const auto *const record{
+            reinterpret_cast<const inotify_event *>(buffer.data() + offset)};
+        offset += sizeof(inotify_event) + record->len;
+        if (record->mask & IN_Q_OVERFLOW) { // (wd == -1)
+          overflowed = true;
+        } else {
+          mark(*record);
+        }
+      }
+    }
+    if (overflowed) {
+      changes.MarkAll();
+    }
+
+    changes.Flush(refresh);
+  }
+}
+
+#endif
+
+#endif
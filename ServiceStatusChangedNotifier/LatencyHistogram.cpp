@@ -0,0 +1,280 @@
+/*
+   LatencyHistogram.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <unordered_map>
+
+// ValueAtPercentile
+std::uint64_t LatencyHistogramSnapshot::ValueAtPercentile(
+    const double percentile) const noexcept {
+  if (count == 0) {
+    return 0;
+  }
+  const auto clamped{std::clamp(percentile, 0.0, 100.0)};
+  const auto target{std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(
+             std::ceil(clamped / 100.0 * static_cast<double>(count))))};
+
+  std::uint64_t seen{0};
+  for (std::size_t index{0}; index < buckets.size(); ++index) {
+    seen += buckets[index];
+    if (seen >= target) {
+      return std::min(LatencyHistogram::BucketHighestValue(index), max);
+    }
+  }
+  return max;
+}
+
+// Min
+// (Lowest value equivalent to the first non-empty bucket.)
+std::uint64_t LatencyHistogramSnapshot::Min() const noexcept {
+  for (std::size_t index{0}; index < buckets.size(); ++index) {
+    if (buckets[index] != 0) {
+      return index == 0 ? 0
+                        : LatencyHistogram::BucketHighestValue(index - 1) + 1;
+    }
+  }
+  return 0;
+}
+
+// Mean
+double LatencyHistogramSnapshot::Mean() const noexcept {
+  return count == 0 ? 0.0
+                    : static_cast<double>(sum) / static_cast<double>(count);
+}
+
+// MergeInto
+void LatencyHistogram::MergeInto(LatencyHistogramSnapshot &snapshot) const {
+  if (snapshot.buckets.size() != kBucketCount) {
+    snapshot.buckets.resize(kBucketCount, 0);
+  }
+  for (std::size_t index{0}; index < kBucketCount; ++index) {
+    const auto bucket_count{buckets_[index].load(std::memory_order_relaxed)};
+    snapshot.buckets[index] += bucket_count;
+    snapshot.count += bucket_count;
+  }
+  snapshot.sum += sum_.load(std::memory_order_relaxed);
+  snapshot.max = std::max(snapshot.max, max_.load(std::memory_order_relaxed));
+}
+
+namespace {
+
+std::atomic<std::uint64_t> next_recorder_id{1};
+
+// ThreadCache
+// Per-thread cache of (recorder id -> this thread's histograms). Recorder ids
+// are never reused, so an entry of a destroyed recorder simply never matches
+// again.
+struct ThreadCacheEntry {
+  std::uint64_t recorder_id{0};
+  LatencyHistogram *histograms{nullptr};
+};
+
+constexpr std::size_t kThreadCacheSize{4};
+
+thread_local std::array<ThreadCacheEntry, kThreadCacheSize> thread_cache{};
+thread_local std::size_t thread_cache_next{0}; // (Round-robin replacement)
+
+// The live recorders, by id: a thread exiting after its recorder was
+// destroyed finds nothing to retire into. (Lock order: registry_mutex, then a
+// recorder's mutex.)
+std::mutex registry_mutex;
+std::unordered_map<std::uint64_t, LatencyRecorder *> registry;
+
+// ThreadRegistrations
+// Every (recorder, histograms) this thread allocated, whether or not still
+// cached: retired when the thread exits. The entries of destroyed recorders
+// are pruned once the list has doubled since the last prune, so a thread
+// outliving many recorders keeps O(live recorders) entries.
+struct ThreadRegistrations {
+  ThreadRegistrations() = default;
+  ~ThreadRegistrations() {
+    if (entries.empty()) {
+      return;
+    }
+    thread_cache = {}; // (Its pointers are about to be freed.)
+    const std::lock_guard lock(registry_mutex);
+    for (const auto &[recorder_id, histograms] : entries) {
+      if (const auto found{registry.find(recorder_id)};
+          found != registry.end()) {
+        found->second->Retire(histograms);
+      }
+    }
+  }
+
+  ThreadRegistrations(const ThreadRegistrations &) = delete;
+  ThreadRegistrations &operator=(const ThreadRegistrations &) = delete;
+  ThreadRegistrations(ThreadRegistrations &&) = delete;
+  ThreadRegistrations &operator=(ThreadRegistrations &&) = delete;
+
+  // (Amortized O(1) per registration. Takes registry_mutex: call without a
+  // recorder's mutex held.)
+  void PruneIfGrown() noexcept {
+    if (entries.size() < prune_at) {
+      return;
+    }
+    {
+      const std::lock_guard lock(registry_mutex);
+      std::erase_if(entries, [](const ThreadCacheEntry &entry) {
+        return !registry.contains(entry.recorder_id); // (Histograms freed)
+      });
+    }
+    prune_at = std::max(kMinimumPruneSize, entries.size() * 2);
+  }
+
+  static constexpr std::size_t kMinimumPruneSize{16};
+
+  std::vector<ThreadCacheEntry> entries{};
+  std::size_t prune_at{kMinimumPruneSize};
+};
+
+thread_local ThreadRegistrations thread_registrations{};
+
+// MergeSnapshot
+void MergeSnapshot(const LatencyHistogramSnapshot &from,
+                   LatencyHistogramSnapshot &into) {
+  if (from.buckets.empty()) {
+    return;
+  }
+  if (into.buckets.size() != from.buckets.size()) {
+    into.buckets.resize(from.buckets.size(), 0);
+  }
+  for (std::size_t index{0}; index < from.buckets.size(); ++index) {
+    into.buckets[index] += from.buckets[index];
+  }
+  into.count += from.count;
+  into.sum += from.sum;
+  into.max = std::max(into.max, from.max);
+}
+
+} // namespace
+
+// LatencyRecorder
+LatencyRecorder::LatencyRecorder(const std::size_t stage_count)
+    : id_{next_recorder_id.fetch_add(1, std::memory_order_relaxed)},
+      stage_count_{stage_count}, retired_(stage_count) {
+  const std::lock_guard lock(registry_mutex);
+  registry.emplace(id_, this);
+}
+
+// ~LatencyRecorder
+LatencyRecorder::~LatencyRecorder() {
+  const std::lock_guard lock(registry_mutex); // (Waits for a Retire() in
+                                              // progress.)
+  registry.erase(id_);
+}
+
+// Record
+void LatencyRecorder::Record(const std::size_t stage,
+                             const std::int64_t nanoseconds) noexcept {
+  if (stage >= stage_count_) {
+    return;
+  }
+  if (const auto histograms{ThreadLocalHistograms()}) {
+    histograms[stage].Record(
+        nanoseconds > 0 ? static_cast<std::uint64_t>(nanoseconds) : 0);
+  }
+}
+
+// ThreadLocalHistograms
+// Fast path: a lookup in the thread-local cache. Slow path (first record by
+// this thread, or after eviction): find or allocate under the mutex.
+LatencyHistogram *LatencyRecorder::ThreadLocalHistograms() noexcept {
+  for (const auto &entry : thread_cache) {
+    if (entry.recorder_id == id_) {
+      return entry.histograms;
+    }
+  }
+
+  thread_registrations.PruneIfGrown(); // (Before mutex_: lock order)
+
+  LatencyHistogram *histograms{nullptr};
+  try {
+    const auto thread_id{std::this_thread::get_id()};
+    const std::lock_guard lock(mutex_);
+    // (A thread evicted from its own cache finds its histograms again.)
+    const auto found{std::ranges::find(thread_histograms_, thread_id,
+                                       &ThreadHistograms::thread_id)};
+    if (found != thread_histograms_.end()) {
+      histograms = found->histograms.get();
+    } else {
+      auto &entries{thread_registrations.entries};
+      entries.reserve(entries.size() + 1); // (No throw once allocated)
+      thread_histograms_.reserve(thread_histograms_.size() + 1);
+      auto allocated{std::make_unique<LatencyHistogram[]>(stage_count_)};
+      histograms = allocated.get();
+      thread_histograms_.push_back({thread_id, std::move(allocated)});
+      entries.push_back({id_, histograms});
+    }
+  } catch (...) {
+    return nullptr; // (Out of memory: the sample is dropped.)
+  }
+
+  thread_cache[thread_cache_next] = {id_, histograms};
+  thread_cache_next = (thread_cache_next + 1) % kThreadCacheSize;
+  return histograms;
+}
+
+// Retire
+void LatencyRecorder::Retire(
+    const LatencyHistogram *const histograms) noexcept {
+  const std::lock_guard lock(mutex_);
+  const auto found{std::ranges::find_if(
+      thread_histograms_, [histograms](const ThreadHistograms &entry) {
+        return entry.histograms.get() == histograms;
+      })};
+  if (found == thread_histograms_.end()) {
+    return;
+  }
+  try {
+    for (auto &retired : retired_) { // (Then the merge cannot throw.)
+      retired.buckets.resize(LatencyHistogram::kBucketCount, 0);
+    }
+  } catch (...) {
+    return; // (Out of memory: the histograms stay, and still merge.)
+  }
+  for (std::size_t stage{0}; stage < stage_count_; ++stage) {
+    found->histograms[stage].MergeInto(retired_[stage]);
+  }
+  *found = std::move(thread_histograms_.back());
+  thread_histograms_.pop_back();
+}
+
+// Snapshot
+std::vector<LatencyHistogramSnapshot> LatencyRecorder::Snapshot() const {
+  std::vector<LatencyHistogramSnapshot> snapshots(stage_count_);
+  const std::lock_guard lock(mutex_);
+  for (std::size_t stage{0}; stage < stage_count_; ++stage) {
+    MergeSnapshot(retired_[stage], snapshots[stage]);
+  }
+  for (const auto &[thread_id, histograms] : thread_histograms_) {
+    for (std::size_t stage{0}; stage < stage_count_; ++stage) {
+      histograms[stage].MergeInto(snapshots[stage]);
+    }
+  }
+  return snapshots;
+}
@@ -0,0 +1,162 @@
+#ifndef AMITG_FC_LATENCY_HISTOGRAM
+#define AMITG_FC_LATENCY_HISTOGRAM
+
+/*
+   LatencyHistogram.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// LatencyHistogramSnapshot
+// A plain (non-atomic) copy of one or more merged LatencyHistogram instances.
+struct LatencyHistogramSnapshot {
+  std::vector<std::uint64_t> buckets{};
+  std::uint64_t count{0};
+  std::uint64_t sum{0}; // (Nanoseconds)
+  std::uint64_t max{0}; // (Nanoseconds)
+
+  // Returns the highest value equivalent to the bucket holding the given
+  // percentile (0.0 - 100.0), or 0 if the snapshot is empty.
+  [[nodiscard]] std::uint64_t
+  ValueAtPercentile(double percentile) const noexcept;
+
+  [[nodiscard]] std::uint64_t Min() const noexcept;
+  [[nodiscard]] double Mean() const noexcept;
+};
+
+// LatencyHistogram
+// HDR-style (log-linear) histogram of nanosecond values. Values below 64 are
+// counted exactly; every power-of-two range above that is split into 64 linear
+// sub-buckets, which keeps the relative error under 1.6%.
+// Single writer (Record), any number of concurrent readers (MergeInto).
+class LatencyHistogram final {
+public:
+  static constexpr unsigned kSubBucketBits{6};
+  static constexpr std::uint64_t kSubBucketCount{1ULL << kSubBucketBits};
+  static constexpr unsigned kMaxValueBits{40}; // (~18 minutes; larger values
+                                               // are clamped)
+  static constexpr std::size_t kBucketCount{
+      (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount};
+
+  static constexpr std::size_t BucketIndex(std::uint64_t value) noexcept {
+    constexpr std::uint64_t kMaxValue{(1ULL << kMaxValueBits) - 1};
+    if (value > kMaxValue) {
+      value = kMaxValue;
+    }
+    if (value < kSubBucketCount) {
+      return static_cast<std::size_t>(value);
+    }
+    const auto shift{static_cast<unsigned>(std::bit_width(value)) - 1 -
+                     kSubBucketBits};
+    return static_cast<std::size_t>((shift + 1) * kSubBucketCount +
+                                    ((value >> shift) - kSubBucketCount));
+  }
+
+  static constexpr std::uint64_t
+  BucketHighestValue(const std::size_t index) noexcept {
+    if (index < kSubBucketCount) {
+      return index;
+    }
+    const auto shift{static_cast<unsigned>(index / kSubBucketCount) - 1};
+    const std::uint64_t sub_bucket{index % kSubBucketCount + kSubBucketCount};
+    return ((sub_bucket + 1) << shift) - 1;
+  }
+
+  // Record
+  // Called only by the owning thread: plain load + store (no locked
+  // read-modify-write) keeps the cost to a few nanoseconds.
+  void Record(const std::uint64_t value) noexcept {
+    auto &bucket{buckets_[BucketIndex(value)]};
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + value,
+               std::memory_order_relaxed);
+    if (value > max_.load(std::memory_order_relaxed)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  // Adds this histogram's counts to the snapshot.
+  void MergeInto(LatencyHistogramSnapshot &snapshot) const;
+
+private:
+  std::array<std::atomic<std::uint64_t>, kBucketCount> buckets_{};
+  std::atomic<std::uint64_t> sum_{0};
+  std::atomic<std::uint64_t> max_{0};
+};
+
+// LatencyRecorder
+// A set of histograms ("stages") recorded into per-thread, lock-free
+// histograms and merged on read. The mutex is taken only the first time a
+// thread records into a given recorder, by Snapshot(), and when a thread
+// exits: its histograms are folded into the recorder's retired counts and
+// freed, so memory follows the live threads, not every thread ever seen.
+class LatencyRecorder final {
+public:
+  explicit LatencyRecorder(std::size_t stage_count);
+  ~LatencyRecorder(); // (Non-default destructor: unregisters)
+
+  LatencyRecorder(const LatencyRecorder &) = delete;
+  LatencyRecorder &operator=(const LatencyRecorder &) = delete;
+  LatencyRecorder(LatencyRecorder &&) = delete;
+  LatencyRecorder &operator=(LatencyRecorder &&) = delete;
+
+  // Record a nanosecond value into the calling thread's histogram of 'stage'.
+  // Negative values (clock adjustments across cores) are recorded as zero.
+  void Record(std::size_t stage, std::int64_t nanoseconds) noexcept;
+
+  // Merge every thread's histograms, one snapshot per stage.
+  [[nodiscard]] std::vector<LatencyHistogramSnapshot> Snapshot() const;
+
+  [[nodiscard]] std::size_t StageCount() const noexcept { return stage_count_; }
+
+  // Fold a thread's histograms into the retired counts and free them (called
+  // on the thread's exit).
+  void Retire(const LatencyHistogram *histograms) noexcept;
+
+private:
+  struct ThreadHistograms {
+    std::thread::id thread_id{};
+    std::unique_ptr<LatencyHistogram[]> histograms{}; // (stage_count_ entries)
+  };
+
+  [[nodiscard]] LatencyHistogram *ThreadLocalHistograms() noexcept;
+
+  const std::uint64_t id_; // (Process-unique; keys the thread-local cache)
+  const std::size_t stage_count_;
+
+  mutable std::mutex mutex_{};
+  std::vector<ThreadHistograms> thread_histograms_{}; // (Guarded by mutex_:
+                                                      // the live threads)
+  std::vector<LatencyHistogramSnapshot>
+      retired_{}; // (Guarded by mutex_: the exited threads' counts, per stage)
+};
+
+#endif
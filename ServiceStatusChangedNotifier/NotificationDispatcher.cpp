@@ -0,0 +1,520 @@
+/*
+   NotificationDispatcher.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(_WIN32)
+#include <Windows.h> // Windows headers first
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "NotificationDispatcher.h"
+
+#include "MonotonicClock.h"
+#include "Tracepoints.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace {
+
+// HomeWorker
+// Fibonacci hashing: spreads dense service IDs evenly over the workers.
+std::size_t HomeWorker(const std::uint32_t service_id,
+                       const std::size_t worker_count) noexcept {
+  constexpr std::uint64_t kGoldenRatio{0x9E3779B97F4A7C15ULL};
+  return static_cast<std::size_t>(((service_id * kGoldenRatio) >> 32) %
+                                  worker_count);
+}
+
+// PinCurrentThread
+void PinCurrentThread(const std::size_t processor) noexcept {
+  const auto processors{std::max(1U, std::thread::hardware_concurrency())};
+#if defined(_WIN32)
+  // (Within the thread's processor group: at most 64 processors.)
+  SetThreadAffinityMask(
+      GetCurrentThread(),
+      DWORD_PTR{1} << (processor % std::min(processors, 64U)));
+#elif defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(processor % processors, &cpu_set);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+  static_cast<void>(processor);
+  static_cast<void>(processors);
+#endif
+}
+
+} // namespace
+
+// Start
+void NotificationDispatcher::Start(const DispatchOptions &options) noexcept {
+  if (!workers_.empty() || options.worker_threads == 0) {
+    return;
+  }
+
+  try {
+    worker_queues_ = std::make_unique<WorkerQueue[]>(options.worker_threads);
+    workers_.reserve(options.worker_threads);
+  } catch (...) {
+    return; // (Out of memory: stay inline.)
+  }
+  worker_count_ = options.worker_threads;
+  priority_aging_ = std::max<std::int64_t>(
+      1, std::chrono::duration_cast<std::chrono::nanoseconds>(
+             options.priority_aging)
+             .count());
+  scheduling_policy_ = options.scheduling_policy;
+  inline_.store(false);
+
+  try {
+    for (std::size_t worker{0}; worker < options.worker_threads; ++worker) {
+      workers_.emplace_back([this, worker, pin = options.pin_workers](
+                                const std::stop_token &stop_token) {
+        if (pin) {
+          PinCurrentThread(worker);
+        }
+        WorkerLoop(stop_token, worker);
+      });
+    }
+  } catch (...) {
+    // (Out of resources: the started workers steal the other queues' work.)
+    if (workers_.empty()) {
+      inline_.store(true);
+    }
+  }
+}
+
+// Stop
+void NotificationDispatcher::Stop() noexcept {
+  if (workers_.empty()) {
+    return;
+  }
+
+  inline_.store(true); // (From now on Schedule() runs strands inline.)
+  for (auto &worker : workers_) {
+    worker.request_stop();
+  }
+  workers_.clear(); // (Joins)
+
+  DrainInline(); // (What the workers left behind)
+}
+
+// Dispatch
+DispatchResult
+NotificationDispatcher::Dispatch(NotificationStrand &strand,
+                                 const std::uint32_t state,
+                                 const std::int64_t arrival_time,
+                                 const std::uint32_t root_service_id,
+                                 std::shared_ptr<void> payload) noexcept {
+  DispatchResult result{};
+  Notification notification{};
+  bool tracked{false};
+  bool schedule{false};
+
+  std::unique_lock lock(strand.mutex, std::defer_lock);
+  try {
+    lock.lock();
+
+    // In-flight check: a duplicate of a queued or running action.
+    tracked = IsTracked(strand, state);
+    if (tracked && (strand.in_flight & state) != 0) {
+      // (The latest duplicate gives the re-run its place and context. kDrop
+      // requests one too, but runs it only if the action it relied on is
+      // evicted; its payload is not kept.)
+      const bool merge{
+          strand.duplicate_policy.load(std::memory_order_relaxed) ==
+          DuplicatePolicy::kTrailingRerun};
+      result.sequence = NextSequence();
+      TrailingRerun &trailing{strand.trailing[std::countr_zero(state)]};
+      trailing.sequence = result.sequence;
+      trailing.arrival_time = arrival_time;
+      trailing.root_service_id = root_service_id;
+      Release(strand, std::exchange(trailing.payload,
+                                    merge ? std::move(payload) : nullptr));
+      Release(strand, std::move(payload));
+      strand.in_flight |= std::uint64_t{state} << 32;
+      result.outcome = merge ? DispatchOutcome::kMerged
+                             : DispatchOutcome::kDeduplicated;
+      return result;
+    }
+    if (tracked) {
+      strand.in_flight |= state;
+    }
+
+    const auto deadline{strand.action_deadline != 0
+                            ? arrival_time + strand.action_deadline
+                            : kNoDeadline};
+
+    if (strand.capacity != 0 && strand.queue.size() >= strand.capacity) {
+      switch (strand.overflow_policy) {
+      case OverflowPolicy::kBlock:
+        ++strand.blocked;
+        strand.room_condition.wait(lock, [&strand] {
+          return strand.queue.size() < strand.capacity;
+        });
+        --strand.blocked;
+        break;
+      case OverflowPolicy::kDropNewest:
+        if (tracked) {
+          ReleaseInFlight(strand, state, false);
+        }
+        Release(strand, std::move(payload));
+        result = {NextSequence(), DispatchOutcome::kDroppedNewest};
+        return result;
+      case OverflowPolicy::kDropOldest:
+        // (An evicted action that duplicates relied on is replaced by their
+        // re-run: they are newer than what stays queued, so they must not
+        // vanish with it. A state re-runs at most once, so this ends.)
+        while (strand.queue.size() >= strand.capacity) {
+          Notification oldest{std::move(strand.queue.front())};
+          strand.queue.pop_front();
+          if (IsTracked(strand, oldest.state) &&
+              ReleaseInFlight(strand, oldest.state, true)) {
+            QueueRerun(strand, oldest.state);
+          }
+          Release(strand, std::move(oldest.payload));
+        }
+        result.outcome = DispatchOutcome::kDroppedOldest;
+        break;
+      case OverflowPolicy::kCoalesce: {
+        // (The newest queued notification keeps its place and enqueue time;
+        // it now carries the latest state. The queue never grows. A re-run
+        // requested for it is superseded as well: its duplicates are older
+        // than the new state.)
+        Notification &newest{strand.queue.back()};
+        if (IsTracked(strand, newest.state)) {
+          ReleaseInFlight(strand, newest.state, false);
+        }
+        Release(strand, std::exchange(newest.payload, std::move(payload)));
+        newest.sequence = NextSequence();
+        newest.arrival_time = arrival_time;
+        newest.state = state;
+        newest.root_service_id = root_service_id;
+        newest.deadline = deadline;
+        newest.rerun = false;
+        result = {newest.sequence, DispatchOutcome::kCoalesced,
+                  newest.enqueue_time};
+        return result;
+      }
+      }
+    }
+
+    // (Stamped under the strand mutex: queue order == sequence order.)
+    result.sequence = NextSequence();
+    result.enqueue_time = MonotonicNanoseconds();
+    notification = {result.sequence, arrival_time, result.enqueue_time,
+                    strand.service_id, state,
+                    strand.priority.load(std::memory_order_relaxed),
+                    root_service_id, std::move(payload), deadline};
+    strand.queue.push_back(std::move(notification)); // (No effect on throw)
+    SSCN_TRACE_ENQUEUE(strand.service_id, state, result.enqueue_time);
+    schedule = !strand.scheduled;
+    strand.scheduled = true;
+  } catch (...) {
+    // (Out of memory: the notification is lost.)
+    if (tracked && lock.owns_lock()) {
+      ReleaseInFlight(strand, state, false);
+    }
+    Release(strand, std::move(payload));
+    Release(strand, std::move(notification.payload));
+    return {result.sequence, DispatchOutcome::kDroppedNewest};
+  }
+  lock.unlock();
+
+  if (schedule) {
+    Schedule(strand);
+  }
+  return result;
+}
+
+// SetDuplicatePolicy
+void NotificationDispatcher::SetDuplicatePolicy(
+    NotificationStrand &strand,
+    const DuplicatePolicy duplicate_policy) noexcept {
+  if (strand.duplicate_policy.exchange(duplicate_policy,
+                                       std::memory_order_relaxed) ==
+      duplicate_policy) {
+    return;
+  }
+  strand.in_flight = 0;
+  for (auto &trailing : strand.trailing) {
+    Release(strand, std::move(trailing.payload));
+  }
+}
+
+// IsTracked
+// (Only single-bit states: zero means "unspecified".)
+bool NotificationDispatcher::IsTracked(const NotificationStrand &strand,
+                                       const std::uint32_t state) noexcept {
+  return std::has_single_bit(state) && state < 1U << kTrackedStateCount &&
+         strand.duplicate_policy.load(std::memory_order_relaxed) !=
+             DuplicatePolicy::kDeliver;
+}
+
+// ReleaseInFlight
+bool NotificationDispatcher::ReleaseInFlight(NotificationStrand &strand,
+                                             const std::uint32_t state,
+                                             const bool rerun) noexcept {
+  const std::uint64_t trailing{std::uint64_t{state} << 32};
+  const bool requested{(strand.in_flight & trailing) != 0};
+  if (rerun && requested) {
+    strand.in_flight &= ~trailing;
+    return true;
+  }
+  strand.in_flight &= ~(trailing | state);
+  if (requested) {
+    Release(strand,
+            std::move(strand.trailing[std::countr_zero(state)].payload));
+  }
+  return false;
+}
+
+// QueueRerun
+// (The queue stays in sequence order, so the last action run is still the one
+// for the latest state.)
+void NotificationDispatcher::QueueRerun(NotificationStrand &strand,
+                                        const std::uint32_t state) noexcept {
+  TrailingRerun &trailing{strand.trailing[std::countr_zero(state)]};
+  const auto enqueue_time{MonotonicNanoseconds()};
+  Notification rerun{trailing.sequence,
+                     trailing.arrival_time,
+                     enqueue_time,
+                     strand.service_id,
+                     state,
+                     strand.priority.load(std::memory_order_relaxed),
+                     trailing.root_service_id,
+                     std::move(trailing.payload),
+                     strand.action_deadline != 0
+                         ? trailing.arrival_time + strand.action_deadline
+                         : kNoDeadline,
+                     true};
+  try {
+    strand.queue.insert(std::ranges::upper_bound(strand.queue, rerun.sequence,
+                                                 {}, &Notification::sequence),
+                        std::move(rerun)); // (No effect on throw)
+  } catch (...) {
+    strand.in_flight &= ~std::uint64_t{state}; // (Out of memory)
+    Release(strand, std::move(rerun.payload));
+  }
+}
+
+// Release
+void NotificationDispatcher::Release(
+    const NotificationStrand &strand,
+    std::shared_ptr<void> payload) const noexcept {
+  if (payload && release_function_) {
+    release_function_(strand.context, std::move(payload));
+  }
+}
+
+// Schedule
+void NotificationDispatcher::Schedule(NotificationStrand &strand) noexcept {
+  if (!inline_.load() &&
+      Push(HomeWorker(strand.service_id, worker_count_), strand)) {
+    // (Stop() may have drained the queues just before this push: whoever
+    // sees inline_ set after pushing runs the leftovers.)
+    if (inline_.load()) {
+      DrainInline();
+    }
+    return;
+  }
+
+  // Inline: this thread owns the strand until it is empty. (A concurrent
+  // notification of the same service only queues; it is delivered here.)
+  while (RunStrand(strand, static_cast<std::size_t>(-1))) {
+  }
+}
+
+// Push
+bool NotificationDispatcher::Push(const std::size_t worker,
+                                  NotificationStrand &strand) noexcept {
+  if (scheduling_policy_ == SchedulingPolicy::kEarliestDeadline) {
+    std::int64_t deadline{kNoDeadline};
+    {
+      // (The key may go stale if the head is dropped or coalesced while the
+      // strand waits: that reorders the strand, it never loses it.)
+      const std::lock_guard lock(strand.mutex);
+      if (!strand.queue.empty()) {
+        deadline = strand.queue.front().deadline;
+      }
+    }
+    WorkerQueue &queue{worker_queues_[worker]};
+    const std::lock_guard lock(queue.mutex);
+    try {
+      queue.deadline_ready.push_back({&strand, 0, deadline});
+    } catch (...) {
+      return false; // (Out of memory)
+    }
+    std::ranges::push_heap(queue.deadline_ready, std::ranges::greater{},
+                           &ReadyStrand::deadline);
+  } else {
+    WorkerQueue &queue{worker_queues_[worker]};
+    const auto priority{static_cast<std::size_t>(
+        strand.priority.load(std::memory_order_relaxed))};
+    const auto ready_time{MonotonicNanoseconds()};
+    const std::lock_guard lock(queue.mutex);
+    try {
+      queue.ready[std::min(priority, kNotificationPriorityCount - 1)]
+          .push_back({&strand, ready_time});
+    } catch (...) {
+      return false; // (Out of memory)
+    }
+  }
+
+  // (seq_cst: pairs with the sleeping_ increment in WorkerLoop(), so either
+  // the sleeper sees pending_ or this thread sees the sleeper.)
+  pending_.fetch_add(1);
+  if (sleeping_.load() != 0) {
+    const std::lock_guard lock(wake_mutex_);
+    wake_condition_.notify_one(); // (Any worker: it steals if not home.)
+  }
+  return true;
+}
+
+// Pop
+NotificationStrand *
+NotificationDispatcher::Pop(const std::size_t worker) noexcept {
+  for (std::size_t offset{0}; offset < worker_count_; ++offset) {
+    WorkerQueue &queue{worker_queues_[(worker + offset) % worker_count_]};
+    const std::lock_guard lock(queue.mutex);
+
+    if (!queue.deadline_ready.empty()) { // (kEarliestDeadline)
+      std::ranges::pop_heap(queue.deadline_ready, std::ranges::greater{},
+                            &ReadyStrand::deadline);
+      NotificationStrand *const strand{queue.deadline_ready.back().strand};
+      queue.deadline_ready.pop_back();
+      pending_.fetch_sub(1);
+      return strand;
+    }
+
+    // The head with the lowest aged score: class * aging - waited. (The clock
+    // is read only when more than one class has a head to compare.)
+    std::size_t best{kNotificationPriorityCount};
+    std::int64_t best_score{0};
+    std::int64_t now{0};
+    for (std::size_t priority{0}; priority < kNotificationPriorityCount;
+         ++priority) {
+      if (queue.ready[priority].empty()) {
+        continue;
+      }
+      if (best == kNotificationPriorityCount) {
+        best = priority;
+        continue;
+      }
+      if (now == 0) {
+        now = MonotonicNanoseconds();
+        best_score = static_cast<std::int64_t>(best) * priority_aging_ -
+                     (now - queue.ready[best].front().ready_time);
+      }
+      const auto score{static_cast<std::int64_t>(priority) * priority_aging_ -
+                       (now - queue.ready[priority].front().ready_time)};
+      if (score < best_score) {
+        best = priority;
+        best_score = score;
+      }
+    }
+
+    if (best != kNotificationPriorityCount) {
+      NotificationStrand *const strand{queue.ready[best].front().strand};
+      queue.ready[best].pop_front();
+      pending_.fetch_sub(1);
+      return strand;
+    }
+  }
+  return nullptr;
+}
+
+// DrainInline
+void NotificationDispatcher::DrainInline() noexcept {
+  while (NotificationStrand *const strand{Pop(0)}) {
+    while (RunStrand(*strand, static_cast<std::size_t>(-1))) {
+    }
+  }
+}
+
+// RunStrand
+bool NotificationDispatcher::RunStrand(NotificationStrand &strand,
+                                       const std::size_t budget) noexcept {
+  for (std::size_t delivered{0}; delivered < budget; ++delivered) {
+    Notification notification;
+    {
+      const std::lock_guard lock(strand.mutex);
+      if (strand.queue.empty()) {
+        strand.scheduled = false;
+        return false;
+      }
+      notification = std::move(strand.queue.front());
+      strand.queue.pop_front();
+      if (strand.blocked != 0) {
+        strand.room_condition.notify_one();
+      }
+    }
+
+    SSCN_TRACE_DEQUEUE(notification.service_id, notification.state,
+                       MonotonicNanoseconds());
+    deliver_function_(strand.context, notification); // <-- DELIVER
+
+    if (IsTracked(strand, notification.state)) {
+      // The duplicates that arrived meanwhile: one re-run, in the place of
+      // the latest of them.
+      const std::lock_guard lock(strand.mutex);
+      if (ReleaseInFlight(strand, notification.state,
+                          strand.duplicate_policy.load(
+                              std::memory_order_relaxed) ==
+                              DuplicatePolicy::kTrailingRerun)) {
+        QueueRerun(strand, notification.state);
+      }
+    }
+  }
+
+  const std::lock_guard lock(strand.mutex);
+  strand.scheduled = !strand.queue.empty();
+  return strand.scheduled;
+}
+
+// WorkerLoop
+// Take a ready strand (own queue, else steal), run it for one budget, and put
+// it back at the tail of this worker's queue if it still has work (so a busy
+// service cannot starve the others).
+void NotificationDispatcher::WorkerLoop(const std::stop_token &stop_token,
+                                        const std::size_t worker) noexcept {
+  while (!stop_token.stop_requested()) {
+    NotificationStrand *const strand{Pop(worker)};
+    if (!strand) {
+      std::unique_lock lock(wake_mutex_);
+      sleeping_.fetch_add(1);
+      wake_condition_.wait(lock, stop_token,
+                           [this] { return pending_.load() > 0; });
+      sleeping_.fetch_sub(1);
+      continue;
+    }
+
+    if (RunStrand(*strand, kStrandBudget) && !Push(worker, *strand)) {
+      while (RunStrand(*strand, kStrandBudget)) { // (Out of memory)
+      }
+    }
+  }
+}
@@ -0,0 +1,368 @@
+#ifndef AMITG_FC_NOTIFICATION_DISPATCHER
+#define AMITG_FC_NOTIFICATION_DISPATCHER
+
+/*
+   NotificationDispatcher.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ServiceCounters.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// NotificationPriority
+// A service's dispatch class: with worker threads, ready services of a higher
+// class are served first.
+enum class NotificationPriority : std::uint8_t {
+  kHigh,   // E.g. domain controller, database
+  kNormal, // (Default)
+  kLow,    // E.g. cosmetic services
+  kCount
+};
+
+inline constexpr std::size_t kNotificationPriorityCount{
+    static_cast<std::size_t>(NotificationPriority::kCount)};
+
+// OverflowPolicy
+// What a notification does when its service's strand queue is full
+// (DispatchOptions::strand_capacity):
+enum class OverflowPolicy : std::uint8_t {
+  kBlock,      // The notifying thread waits for room (holds an SCM thread!)
+  kDropNewest, // The new notification is dropped
+  kDropOldest, // The oldest queued notification is dropped
+  kCoalesce    // The newest queued notification takes the new state
+               // (capacity 1: only the latest state per service is kept)
+};
+
+// DuplicatePolicy
+// What a notification does while an action for the same service and state is
+// in flight (queued or running):
+enum class DuplicatePolicy : std::uint8_t {
+  kDeliver,      // Delivered again (as any other notification)
+  kDrop,         // Dropped: the action in flight covers it
+  kTrailingRerun // Merged with the other duplicates into one re-run, queued
+                 // when the action in flight completes
+};
+
+// SchedulingPolicy
+// Which ready service a worker serves first:
+enum class SchedulingPolicy : std::uint8_t {
+  kPriority,        // The best aged NotificationPriority class, FIFO within it
+  kEarliestDeadline // The earliest deadline of the service's next action
+                    // (EDF; priority classes are not used)
+};
+
+// An action without a deadline (Notification::deadline):
+inline constexpr std::int64_t kNoDeadline{
+    std::numeric_limits<std::int64_t>::max()};
+
+// In-flight deduplication tracks the single-bit states below 1 <<
+// kTrackedStateCount (every SERVICE_NOTIFY_xxx state).
+inline constexpr std::size_t kTrackedStateCount{10};
+
+// DispatchOutcome
+enum class DispatchOutcome : std::uint8_t {
+  kQueued,
+  kDroppedNewest, // (kDropNewest: not queued)
+  kDroppedOldest, // (kDropOldest: queued, an older one dropped)
+  kCoalesced,     // (kCoalesce: merged into the newest queued one)
+  kDeduplicated,  // (DuplicatePolicy::kDrop: not queued)
+  kMerged         // (DuplicatePolicy::kTrailingRerun: merged into the re-run)
+};
+
+// DispatchResult
+struct DispatchResult {
+  std::uint64_t sequence{0};
+  DispatchOutcome outcome{DispatchOutcome::kQueued};
+  std::int64_t enqueue_time{0}; // (MonotonicNanoseconds(): when the
+                                // notification carrying the state was
+                                // queued; 0: not queued)
+};
+
+// DispatchOptions
+struct DispatchOptions {
+  // 0: deliver on the notifying thread (the SCM threadpool thread), as
+  // before. Otherwise: the number of worker threads delivering notifications.
+  std::size_t worker_threads{0};
+  // Pin worker i to logical processor i (modulo the processor count).
+  bool pin_workers{false};
+  // Aging: a waiting service is treated as one class higher for every
+  // priority_aging it has waited (so a lower class is never starved).
+  std::chrono::milliseconds priority_aging{50};
+  // With worker threads: the order in which ready services are served.
+  SchedulingPolicy scheduling_policy{SchedulingPolicy::kPriority};
+  // Backpressure, per subscription (applies to the services of the Start()
+  // call it is passed to): at most strand_capacity notifications queued per
+  // service (0: unbounded), then overflow_policy.
+  std::size_t strand_capacity{0};
+  OverflowPolicy overflow_policy{OverflowPolicy::kBlock};
+  // In-flight deduplication, per subscription: a notification whose state
+  // already has an action in flight for its service (queued or running).
+  // Note that kDrop keeps the earlier position: after STOPPED, RUNNING,
+  // STOPPED (while the first STOPPED action runs), the last action run is
+  // RUNNING's; kTrailingRerun runs STOPPED's again afterwards. Under
+  // OverflowPolicy::kDropOldest, an evicted action that duplicates were
+  // dropped or merged for is replaced by the latest of them.
+  DuplicatePolicy duplicate_policy{DuplicatePolicy::kDeliver};
+  // Per subscription: each action is due this long after its notification
+  // arrived (0: no deadline). Orders the services under kEarliestDeadline,
+  // and is what an ActionWatchdog checks.
+  std::chrono::milliseconds action_deadline{0};
+};
+
+// Notification
+// One notification on its way to the action.
+struct Notification {
+  std::uint64_t sequence{0};    // (Global, strictly increasing)
+  std::int64_t arrival_time{0}; // (MonotonicNanoseconds(): callback entry)
+  std::int64_t enqueue_time{0}; // (MonotonicNanoseconds(): queued on strand)
+  std::uint32_t service_id{0};
+  std::uint32_t state{0}; // (SERVICE_NOTIFY_xxx)
+  NotificationPriority priority{NotificationPriority::kNormal};
+  std::uint32_t root_service_id{0}; // (Probable root cause; service_id if
+                                    // none)
+  std::shared_ptr<void> payload{}; // (Opaque to the dispatcher; released with
+                                   // the notification)
+  std::int64_t deadline{kNoDeadline}; // (MonotonicNanoseconds(): the action's
+                                      // deadline)
+  bool rerun{false}; // (A trailing re-run: queued by the delivering thread,
+                     // not by a Dispatch())
+};
+
+// TrailingRerun
+// A requested trailing re-run: the latest merged duplicate, whose place in
+// line and context the re-run takes.
+struct TrailingRerun {
+  std::uint64_t sequence{0};
+  std::int64_t arrival_time{0};
+  std::uint32_t root_service_id{0};
+  std::shared_ptr<void> payload{}; // (The earlier duplicates' are released)
+};
+
+// NotificationStrand
+// The per-service delivery queue. Notifications of one strand are delivered
+// one at a time, in sequence order; different strands run in parallel.
+struct alignas(kCacheLineSize) NotificationStrand {
+  void *context{nullptr}; // (Passed back to the DeliverFunction)
+  std::uint32_t service_id{0};
+  std::atomic<NotificationPriority> priority{NotificationPriority::kNormal};
+
+  std::mutex mutex{};
+  std::deque<Notification> queue{}; // (Guarded by mutex)
+  bool scheduled{false}; // (Guarded by mutex: queued for, or being run by,
+                         // exactly one thread)
+
+  // Backpressure (guarded by mutex):
+  std::size_t capacity{0}; // (0: unbounded)
+  OverflowPolicy overflow_policy{OverflowPolicy::kBlock};
+  std::size_t blocked{0}; // (kBlock: threads waiting for room)
+  std::condition_variable room_condition{};
+
+  std::int64_t action_deadline{0}; // (Nanoseconds; 0: none. Guarded by mutex)
+
+  // In-flight deduplication (guarded by mutex, so a duplicate's place in
+  // line and context stay consistent with the action covering it). Not a
+  // lock-free table: a duplicate updates the trailing re-run (sequence,
+  // arrival time, root cause, payload) and may race an eviction under
+  // kDropOldest, which an atomic bit test alone cannot order. The mutex is
+  // the one Dispatch() takes anyway, so a duplicate costs no extra lock.
+  std::atomic<DuplicatePolicy> duplicate_policy{DuplicatePolicy::kDeliver};
+  std::uint64_t in_flight{0}; // (Low word: the states with an action in
+                              // flight; high word: of those, the ones with a
+                              // trailing re-run requested)
+  std::array<TrailingRerun, kTrackedStateCount> trailing{}; // (Index: state
+                                                            // bit)
+};
+
+// NotificationDispatcher
+// Stamps every notification with a global sequence number and delivers it
+// through its service's strand.
+//
+// Ordering guarantee: the sequence number is taken under the strand mutex, so
+// for any one service the delivery order is the sequence order, and no two
+// notifications of the same service are ever delivered concurrently.
+// Notifications of different services carry no ordering guarantee (compare
+// their sequence numbers).
+//
+// A strand with pending notifications is "scheduled": owned by exactly one
+// thread (a worker, or the notifying thread in inline mode), which runs it
+// until it is empty (inline) or for up to kStrandBudget notifications before
+// yielding it back to a ready queue (workers).
+//
+// Workers are sharded: each has its own ready queues, and a service's strand
+// is scheduled on its home worker (a hash of the service ID). An idle worker
+// steals a whole strand from another worker's queues - never a single
+// notification - so stealing cannot reorder a service.
+//
+// Each worker keeps one FIFO ready queue per NotificationPriority and serves
+// the head with the best aged class: class - (waited / priority_aging).
+// Under SchedulingPolicy::kEarliestDeadline it keeps a single min-heap keyed
+// by the deadline of each strand's next notification instead, so when more
+// services are ready than there are workers, the most urgent runs first
+// (per worker; an idle worker steals the earliest of another's). A strand
+// yielded after its budget goes back in by its new head's deadline.
+// (Inline mode has no queue: each notification is delivered by its notifying
+// thread, so priorities and deadlines order nothing there.)
+class NotificationDispatcher final {
+public:
+  using DeliverFunction = void (*)(void *context,
+                                   const Notification &notification) noexcept;
+  // Receives a payload that is dropped without being delivered (its
+  // notification dropped, deduplicated, coalesced, or merged into a later
+  // duplicate). Called under the strand mutex: must not dispatch.
+  using ReleaseFunction = void (*)(void *context,
+                                   std::shared_ptr<void> payload) noexcept;
+
+  static constexpr std::size_t kStrandBudget{16};
+
+  explicit NotificationDispatcher(
+      const DeliverFunction deliver_function,
+      const ReleaseFunction release_function = nullptr) noexcept
+      : deliver_function_{deliver_function},
+        release_function_{release_function} {}
+  ~NotificationDispatcher() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  NotificationDispatcher(const NotificationDispatcher &) = delete;
+  NotificationDispatcher &operator=(const NotificationDispatcher &) = delete;
+
+  // Delete move constructor and move assignment operator
+  NotificationDispatcher(NotificationDispatcher &&) = delete;
+  NotificationDispatcher &operator=(NotificationDispatcher &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start the worker threads (none in inline mode). No-op while running.
+  void Start(const DispatchOptions &options) noexcept;
+
+  // Deliver everything still queued, then join the workers. Notifications
+  // dispatched afterwards are delivered inline.
+  void Stop() noexcept;
+
+  // Stamp, queue on the strand (applying its overflow policy) and make sure
+  // the strand is scheduled.
+  DispatchResult Dispatch(NotificationStrand &strand, std::uint32_t state,
+                          std::int64_t arrival_time,
+                          std::uint32_t root_service_id,
+                          std::shared_ptr<void> payload = {}) noexcept;
+
+  // Set a strand's duplicate policy (strand mutex held). On a change, the
+  // in-flight states and re-runs tracked under the previous policy are
+  // dropped (their payloads released): left set, a state would count as in
+  // flight forever once its action no longer clears it.
+  void SetDuplicatePolicy(NotificationStrand &strand,
+                          DuplicatePolicy duplicate_policy) noexcept;
+
+  // A sequence number for a notification that is not dispatched (filtered).
+  [[nodiscard]] std::uint64_t NextSequence() noexcept {
+    return sequence_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+protected:
+  // Deliver up to 'budget' notifications; returns true if the strand still
+  // has pending ones (and so stays scheduled).
+  bool RunStrand(NotificationStrand &strand, std::size_t budget) noexcept;
+
+  // In-flight deduplication (strand mutex held): whether a notification of
+  // this state is tracked, and the release of its state (returns true,
+  // keeping the state in flight, if a trailing re-run was requested and
+  // 'rerun'; otherwise a request is dropped with its payload).
+  [[nodiscard]] static bool IsTracked(const NotificationStrand &strand,
+                                      std::uint32_t state) noexcept;
+  bool ReleaseInFlight(NotificationStrand &strand, std::uint32_t state,
+                       bool rerun) noexcept;
+
+  // Queue the requested re-run of 'state' in the place of its latest
+  // duplicate (strand mutex held; released if out of memory).
+  void QueueRerun(NotificationStrand &strand, std::uint32_t state) noexcept;
+
+  // Hand a payload that will not be delivered to the ReleaseFunction.
+  void Release(const NotificationStrand &strand,
+               std::shared_ptr<void> payload) const noexcept;
+
+  // Hand a newly scheduled strand to its home worker (or run it inline).
+  void Schedule(NotificationStrand &strand) noexcept;
+
+  // Queue a strand on worker 'worker' and wake a sleeping worker, if any.
+  bool Push(std::size_t worker, NotificationStrand &strand) noexcept;
+
+  // Own queues first, then steal from the others; nullptr if every queue is
+  // empty.
+  [[nodiscard]] NotificationStrand *Pop(std::size_t worker) noexcept;
+
+  // Run every queued strand on this thread (once no worker is left).
+  void DrainInline() noexcept;
+
+  void WorkerLoop(const std::stop_token &stop_token,
+                  std::size_t worker) noexcept;
+
+  struct ReadyStrand {
+    NotificationStrand *strand{nullptr};
+    std::int64_t ready_time{0}; // (MonotonicNanoseconds(): for aging)
+    std::int64_t deadline{kNoDeadline}; // (kEarliestDeadline: the head's)
+  };
+
+  struct alignas(kCacheLineSize) WorkerQueue {
+    std::mutex mutex{};
+    std::array<std::deque<ReadyStrand>, kNotificationPriorityCount>
+        ready{}; // (Guarded by mutex. Index: NotificationPriority)
+    std::vector<ReadyStrand> deadline_ready{}; // (Guarded by mutex.
+                                               // kEarliestDeadline: min-heap
+                                               // by deadline)
+  };
+
+  const DeliverFunction deliver_function_;
+  const ReleaseFunction release_function_;
+
+  alignas(kCacheLineSize) std::atomic<std::uint64_t> sequence_{1};
+
+  std::unique_ptr<WorkerQueue[]> worker_queues_{}; // (One per worker)
+  std::size_t worker_count_{0};
+  std::int64_t priority_aging_{0}; // (Nanoseconds)
+  SchedulingPolicy scheduling_policy_{SchedulingPolicy::kPriority};
+  std::atomic<bool> inline_{true}; // (No workers running)
+
+  // Sleeping workers (the mutex is taken only to sleep or to wake one):
+  alignas(kCacheLineSize) std::atomic<std::ptrdiff_t> pending_{0}; // (Queued
+                                                                   // strands;
+                                                                   // briefly
+                                                                   // negative)
+  std::atomic<std::size_t> sleeping_{0};
+  std::mutex wake_mutex_{};
+  std::condition_variable_any wake_condition_{};
+
+  std::vector<std::jthread> workers_{}; // (Last: joined first on destruction)
+};
+
+#endif
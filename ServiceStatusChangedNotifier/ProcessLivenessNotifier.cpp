@@ -0,0 +1,332 @@
+/*
+   ProcessLivenessNotifier.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "ProcessLivenessNotifier.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434 // (Same number on every architecture)
+#endif
+
+namespace {
+
+// epoll_event.data.u64 = tag << 32 | service index
+enum class EpollTag : std::uint64_t { kProcess, kInotify, kWake };
+
+constexpr std::uint64_t EpollData(const EpollTag tag,
+                                  const std::uint32_t index = 0) noexcept {
+  return static_cast<std::uint64_t>(tag) << 32 | index;
+}
+
+constexpr std::string_view kPidPrefix{"pid:"};
+
+// ParsePid
+// Returns the leading decimal number of 'text' (0 if none).
+int ParsePid(const std::string_view text) noexcept {
+  const auto begin{text.find_first_not_of(" \t")};
+  if (begin == std::string_view::npos) {
+    return 0;
+  }
+  int pid{0};
+  const auto [end, error] =
+      std::from_chars(text.data() + begin, text.data() + text.size(), pid);
+  return error == std::errc{} && pid > 0 ? pid : 0;
+}
+
+// ReadPidFile
+// Returns the process id stored in the file (0 if unreadable / empty).
+int ReadPidFile(const std::string &path) noexcept {
+  const int fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (fd < 0) {
+    return 0;
+  }
+  std::array<char, 32> buffer{};
+  const auto size{read(fd, buffer.data(), buffer.size())};
+  close(fd);
+  return size > 0 ? ParsePid({buffer.data(), static_cast<std::size_t>(size)})
+                  : 0;
+}
+
+} // namespace
+
+// Start
+void ProcessLivenessNotifier::Start(
+    const std::vector<std::string> &service_list,
+    const std::uint32_t notify_mask,
+    const ActionFunction &action_function) noexcept {
+  Stop();
+
+  notify_mask_ = notify_mask;
+  action_function_ = action_function;
+
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epoll_fd_ < 0 || inotify_fd_ < 0 || wake_fd_ < 0) {
+    Stop(); // (Closes whatever was opened.)
+    return;
+  }
+
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.u64 = EpollData(EpollTag::kInotify);
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, inotify_fd_, &event);
+  event.data.u64 = EpollData(EpollTag::kWake);
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+  try {
+    services_.reserve(service_list.size());
+    for (const auto &service_name : service_list) { // For each service name
+      const auto service_index{static_cast<std::uint32_t>(services_.size())};
+      ServiceData &service_data{services_.emplace_back()};
+      service_data.service_name = service_name;
+
+      if (std::string_view(service_name).starts_with(kPidPrefix)) {
+        service_data.pid =
+            ParsePid(std::string_view(service_name).substr(kPidPrefix.size()));
+      } else {
+        // PID file: watch its directory for rewrites (IN_CLOSE_WRITE) and
+        // atomic replacement (IN_MOVED_TO).
+        const std::filesystem::path path(service_name);
+        service_data.pid_file = service_name;
+        service_data.pid_file_name = path.filename().string();
+        const auto directory{path.has_parent_path()
+                                 ? path.parent_path().string()
+                                 : std::string(".")};
+        const int watch_descriptor{
+            inotify_add_watch(inotify_fd_, directory.c_str(),
+                              IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)};
+        if (watch_descriptor >= 0) {
+          pid_file_watches_[watch_descriptor].push_back(service_index);
+        }
+        service_data.pid = ReadPidFile(service_data.pid_file);
+      }
+
+      if (service_data.pid > 0 && Watch(service_index)) {
+        service_data.current_state = SERVICE_NOTIFY_RUNNING;
+      }
+    }
+  } catch (...) {
+    // (Out of memory: watch what was set up so far.)
+  }
+
+  watcher_thread_ = std::jthread(
+      [this](const std::stop_token &stop_token) { Run(stop_token); });
+}
+
+// Stop
+void ProcessLivenessNotifier::Stop() noexcept {
+  if (watcher_thread_.joinable()) {
+    watcher_thread_.request_stop();
+    const std::uint64_t wake{1};
+    [[maybe_unused]] const auto written{write(wake_fd_, &wake, sizeof(wake))};
+    watcher_thread_.join();
+  }
+
+  for (auto &service_data : services_) {
+    if (service_data.pidfd >= 0) {
+      close(service_data.pidfd);
+    }
+  }
+  services_.clear();
+  pid_file_watches_.clear();
+
+  for (int *const fd : {&epoll_fd_, &inotify_fd_, &wake_fd_}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+// Run
+// The watcher thread: one epoll_wait() per batch of ready descriptors.
+void ProcessLivenessNotifier::Run(const std::stop_token &stop_token) noexcept {
+  constexpr int kMaxEvents{256};
+  std::array<epoll_event, kMaxEvents> events{};
+
+  // (inotify records are variable-length; the buffer is aligned for them.)
+  alignas(inotify_event) std::array<char, 64 * 1024> inotify_buffer{};
+
+  while (!stop_token.stop_requested()) {
+    const int ready{epoll_wait(epoll_fd_, events.data(), kMaxEvents, -1)};
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+
+    for (int index{0}; index < ready; ++index) {
+      const auto data{events[index].data.u64};
+      switch (static_cast<EpollTag>(data >> 32)) {
+      case EpollTag::kProcess:
+        OnProcessExit(static_cast<std::uint32_t>(data)); // <-- EXIT
+        break;
+      case EpollTag::kInotify:
+        // Drain every queued record (non-blocking descriptor).
+        for (;;) {
+          const auto size{
+              read(inotify_fd_, inotify_buffer.data(), inotify_buffer.size())};
+          if (size <= 0) {
+            break;
+          }
+          for (std::size_t offset{0};
+               offset < static_cast<std::size_t>(size);) {
+            const auto *const record{reinterpret_cast<const inotify_event *>(
+                inotify_buffer.data() + offset)};
+            if (record->len > 0) {
+              OnPidFileChanged(record->wd, record->name);
+            }
+            offset += sizeof(inotify_event) + record->len;
+          }
+        }
+        break;
+      case EpollTag::kWake:
+        return;
+      }
+    }
+  }
+}
+
+// Watch
+bool ProcessLivenessNotifier::Watch(
+    const std::uint32_t service_index) noexcept {
+  ServiceData &service_data{services_[service_index]};
+  const int pidfd{
+      static_cast<int>(syscall(SYS_pidfd_open, service_data.pid, 0))};
+  if (pidfd < 0) {
+    return false; // (No such process.)
+  }
+
+  // A pidfd becomes readable when the process exits (immediately, if it
+  // already has).
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.u64 = EpollData(EpollTag::kProcess, service_index);
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, pidfd, &event) != 0) {
+    close(pidfd);
+    return false;
+  }
+  service_data.pidfd = pidfd;
+  return true;
+}
+
+// Unwatch
+void ProcessLivenessNotifier::Unwatch(
+    const std::uint32_t service_index) noexcept {
+  ServiceData &service_data{services_[service_index]};
+  if (service_data.pidfd >= 0) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, service_data.pidfd, nullptr);
+    close(service_data.pidfd);
+    service_data.pidfd = -1;
+  }
+}
+
+// OnProcessExit
+void ProcessLivenessNotifier::OnProcessExit(
+    const std::uint32_t service_index) noexcept {
+  ServiceData &service_data{services_[service_index]};
+
+  // (The event may be stale: a PID file change earlier in the same batch can
+  // have replaced the watched process. Only a readable pidfd means exit.)
+  pollfd poll_fd{service_data.pidfd, POLLIN, 0};
+  if (service_data.pidfd < 0 || poll(&poll_fd, 1, 0) <= 0) {
+    return;
+  }
+
+  Unwatch(service_index);
+  if (service_data.current_state != SERVICE_NOTIFY_STOPPED) {
+    service_data.current_state = SERVICE_NOTIFY_STOPPED;
+    Notify(service_data);
+  }
+}
+
+// OnPidFileChanged
+// A file in a watched directory was written or replaced: if it is a watched
+// PID file naming a new process, watch that process (STOPPED if it cannot
+// be watched).
+void ProcessLivenessNotifier::OnPidFileChanged(
+    const int watch_descriptor, const char *const name) noexcept {
+  const auto found{pid_file_watches_.find(watch_descriptor)};
+  if (found == pid_file_watches_.end()) {
+    return;
+  }
+
+  for (const auto service_index : found->second) {
+    ServiceData &service_data{services_[service_index]};
+    if (service_data.pid_file_name != name) {
+      continue;
+    }
+
+    const int pid{ReadPidFile(service_data.pid_file)};
+    if (pid <= 0 || (pid == service_data.pid && service_data.pidfd >= 0)) {
+      continue; // (Empty file, or the same process rewrote it.)
+    }
+
+    // A new process took over: the previous one (if still watched) is
+    // replaced silently; its exit belongs to the restart. If the new one
+    // cannot be watched (already gone, or not ours), nothing runs.
+    Unwatch(service_index);
+    service_data.pid = pid;
+    std::uint32_t current_state{SERVICE_NOTIFY_STOPPED};
+    if (Watch(service_index)) {
+      current_state = SERVICE_NOTIFY_RUNNING;
+    }
+    if (service_data.current_state != current_state) {
+      service_data.current_state = current_state;
+      Notify(service_data);
+    }
+  }
+}
+
+// Notify
+void ProcessLivenessNotifier::Notify(const ServiceData &service_data) noexcept {
+  if (action_function_ &&
+      (service_data.current_state | notify_mask_) == notify_mask_) {
+    try {
+      action_function_(service_data.service_name,
+                       service_data.current_state); // <-- NOTIFY
+    } catch (...) {
+      // (The watcher thread must survive a throwing action.)
+    }
+  }
+}
+
+#endif
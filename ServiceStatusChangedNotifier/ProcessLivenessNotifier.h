@@ -0,0 +1,122 @@
+#ifndef AMITG_FC_PROCESS_LIVENESS_NOTIFIER
+#define AMITG_FC_PROCESS_LIVENESS_NOTIFIER
+
+/*
+   ProcessLivenessNotifier.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "ServiceNotify.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Linux (5.3 or greater) implementation
+// Watches processes as "services", with the ServiceStatusChangedNotifier
+// programming model: Start(service_list, notify_mask, action_function).
+//
+// A service is either:
+//	- "pid:<n>": a process id. Reports SERVICE_NOTIFY_STOPPED when it exits.
+//	- A path to a PID file: reports SERVICE_NOTIFY_STOPPED when the process
+//	  exits and SERVICE_NOTIFY_RUNNING when the PID file is (re)written with a
+//	  live process.
+//
+// Every process is watched through a pidfd (pidfd_open), PID files through
+// one inotify descriptor on their directories, and both are multiplexed on a
+// single epoll instance served by one thread: exits are reported immediately,
+// nothing is polled, and one thread watches tens of thousands of processes
+// (one descriptor each: raise RLIMIT_NOFILE accordingly).
+class ProcessLivenessNotifier final {
+public:
+  using ActionFunction = std::function<void(const std::string &service_name,
+                                            std::uint32_t current_state)>;
+
+  ProcessLivenessNotifier() = default;
+  ~ProcessLivenessNotifier() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  ProcessLivenessNotifier(const ProcessLivenessNotifier &) = delete;
+  ProcessLivenessNotifier &operator=(const ProcessLivenessNotifier &) = delete;
+
+  // Delete move constructor and move assignment operator
+  ProcessLivenessNotifier(ProcessLivenessNotifier &&) = delete;
+  ProcessLivenessNotifier &operator=(ProcessLivenessNotifier &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start watching the specified services (replaces a previous Start()).
+  // action_function is called on the watcher thread.
+  void Start(const std::vector<std::string> &service_list,
+             std::uint32_t notify_mask,
+             const ActionFunction &action_function) noexcept;
+
+  // Stop watching (joins the watcher thread, closes all descriptors).
+  void Stop() noexcept;
+
+protected:
+  // Keeps data per watched service (owned by the watcher thread once
+  // started).
+  struct ServiceData {
+    std::string service_name{};
+    std::string pid_file{};      // (Empty for "pid:<n>" services)
+    std::string pid_file_name{}; // (Base name, matched against inotify events)
+    int pid{0};
+    int pidfd{-1};
+    std::uint32_t current_state{SERVICE_NOTIFY_STOPPED};
+  };
+
+  void Run(const std::stop_token &stop_token) noexcept;
+
+  // Open a pidfd for service_data.pid and add it to the epoll set.
+  // Returns false if the process is not alive.
+  bool Watch(std::uint32_t service_index) noexcept;
+  void Unwatch(std::uint32_t service_index) noexcept;
+
+  void OnProcessExit(std::uint32_t service_index) noexcept;
+  void OnPidFileChanged(int watch_descriptor, const char *name) noexcept;
+  void Notify(const ServiceData &service_data) noexcept;
+
+  std::vector<ServiceData> services_{}; // (Index: service index)
+  std::unordered_map<int, std::vector<std::uint32_t>>
+      pid_file_watches_{}; // Key: inotify watch descriptor, Value: service
+                           // indexes of the PID files in that directory.
+
+  std::uint32_t notify_mask_{0};
+  ActionFunction action_function_{};
+
+  int epoll_fd_{-1};
+  int inotify_fd_{-1};
+  int wake_fd_{-1}; // (eventfd: wakes the watcher thread on Stop())
+
+  std::jthread watcher_thread_{}; // (Last: joined first on destruction)
+};
+
+#endif
+
+#endif
@@ -0,0 +1,313 @@
+/*
+   ProcessScanNotifier.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "ProcessScanNotifier.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t kCommLength{15}; // (TASK_COMM_LEN - 1)
+constexpr std::size_t kDirectoryBufferSize{256 * 1024};
+
+// DirectoryEntry64
+// The record layout of getdents64() (struct linux_dirent64).
+struct DirectoryEntry64 {
+  std::uint64_t inode;
+  std::int64_t offset;
+  unsigned short record_length;
+  unsigned char type;
+  char name[1]; // (Null-terminated)
+};
+
+// ParsePid
+// A /proc entry name that is all digits is a PID.
+bool ParsePid(const char *const name, pid_t &pid) noexcept {
+  const auto length{std::strlen(name)};
+  if (length == 0 || name[0] < '1' || name[0] > '9') {
+    return false;
+  }
+  const auto [end, error]{std::from_chars(name, name + length, pid)};
+  return error == std::errc{} && end == name + length;
+}
+
+} // namespace
+
+// Start
+void ProcessScanNotifier::Start(const std::vector<std::string> &service_list,
+                                const std::uint32_t notify_mask,
+                                const ActionFunction &action_function,
+                                const ProcessScanOptions &options) noexcept {
+  Stop();
+
+  notify_mask_ = notify_mask;
+  action_function_ = action_function;
+  options_ = options;
+  options_.max_interval =
+      std::max(options_.max_interval, options_.min_interval);
+
+  proc_fd_ =
+      open(options_.proc_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (proc_fd_ < 0) {
+    return;
+  }
+
+  try {
+    services_.reserve(service_list.size());
+    for (const auto &service_name : service_list) {
+      const auto service_index{static_cast<std::uint32_t>(services_.size())};
+      if (service_names_
+              .try_emplace(service_name.substr(0, kCommLength), service_index)
+              .second) {
+        services_.push_back({service_name, 0});
+      }
+    }
+    directory_buffer_.resize(kDirectoryBufferSize);
+  } catch (...) {
+    Stop();
+    return;
+  }
+
+  Scan(false); // (Initial states: not notified.)
+
+  scanner_thread_ = std::jthread(
+      [this](const std::stop_token &stop_token) { Run(stop_token); });
+}
+
+// Stop
+void ProcessScanNotifier::Stop() noexcept {
+  if (scanner_thread_.joinable()) {
+    scanner_thread_.request_stop(); // (Wakes the condition variable)
+    scanner_thread_.join();
+  }
+
+  if (proc_fd_ >= 0) {
+    close(proc_fd_);
+    proc_fd_ = -1;
+  }
+
+  services_.clear();
+  service_names_.clear();
+  previous_pids_.clear();
+  current_pids_.clear();
+  matched_pids_.clear();
+}
+
+// GetStatistics
+ProcessScanStatistics ProcessScanNotifier::GetStatistics() const noexcept {
+  return {scans_.load(std::memory_order_relaxed),
+          scan_cpu_time_.load(std::memory_order_relaxed),
+          std::chrono::milliseconds(interval_.load(std::memory_order_relaxed))};
+}
+
+// Run
+// The scanner thread: scan, then adapt the interval to the churn observed
+// among the watched processes.
+void ProcessScanNotifier::Run(const std::stop_token &stop_token) noexcept {
+  const auto thread_cpu_time = [] {
+    timespec time{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return static_cast<std::uint64_t>(time.tv_sec) * 1'000'000'000 +
+           static_cast<std::uint64_t>(time.tv_nsec);
+  };
+  auto interval{options_.min_interval};
+  interval_.store(interval.count(), std::memory_order_relaxed);
+
+  std::unique_lock lock(mutex_);
+  while (!condition_.wait_for(lock, stop_token, interval,
+                              [] { return false; })) {
+    if (stop_token.stop_requested()) {
+      break;
+    }
+    const auto scan_start{thread_cpu_time()};
+    const auto churn{Scan(true)};
+    scans_.fetch_add(1, std::memory_order_relaxed);
+    scan_cpu_time_.fetch_add(thread_cpu_time() - scan_start,
+                             std::memory_order_relaxed);
+    if (churn != 0) {
+      interval = std::max(options_.min_interval, interval / 2);
+    } else {
+      interval =
+          std::min(options_.max_interval,
+                   interval + interval / 2 + std::chrono::milliseconds(1));
+    }
+    interval_.store(interval.count(), std::memory_order_relaxed);
+  }
+}
+
+// Scan
+std::size_t ProcessScanNotifier::Scan(const bool notify) noexcept {
+  if (!ReadPids()) {
+    return 0;
+  }
+
+  std::size_t churn{0};
+  merged_pids_.clear();
+  try {
+    // (At most every matched PID kept plus every current one new: the walk
+    // below cannot allocate.)
+    merged_pids_.reserve(matched_pids_.size() + current_pids_.size());
+  } catch (...) {
+    return 0; // (Out of memory: skip this scan.)
+  }
+
+  // (Both PID lists are sorted: one merge walk finds the new and the vanished
+  // PIDs, and keeps matched_pids_ sorted.)
+  auto previous{previous_pids_.cbegin()};
+  auto current{current_pids_.cbegin()};
+  auto matched{matched_pids_.cbegin()};
+  while (previous != previous_pids_.cend() || current != current_pids_.cend()) {
+    if (current == current_pids_.cend() ||
+        (previous != previous_pids_.cend() && *previous < *current)) {
+      // Vanished
+      while (matched != matched_pids_.cend() && matched->first < *previous) {
+        merged_pids_.push_back(*matched++);
+      }
+      if (matched != matched_pids_.cend() && matched->first == *previous) {
+        ServiceData &service_data{services_[matched->second]};
+        ++churn;
+        if (--service_data.process_count == 0 && notify) {
+          Notify(service_data, SERVICE_NOTIFY_STOPPED);
+        }
+        ++matched;
+      }
+      ++previous;
+    } else if (previous == previous_pids_.cend() || *current < *previous) {
+      // New
+      while (matched != matched_pids_.cend() && matched->first < *current) {
+        merged_pids_.push_back(*matched++);
+      }
+      if (const auto service_index{MatchService(*current)};
+          service_index >= 0) {
+        merged_pids_.emplace_back(*current,
+                                  static_cast<std::uint32_t>(service_index));
+        ServiceData &service_data{services_[service_index]};
+        ++churn;
+        if (service_data.process_count++ == 0 && notify) {
+          Notify(service_data, SERVICE_NOTIFY_RUNNING);
+        }
+      }
+      ++current;
+    } else {
+      ++previous; // (Still there)
+      ++current;
+    }
+  }
+  merged_pids_.insert(merged_pids_.end(), matched, matched_pids_.cend());
+
+  matched_pids_.swap(merged_pids_);
+  previous_pids_.swap(current_pids_);
+  return churn;
+}
+
+// ReadPids
+bool ProcessScanNotifier::ReadPids() noexcept {
+  current_pids_.clear();
+  if (lseek(proc_fd_, 0, SEEK_SET) != 0) {
+    return false;
+  }
+
+  try {
+    for (;;) {
+      const auto size{syscall(SYS_getdents64, proc_fd_,
+                              directory_buffer_.data(),
+                              directory_buffer_.size())};
+      if (size < 0) {
+        return false;
+      }
+      if (size == 0) {
+        break;
+      }
+      for (long offset{0}; offset < size;) {
+        const auto *const entry{reinterpret_cast<const DirectoryEntry64 *>(
+            directory_buffer_.data() + offset)};
+        offset += entry->record_length;
+        if (pid_t pid{0}; entry->type == DT_DIR && ParsePid(entry->name, pid)) {
+          current_pids_.push_back(pid); // (Grows only past the largest scan)
+        }
+      }
+    }
+  } catch (...) {
+    return false;
+  }
+
+  std::ranges::sort(current_pids_); // (Already ascending in practice)
+  return true;
+}
+
+// MatchService
+std::ptrdiff_t
+ProcessScanNotifier::MatchService(const pid_t pid) const noexcept {
+  std::array<char, 32> path{};
+  auto [path_end, error]{
+      std::to_chars(path.data(), path.data() + path.size() - 6, pid)};
+  if (error != std::errc{}) {
+    return -1;
+  }
+  std::memcpy(path_end, "/comm", 6);
+
+  const int comm_fd{openat(proc_fd_, path.data(), O_RDONLY | O_CLOEXEC)};
+  if (comm_fd < 0) {
+    return -1; // (Already gone)
+  }
+  std::array<char, 64> comm{};
+  const auto size{read(comm_fd, comm.data(), comm.size())};
+  close(comm_fd);
+  if (size <= 0) {
+    return -1;
+  }
+
+  std::string_view name{comm.data(), static_cast<std::size_t>(size)};
+  if (name.back() == '\n') {
+    name.remove_suffix(1);
+  }
+  const auto found{service_names_.find(name)};
+  return found == service_names_.end()
+             ? -1
+             : static_cast<std::ptrdiff_t>(found->second);
+}
+
+// Notify
+void ProcessScanNotifier::Notify(const ServiceData &service_data,
+                                 const std::uint32_t state) noexcept {
+  if (action_function_ && (state | notify_mask_) == notify_mask_) {
+    try {
+      action_function_(service_data.service_name, state); // <-- NOTIFY
+    } catch (...) {
+      // (The scanner thread must survive a throwing action.)
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef AMITG_FC_PROCESS_SCAN_NOTIFIER
+#define AMITG_FC_PROCESS_SCAN_NOTIFIER
+
+/*
+   ProcessScanNotifier.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "ServiceNotify.h"
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ProcessScanOptions
+struct ProcessScanOptions {
+  // The scan interval shrinks toward min_interval while processes of the
+  // watched names come and go, and grows toward max_interval while they are
+  // quiet (other processes starting and exiting do not count).
+  std::chrono::milliseconds min_interval{100};
+  std::chrono::milliseconds max_interval{2000};
+  std::string proc_path{"/proc"}; // (E.g. the host's, mounted in a container)
+};
+
+// ProcessScanStatistics
+struct ProcessScanStatistics {
+  std::uint64_t scans{0};
+  std::uint64_t scan_cpu_time{0}; // (Nanoseconds: scanner thread CPU time)
+  std::chrono::milliseconds interval{0}; // (Current)
+};
+
+// Linux implementation for name-matched processes (/proc scanning)
+// For processes that cannot be watched through a pidfd (no PID file): a
+// service is a process name, matched against /proc/<pid>/comm (the first 15
+// characters). A service is SERVICE_NOTIFY_RUNNING while at least one process
+// of that name exists, SERVICE_NOTIFY_STOPPED otherwise.
+//
+// Every scan reads the /proc directory with getdents64() into a buffer
+// allocated once, collects the PIDs into a reused vector, sorts it and diffs
+// it against the previous scan: only new PIDs have their comm read, and only
+// vanished PIDs are looked up. (A PID that exits and is reused between two
+// scans is not seen.)
+class ProcessScanNotifier final {
+public:
+  using ActionFunction = std::function<void(const std::string &service_name,
+                                            std::uint32_t current_state)>;
+
+  ProcessScanNotifier() = default;
+  ~ProcessScanNotifier() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  ProcessScanNotifier(const ProcessScanNotifier &) = delete;
+  ProcessScanNotifier &operator=(const ProcessScanNotifier &) = delete;
+
+  // Delete move constructor and move assignment operator
+  ProcessScanNotifier(ProcessScanNotifier &&) = delete;
+  ProcessScanNotifier &operator=(ProcessScanNotifier &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start scanning for the specified process names (replaces a previous
+  // Start()). The first scan runs synchronously and sets the initial states
+  // without notifying; action_function is then called on the scanner thread.
+  void Start(const std::vector<std::string> &service_list,
+             std::uint32_t notify_mask, const ActionFunction &action_function,
+             const ProcessScanOptions &options = {}) noexcept;
+
+  // Stop scanning (joins the scanner thread).
+  void Stop() noexcept;
+
+  [[nodiscard]] ProcessScanStatistics GetStatistics() const noexcept;
+
+protected:
+  struct ServiceData {
+    std::string service_name{};
+    std::uint32_t process_count{0};
+  };
+
+  // (Heterogeneous lookup: find a comm string_view without a std::string.)
+  struct NameHash {
+    using is_transparent = void;
+    std::size_t operator()(const std::string_view name) const noexcept {
+      return std::hash<std::string_view>{}(name);
+    }
+  };
+
+  void Run(const std::stop_token &stop_token) noexcept;
+
+  // One scan; returns the number of matched PIDs (processes of a watched
+  // name) that appeared or vanished.
+  std::size_t Scan(bool notify) noexcept;
+
+  // Read the PIDs of /proc into current_pids_ (sorted).
+  bool ReadPids() noexcept;
+
+  // The index of the service named by the comm of 'pid', or -1.
+  [[nodiscard]] std::ptrdiff_t MatchService(pid_t pid) const noexcept;
+
+  void Notify(const ServiceData &service_data, std::uint32_t state) noexcept;
+
+  std::vector<ServiceData> services_{}; // (Index: service index)
+  std::unordered_map<std::string, std::uint32_t, NameHash, std::equal_to<>>
+      service_names_{}; // Key: comm (15 characters), Value: service index
+
+  std::vector<pid_t> previous_pids_{}; // (Sorted)
+  std::vector<pid_t> current_pids_{};  // (Sorted)
+  std::vector<std::pair<pid_t, std::uint32_t>>
+      matched_pids_{}; // (Sorted by PID: PID, service index)
+  std::vector<std::pair<pid_t, std::uint32_t>> merged_pids_{}; // (Scratch)
+  std::vector<char> directory_buffer_{}; // (getdents64())
+
+  std::uint32_t notify_mask_{0};
+  ActionFunction action_function_{};
+  ProcessScanOptions options_{};
+
+  int proc_fd_{-1};
+
+  std::atomic<std::uint64_t> scans_{0};
+  std::atomic<std::uint64_t> scan_cpu_time_{0};
+  std::atomic<std::int64_t> interval_{0}; // (Milliseconds)
+
+  std::mutex mutex_{};
+  std::condition_variable_any condition_{}; // (Interrupted by Stop())
+
+  std::jthread scanner_thread_{}; // (Last: joined first on destruction)
+};
+
+#endif
+
+#endif
@@ -0,0 +1,394 @@
+/*
+   ReadinessNotifier.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "ReadinessNotifier.h"
+
+#include "MonotonicClock.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+// DeadlineLater
+// Heap order: the earliest deadline on top.
+constexpr auto DeadlineLater{[](const auto &left, const auto &right) noexcept {
+  return left.deadline > right.deadline;
+}};
+
+// ParseUnsigned
+bool ParseUnsigned(const std::string_view text, std::uint64_t &value) noexcept {
+  const auto [end, error]{
+      std::from_chars(text.data(), text.data() + text.size(), value)};
+  return error == std::errc{} && end == text.data() + text.size();
+}
+
+} // namespace
+
+// Start
+bool ReadinessNotifier::Start(const std::string &socket_path,
+                              const std::vector<std::string> &service_list,
+                              const std::uint32_t notify_mask,
+                              const ActionFunction &action_function,
+                              const ReadinessOptions &options) noexcept {
+  Stop();
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+  const bool abstract{socket_path.front() == '@'};
+  if (abstract) {
+    address.sun_path[0] = '\0';
+  }
+  const auto address_size{
+      static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) +
+                             socket_path.size() + (abstract ? 0 : 1))};
+
+  try {
+    notify_mask_ = notify_mask;
+    action_function_ = action_function;
+    socket_path_ = socket_path;
+
+    services_.reserve(service_list.size());
+    for (const auto &service_name : service_list) {
+      const auto found{options.service_watchdog_intervals.find(service_name)};
+      const auto interval{found == options.service_watchdog_intervals.end()
+                              ? options.watchdog_interval
+                              : found->second};
+      services_.push_back(
+          {.service_name = service_name,
+           .watchdog_interval = std::max<std::int64_t>(
+               std::chrono::nanoseconds(interval).count(), 0)});
+    }
+
+    buffers_.resize(kBatchSize);
+    messages_.resize(kBatchSize);
+    vectors_.resize(kBatchSize);
+  } catch (...) {
+    Stop();
+    return false;
+  }
+
+  socket_fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  const int pass_credentials{1};
+  if (!abstract) {
+    unlink(socket_path.c_str()); // (A stale socket of a previous run)
+  }
+  if (socket_fd_ < 0 || wake_fd_ < 0 ||
+      setsockopt(socket_fd_, SOL_SOCKET, SO_PASSCRED, &pass_credentials,
+                 sizeof(pass_credentials)) != 0 ||
+      bind(socket_fd_, reinterpret_cast<const sockaddr *>(&address),
+           address_size) != 0) {
+    Stop(); // (Closes whatever was opened.)
+    return false;
+  }
+
+  listener_thread_ = std::jthread(
+      [this](const std::stop_token &stop_token) { Run(stop_token); });
+  return true;
+}
+
+// Stop
+void ReadinessNotifier::Stop() noexcept {
+  if (listener_thread_.joinable()) {
+    listener_thread_.request_stop();
+    const std::uint64_t wake{1};
+    [[maybe_unused]] const auto written{write(wake_fd_, &wake, sizeof(wake))};
+    listener_thread_.join();
+  }
+
+  for (int *const fd : {&socket_fd_, &wake_fd_}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+  if (!socket_path_.empty() && socket_path_.front() != '@') {
+    unlink(socket_path_.c_str());
+  }
+  socket_path_.clear();
+
+  services_.clear();
+  watchdogs_.clear();
+}
+
+// Run
+// The listener thread: wait for datagrams or the next watchdog deadline.
+void ReadinessNotifier::Run(const std::stop_token &stop_token) noexcept {
+  std::array<pollfd, 2> poll_fds{{{socket_fd_, POLLIN, 0},
+                                  {wake_fd_, POLLIN, 0}}};
+
+  while (!stop_token.stop_requested()) {
+    const int timeout{ExpireWatchdogs()};
+    if (poll(poll_fds.data(), poll_fds.size(), timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    if (poll_fds[1].revents != 0) {
+      return; // (Stop())
+    }
+    if (poll_fds[0].revents != 0) {
+      Receive();
+    }
+  }
+}
+
+// Receive
+void ReadinessNotifier::Receive() noexcept {
+  for (;;) {
+    for (std::size_t index{0}; index < kBatchSize; ++index) {
+      vectors_[index] = {buffers_[index].data.data(), kMessageSize};
+      messages_[index] = {};
+      messages_[index].msg_hdr.msg_iov = &vectors_[index];
+      messages_[index].msg_hdr.msg_iovlen = 1;
+      messages_[index].msg_hdr.msg_control = buffers_[index].control.data();
+      messages_[index].msg_hdr.msg_controllen = buffers_[index].control.size();
+    }
+
+    const int received{recvmmsg(socket_fd_, messages_.data(),
+                                static_cast<unsigned>(kBatchSize),
+                                MSG_DONTWAIT | MSG_CMSG_CLOEXEC, nullptr)};
+    if (received <= 0) {
+      return; // (Drained, or an error: wait for the next wakeup.)
+    }
+
+    for (int index{0}; index < received; ++index) {
+      auto &header{messages_[index].msg_hdr};
+      if ((header.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+        continue; // (Not a well-formed notification)
+      }
+
+      pid_t pid{0};
+      for (auto *control{CMSG_FIRSTHDR(&header)}; control != nullptr;
+           control = CMSG_NXTHDR(&header, control)) {
+        if (control->cmsg_level == SOL_SOCKET &&
+            control->cmsg_type == SCM_CREDENTIALS) {
+          ucred credentials{};
+          std::memcpy(&credentials, CMSG_DATA(control), sizeof(credentials));
+          pid = credentials.pid;
+        } else if (control->cmsg_level == SOL_SOCKET &&
+                   control->cmsg_type == SCM_RIGHTS) {
+          // (sd_notify FDSTORE: the descriptors are not kept.)
+          const auto count{(control->cmsg_len - CMSG_LEN(0)) / sizeof(int)};
+          for (std::size_t fd_index{0}; fd_index < count; ++fd_index) {
+            int fd{-1};
+            std::memcpy(&fd, CMSG_DATA(control) + fd_index * sizeof(int),
+                        sizeof(int));
+            close(fd);
+          }
+        }
+      }
+
+      if (pid > 0) {
+        HandleMessage({buffers_[index].data.data(), messages_[index].msg_len},
+                      pid);
+      }
+    }
+
+    if (static_cast<std::size_t>(received) < kBatchSize) {
+      return; // (Drained)
+    }
+  }
+}
+
+// HandleMessage
+// A message is a list of newline-separated KEY=VALUE assignments.
+void ReadinessNotifier::HandleMessage(std::string_view message,
+                                      const pid_t pid) noexcept {
+  const auto service_index{FindService(pid)};
+  if (service_index < 0) {
+    return; // (Not one of ours)
+  }
+  ServiceData &service_data{services_[service_index]};
+
+  std::uint32_t new_state{0};
+  bool heartbeat{false};
+  bool triggered{false};
+
+  while (!message.empty()) {
+    const auto line_end{message.find('\n')};
+    const auto line{message.substr(0, line_end)};
+    message.remove_prefix(line_end == std::string_view::npos ? message.size()
+                                                             : line_end + 1);
+
+    const auto separator{line.find('=')};
+    if (separator == std::string_view::npos) {
+      continue;
+    }
+    const auto key{line.substr(0, separator)};
+    const auto value{line.substr(separator + 1)};
+
+    if (key == "READY" && value == "1") {
+      new_state = SERVICE_NOTIFY_RUNNING;
+      heartbeat = true; // (Watched from readiness on)
+    } else if (key == "RELOADING" && value == "1") {
+      new_state = SERVICE_NOTIFY_START_PENDING;
+    } else if (key == "STOPPING" && value == "1") {
+      new_state = SERVICE_NOTIFY_STOP_PENDING;
+    } else if (key == "STATUS") {
+      try {
+        service_data.status.assign(value);
+      } catch (...) {
+        // (Out of memory: the previous status is kept.)
+      }
+    } else if (key == "WATCHDOG") {
+      heartbeat = heartbeat || value == "1";
+      triggered = value == "trigger";
+    } else if (key == "WATCHDOG_USEC") {
+      std::uint64_t microseconds{0};
+      if (ParseUnsigned(value, microseconds) &&
+          microseconds < static_cast<std::uint64_t>(LLONG_MAX / 1000)) {
+        service_data.watchdog_interval =
+            static_cast<std::int64_t>(microseconds) * 1000;
+        heartbeat = true; // (A new interval counts from now.)
+      }
+    }
+  }
+
+  if (heartbeat) {
+    ArmWatchdog(static_cast<std::uint32_t>(service_index));
+  }
+  if (new_state == SERVICE_NOTIFY_STOP_PENDING) {
+    ++service_data.watchdog_generation; // (A stopping service is not watched.)
+  }
+  if (new_state != 0 && new_state != service_data.current_state) {
+    service_data.current_state = new_state;
+    Notify(service_data, new_state);
+  }
+  if (triggered) {
+    ++service_data.watchdog_generation;
+    Notify(service_data, SERVICE_NOTIFY_WATCHDOG_MISSED);
+  }
+}
+
+// ArmWatchdog
+void ReadinessNotifier::ArmWatchdog(
+    const std::uint32_t service_index) noexcept {
+  ServiceData &service_data{services_[service_index]};
+  const auto generation{++service_data.watchdog_generation};
+  if (service_data.watchdog_interval <= 0) {
+    return;
+  }
+
+  try {
+    watchdogs_.push_back(
+        {MonotonicNanoseconds() + service_data.watchdog_interval, service_index,
+         generation});
+    std::ranges::push_heap(watchdogs_, DeadlineLater);
+  } catch (...) {
+    // (Out of memory: this heartbeat is not watched.)
+  }
+}
+
+// ExpireWatchdogs
+int ReadinessNotifier::ExpireWatchdogs() noexcept {
+  const auto now{MonotonicNanoseconds()};
+  while (!watchdogs_.empty()) {
+    const auto top{watchdogs_.front()};
+    ServiceData &service_data{services_[top.service_index]};
+    if (top.generation == service_data.watchdog_generation &&
+        top.deadline > now) {
+      // (Round up: never wake before the deadline.)
+      constexpr std::int64_t kNanosecondsPerMillisecond{1'000'000};
+      return static_cast<int>(std::min<std::int64_t>(
+          (top.deadline - now + kNanosecondsPerMillisecond - 1) /
+              kNanosecondsPerMillisecond,
+          INT_MAX));
+    }
+
+    std::ranges::pop_heap(watchdogs_, DeadlineLater);
+    watchdogs_.pop_back();
+
+    if (top.generation == service_data.watchdog_generation) {
+      ++service_data.watchdog_generation; // (Reported once per miss)
+      Notify(service_data, SERVICE_NOTIFY_WATCHDOG_MISSED);
+    }
+  }
+  return -1;
+}
+
+// Notify
+void ReadinessNotifier::Notify(ServiceData &service_data,
+                               const std::uint32_t state) noexcept {
+  if (action_function_ && (state | notify_mask_) == notify_mask_) {
+    try {
+      action_function_(service_data.service_name, state,
+                       service_data.status); // <-- NOTIFY
+    } catch (...) {
+      // (The listener thread must survive a throwing action.)
+    }
+  }
+}
+
+// FindService
+std::ptrdiff_t ReadinessNotifier::FindService(const pid_t pid) const noexcept {
+  // (Read per message: a cached pid could have been reused by now.)
+  std::array<char, 32> path{"/proc/"};
+  auto [path_end, error]{std::to_chars(path.data() + 6,
+                                       path.data() + path.size() - 6,
+                                       static_cast<long>(pid))};
+  if (error != std::errc{}) {
+    return -1;
+  }
+  std::memcpy(path_end, "/comm", 6);
+
+  const int comm_fd{open(path.data(), O_RDONLY | O_CLOEXEC)};
+  if (comm_fd < 0) {
+    return -1;
+  }
+  std::array<char, 64> comm{};
+  const auto size{read(comm_fd, comm.data(), comm.size())};
+  close(comm_fd);
+  if (size <= 0) {
+    return -1;
+  }
+
+  std::string_view name{comm.data(), static_cast<std::size_t>(size)};
+  if (name.back() == '\n') {
+    name.remove_suffix(1);
+  }
+  // (comm is truncated to 15 characters.)
+  const auto found{std::ranges::find_if(services_, [name](const auto &data) {
+    return std::string_view{data.service_name}.substr(0, 15) == name;
+  })};
+  return found == services_.end() ? -1 : found - services_.begin();
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef AMITG_FC_READINESS_NOTIFIER
+#define AMITG_FC_READINESS_NOTIFIER
+
+/*
+   ReadinessNotifier.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "ServiceNotify.h"
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// ReadinessOptions
+struct ReadinessOptions {
+  // The watchdog interval of every listed service (0: disarmed until the
+  // service sends WATCHDOG_USEC=), and per-service exceptions by name. The
+  // deadline is armed by READY=1 and re-armed by every WATCHDOG=1; a service's
+  // WATCHDOG_USEC= overrides its configured interval at runtime.
+  std::chrono::microseconds watchdog_interval{0};
+  std::unordered_map<std::string, std::chrono::microseconds>
+      service_watchdog_intervals{};
+};
+
+// Linux implementation for the sd_notify readiness protocol
+// Binds a datagram socket (give its path to the services as $NOTIFY_SOCKET;
+// a leading '@' selects the abstract namespace) and maps the sd_notify
+// messages of the listed services onto states:
+//	- READY=1                  -> SERVICE_NOTIFY_RUNNING (arms the watchdog)
+//	- RELOADING=1              -> SERVICE_NOTIFY_START_PENDING
+//	- STOPPING=1               -> SERVICE_NOTIFY_STOP_PENDING
+//	- WATCHDOG=1               -> heartbeat (re-arms the watchdog deadline)
+//	- WATCHDOG_USEC=<n>        -> overrides the watchdog interval (0: disarmed)
+//	- WATCHDOG=trigger, or no
+//	  heartbeat within the
+//	  interval                 -> SERVICE_NOTIFY_WATCHDOG_MISSED
+//	- STATUS=<text>            -> kept, passed to the action
+// The sender is identified by its kernel-supplied credentials (SO_PASSCRED):
+// a service name is matched against /proc/<pid>/comm of the sending process.
+//
+// Each wakeup drains up to kBatchSize datagrams with one recvmmsg() into
+// buffers allocated once by Start(); messages are parsed in place. Watchdog
+// deadlines live in one min-heap (stale entries are skipped when popped),
+// whose top bounds the wait.
+class ReadinessNotifier final {
+public:
+  using ActionFunction = std::function<void(const std::string &service_name,
+                                            std::uint32_t current_state,
+                                            std::string_view status)>;
+
+  static constexpr std::size_t kBatchSize{32};
+  static constexpr std::size_t kMessageSize{4096}; // (systemd's limit)
+
+  ReadinessNotifier() = default;
+  ~ReadinessNotifier() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  ReadinessNotifier(const ReadinessNotifier &) = delete;
+  ReadinessNotifier &operator=(const ReadinessNotifier &) = delete;
+
+  // Delete move constructor and move assignment operator
+  ReadinessNotifier(ReadinessNotifier &&) = delete;
+  ReadinessNotifier &operator=(ReadinessNotifier &&) = delete;
+
+  // __Since non-default destructor
+
+  // Bind socket_path and start listening for the specified services (replaces
+  // a previous Start()). Returns false if the socket could not be bound.
+  // action_function is called on the listener thread.
+  bool Start(const std::string &socket_path,
+             const std::vector<std::string> &service_list,
+             std::uint32_t notify_mask, const ActionFunction &action_function,
+             const ReadinessOptions &options = {}) noexcept;
+
+  // Stop listening (joins the listener thread, closes and unlinks the socket).
+  void Stop() noexcept;
+
+protected:
+  struct ServiceData {
+    std::string service_name{};
+    std::uint32_t current_state{SERVICE_NOTIFY_STOPPED};
+    std::string status{}; // (Last STATUS=)
+    std::int64_t watchdog_interval{0}; // (Nanoseconds; 0: disarmed)
+    std::uint64_t watchdog_generation{0}; // (Bumped by every heartbeat)
+  };
+
+  struct WatchdogDeadline {
+    std::int64_t deadline{0}; // (MonotonicNanoseconds())
+    std::uint32_t service_index{0};
+    std::uint64_t generation{0}; // (Stale unless equal to the service's)
+  };
+
+  struct MessageBuffer {
+    std::array<char, kMessageSize> data{};
+    alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(ucred))> control{};
+  };
+
+  void Run(const std::stop_token &stop_token) noexcept;
+
+  // Drain the socket: one recvmmsg() per batch until it would block.
+  void Receive() noexcept;
+
+  // Parse one datagram and apply it to the sending service.
+  void HandleMessage(std::string_view message, pid_t pid) noexcept;
+
+  // Notify about missed watchdog deadlines; returns the wait (milliseconds)
+  // until the next one, or -1.
+  int ExpireWatchdogs() noexcept;
+
+  void ArmWatchdog(std::uint32_t service_index) noexcept;
+  void Notify(ServiceData &service_data, std::uint32_t state) noexcept;
+
+  // The index of the service whose name is the comm of 'pid', or -1.
+  [[nodiscard]] std::ptrdiff_t FindService(pid_t pid) const noexcept;
+
+  std::vector<ServiceData> services_{}; // (Index: service index)
+  std::vector<WatchdogDeadline> watchdogs_{}; // (Min-heap by deadline)
+
+  std::vector<MessageBuffer> buffers_{}; // (kBatchSize entries)
+  std::vector<mmsghdr> messages_{};      // (kBatchSize entries)
+  std::vector<iovec> vectors_{};         // (kBatchSize entries)
+
+  std::uint32_t notify_mask_{0};
+  ActionFunction action_function_{};
+
+  std::string socket_path_{}; // (Unlinked by Stop(), unless abstract)
+  int socket_fd_{-1};
+  int wake_fd_{-1}; // (eventfd: wakes the listener thread on Stop())
+
+  std::jthread listener_thread_{}; // (Last: joined first on destruction)
+};
+
+#endif
+
+#endif
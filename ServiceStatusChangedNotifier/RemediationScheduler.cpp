@@ -0,0 +1,233 @@
+/*
+   RemediationScheduler.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "RemediationScheduler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Task
+// One failed service (index: task index, not service id).
+struct Task {
+  std::uint32_t service_id{0};
+  std::uint32_t rank{0};              // (Topological: lower first)
+  std::uint32_t pending{0};           // (Failed dependencies not restarted)
+  std::uint32_t attempts{0};
+  std::vector<std::uint32_t> dependents{}; // (Task indexes)
+  bool resolved{false};
+};
+
+struct Retry {
+  Clock::time_point due{};
+  std::uint32_t task{0};
+};
+
+// RemediationRun
+// The state of one Run(), shared by its threads (guarded by mutex).
+struct RemediationRun {
+  std::mutex mutex{};
+  std::condition_variable_any condition{};
+  std::vector<Task> tasks{};
+  std::priority_queue<std::pair<std::uint32_t, std::uint32_t>,
+                      std::vector<std::pair<std::uint32_t, std::uint32_t>>,
+                      std::greater<>>
+      ready{}; // (rank, task): lowest rank on top
+  std::vector<Retry> retries{}; // (Min-heap on due)
+  std::size_t unresolved{0};
+  std::size_t running{0}; // (Restarts in flight)
+  RemediationResult result{};
+
+  // Skip the unresolved dependents of a task, transitively.
+  void SkipDependents(const std::uint32_t task) {
+    std::vector<std::uint32_t> stack{tasks[task].dependents};
+    while (!stack.empty()) {
+      Task &dependent{tasks[stack.back()]};
+      stack.pop_back();
+      if (!dependent.resolved) {
+        dependent.resolved = true;
+        --unresolved;
+        result.skipped.push_back(dependent.service_id);
+        stack.insert(stack.end(), dependent.dependents.begin(),
+                     dependent.dependents.end());
+      }
+    }
+  }
+};
+
+constexpr auto RetryLater{[](const Retry &left, const Retry &right) noexcept {
+  return left.due > right.due;
+}};
+
+} // namespace
+
+// Run
+RemediationResult
+RemediationScheduler::Run(const ServiceDependencyGraph &graph,
+                          const std::vector<std::uint32_t> &failed_services,
+                          const std::stop_token stop_token) const {
+  RemediationRun run;
+
+  // The failed set, and the dependency edges inside it.
+  std::unordered_map<std::uint32_t, std::uint32_t>
+      task_indexes; // Key: service id, Value: task index
+  for (const auto service_id : failed_services) {
+    if (service_id < graph.ServiceCount() &&
+        task_indexes.try_emplace(service_id, run.tasks.size()).second) {
+      run.tasks.push_back({service_id, graph.Rank(service_id)});
+    }
+  }
+  for (std::uint32_t task{0}; task < run.tasks.size(); ++task) {
+    for (const auto dependency :
+         graph.Dependencies(run.tasks[task].service_id)) {
+      if (const auto found{task_indexes.find(dependency)};
+          found != task_indexes.end()) {
+        ++run.tasks[task].pending;
+        run.tasks[found->second].dependents.push_back(task);
+      }
+    }
+  }
+  for (std::uint32_t task{0}; task < run.tasks.size(); ++task) {
+    if (run.tasks[task].pending == 0) {
+      run.ready.emplace(run.tasks[task].rank, task);
+    }
+  }
+  run.unresolved = run.tasks.size();
+
+  const auto backoff = [this](const std::uint32_t attempts) {
+    auto delay{options_.initial_backoff};
+    for (std::uint32_t attempt{1};
+         attempt < attempts && delay < options_.max_backoff; ++attempt) {
+      delay *= 2;
+    }
+    return std::min(delay, options_.max_backoff);
+  };
+
+  const auto worker = [&] {
+    std::unique_lock lock(run.mutex);
+    for (;;) {
+      // Wait for a ready service or a due retry.
+      while (!stop_token.stop_requested() && run.unresolved != 0 &&
+             run.ready.empty()) {
+        if (!run.retries.empty() &&
+            run.retries.front().due <= Clock::now()) {
+          std::ranges::pop_heap(run.retries, RetryLater);
+          const auto task{run.retries.back().task};
+          run.retries.pop_back();
+          run.ready.emplace(run.tasks[task].rank, task);
+          break;
+        }
+        if (run.retries.empty() && run.running == 0) {
+          // Nothing can become ready: the rest wait on a dependency cycle.
+          for (auto &task : run.tasks) {
+            if (!task.resolved) {
+              task.resolved = true;
+              run.result.skipped.push_back(task.service_id);
+            }
+          }
+          run.unresolved = 0;
+          run.condition.notify_all();
+        } else if (run.retries.empty()) {
+          run.condition.wait(lock, stop_token, [&run] {
+            return !run.ready.empty() || !run.retries.empty() ||
+                   run.unresolved == 0;
+          });
+        } else {
+          // (Re-evaluated when an earlier retry is queued, or this one is
+          // taken: the deadline waited for is no longer the first.)
+          const auto due{run.retries.front().due};
+          run.condition.wait_until(lock, stop_token, due, [&run, due] {
+            return !run.ready.empty() || run.unresolved == 0 ||
+                   run.retries.empty() || run.retries.front().due != due;
+          });
+        }
+      }
+      if (stop_token.stop_requested() || run.unresolved == 0) {
+        return;
+      }
+
+      const auto task{run.ready.top().second};
+      run.ready.pop();
+      const auto service_id{run.tasks[task].service_id};
+      ++run.running;
+
+      lock.unlock();
+      bool restarted{false};
+      try {
+        restarted = restart_function_(service_id); // <-- RESTART
+      } catch (...) {
+      }
+      lock.lock();
+      --run.running;
+
+      Task &current{run.tasks[task]};
+      ++current.attempts;
+      ++run.result.attempts;
+      if (restarted) {
+        current.resolved = true;
+        --run.unresolved;
+        run.result.restarted.push_back(service_id);
+        for (const auto dependent : current.dependents) {
+          if (--run.tasks[dependent].pending == 0 &&
+              !run.tasks[dependent].resolved) {
+            run.ready.emplace(run.tasks[dependent].rank, dependent);
+          }
+        }
+      } else if (current.attempts < options_.max_attempts) {
+        run.retries.push_back(
+            {Clock::now() + backoff(current.attempts), task});
+        std::ranges::push_heap(run.retries, RetryLater);
+      } else {
+        current.resolved = true;
+        --run.unresolved;
+        run.result.failed.push_back(service_id);
+        run.SkipDependents(task);
+      }
+      run.condition.notify_all();
+    }
+  };
+
+  {
+    std::vector<std::jthread> threads;
+    const auto thread_count{
+        std::min(std::max<std::size_t>(options_.max_concurrency, 1),
+                 run.tasks.size())};
+    for (std::size_t index{0}; index < thread_count; ++index) {
+      threads.emplace_back(worker);
+    }
+  } // (Joins)
+
+  for (const auto &task : run.tasks) {
+    if (!task.resolved) {
+      run.result.skipped.push_back(task.service_id); // (Stopped)
+    }
+  }
+  return std::move(run.result);
+}
@@ -0,0 +1,97 @@
+#ifndef AMITG_FC_REMEDIATION_SCHEDULER
+#define AMITG_FC_REMEDIATION_SCHEDULER
+
+/*
+   RemediationScheduler.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ServiceDependencyGraph.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stop_token>
+#include <vector>
+
+// RemediationOptions
+struct RemediationOptions {
+  std::size_t max_concurrency{4}; // (Restarts in flight at once)
+  std::uint32_t max_attempts{5};  // (Per service, including the first)
+  // Retry n waits initial_backoff * 2^(n-1), at most max_backoff.
+  std::chrono::milliseconds initial_backoff{500};
+  std::chrono::milliseconds max_backoff{30000};
+};
+
+// RemediationResult
+struct RemediationResult {
+  std::vector<std::uint32_t> restarted{}; // (In completion order)
+  std::vector<std::uint32_t> failed{};    // (Gave up after max_attempts)
+  std::vector<std::uint32_t> skipped{};   // (A dependency failed, or Run()
+                                          // was stopped first)
+  std::size_t attempts{0};
+};
+
+// RemediationScheduler
+// Restarts a set of failed services in dependency order, independent
+// branches in parallel.
+//
+// A failed service is restarted once every failed service it depends on has
+// been restarted (dependencies outside the failed set are taken as
+// running). Ready services are started lowest topological rank first, by at
+// most max_concurrency threads; a failed attempt is retried after an
+// exponential backoff, and a service that exhausts its attempts causes its
+// dependents (transitively) to be skipped.
+class RemediationScheduler final {
+public:
+  // Restart one service and wait until it runs; returns false (or throws)
+  // on failure. Called on the scheduler's threads, concurrently for
+  // independent services.
+  using RestartFunction = std::function<bool(std::uint32_t service_id)>;
+
+  RemediationScheduler(const RestartFunction &restart_function,
+                       const RemediationOptions &options = {})
+      : restart_function_{restart_function}, options_{options} {}
+  ~RemediationScheduler() = default;
+
+  // Delete copy constructor and copy assignment operator
+  RemediationScheduler(const RemediationScheduler &) = delete;
+  RemediationScheduler &operator=(const RemediationScheduler &) = delete;
+
+  // Delete move constructor and move assignment operator
+  RemediationScheduler(RemediationScheduler &&) = delete;
+  RemediationScheduler &operator=(RemediationScheduler &&) = delete;
+
+  // Restart failed_services (ids of 'graph'); returns when every one of them
+  // is restarted, failed or skipped, or once stop_token is set and the
+  // restarts in flight have returned.
+  [[nodiscard]] RemediationResult
+  Run(const ServiceDependencyGraph &graph,
+      const std::vector<std::uint32_t> &failed_services,
+      std::stop_token stop_token = {}) const;
+
+private:
+  const RestartFunction restart_function_;
+  const RemediationOptions options_;
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+   RestartGovernor.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "RestartGovernor.h"
+
+#include "MonotonicClock.h"
+
+#include <algorithm>
+
+namespace {
+
+// (Min-heap on (due_time, sequence).)
+template <typename DeferredAction>
+bool RunsLater(const DeferredAction &left,
+               const DeferredAction &right) noexcept {
+  return left.due_time != right.due_time ? left.due_time > right.due_time
+                                         : left.sequence > right.sequence;
+}
+
+} // namespace
+
+// Configure
+void TokenBucket::Configure(const TokenBucketOptions &options) noexcept {
+  interval_ = options.refill_per_second > 0
+                  ? static_cast<std::int64_t>(
+                        std::min(1e9 / options.refill_per_second, 1e15))
+                  : 0;
+  tolerance_ = static_cast<std::int64_t>(
+      std::min(static_cast<double>(interval_) *
+                   (std::max<std::uint32_t>(options.burst, 1) - 1),
+               1e18));
+  theoretical_arrival_time_.store(0, std::memory_order_relaxed);
+}
+
+// Reserve
+// The token is due once the bucket is no more than (burst - 1) tokens
+// "behind": theoretical_arrival_time - tolerance; taking it moves the
+// theoretical arrival time one interval on.
+std::int64_t TokenBucket::Reserve(const std::int64_t now) noexcept {
+  if (interval_ == 0) {
+    return now;
+  }
+  auto theoretical_arrival_time{
+      theoretical_arrival_time_.load(std::memory_order_relaxed)};
+  std::int64_t due_time{0};
+  do {
+    due_time = std::max(now, theoretical_arrival_time - tolerance_);
+  } while (!theoretical_arrival_time_.compare_exchange_weak(
+      theoretical_arrival_time,
+      std::max(theoretical_arrival_time, due_time) + interval_,
+      std::memory_order_relaxed));
+  return due_time;
+}
+
+// Start
+void RestartGovernor::Start(const std::size_t service_count,
+                            const RestartGovernorOptions &options) {
+  Stop();
+
+  service_buckets_ = std::make_unique<TokenBucket[]>(service_count);
+  service_count_ = service_count;
+  for (std::size_t service_id{0}; service_id < service_count; ++service_id) {
+    service_buckets_[service_id].Configure(options.per_service);
+  }
+  global_bucket_.Configure(options.global);
+
+  governor_thread_ = std::jthread(
+      [this](const std::stop_token &stop_token) { Run(stop_token); });
+}
+
+// Stop
+void RestartGovernor::Stop() noexcept {
+  if (governor_thread_.joinable()) {
+    governor_thread_.request_stop(); // (Wakes the condition variable)
+    governor_thread_.join();
+  }
+
+  const std::scoped_lock lock(mutex_);
+  cancelled_ += deferred_actions_.size();
+  deferred_actions_.clear();
+}
+
+// Submit
+GovernorDecision RestartGovernor::Submit(
+    const std::uint32_t service_id,
+    const RemediationFunction &remediation_function) {
+  if (!governor_thread_.joinable()) {
+    return GovernorDecision::kRejected;
+  }
+
+  const auto now{MonotonicNanoseconds()};
+  DeferredAction deferred_action{now, now};
+  if (service_id < service_count_) {
+    deferred_action.due_time = service_buckets_[service_id].Reserve(now);
+  }
+  if (deferred_action.due_time <= now) {
+    // (The global token is taken only once the service token is due, so a
+    // storm of one service does not hold back the others.)
+    deferred_action.due_time = global_bucket_.Reserve(now);
+    deferred_action.global_token_reserved = true;
+    if (deferred_action.due_time <= now) {
+      immediate_.fetch_add(1, std::memory_order_relaxed);
+      Execute(remediation_function); // <-- REMEDIATE
+      return GovernorDecision::kImmediate;
+    }
+  }
+
+  deferred_.fetch_add(1, std::memory_order_relaxed);
+  deferred_action.remediation_function = remediation_function;
+  {
+    const std::scoped_lock lock(mutex_);
+    deferred_action.sequence = next_sequence_++;
+    Defer(std::move(deferred_action));
+  }
+  condition_.notify_one();
+  return GovernorDecision::kDeferred;
+}
+
+// GetStatistics
+RestartGovernorStatistics RestartGovernor::GetStatistics() const {
+  RestartGovernorStatistics statistics;
+  statistics.immediate = immediate_.load(std::memory_order_relaxed);
+  statistics.deferred = deferred_.load(std::memory_order_relaxed);
+  {
+    const std::scoped_lock lock(mutex_);
+    statistics.pending = deferred_actions_.size();
+    statistics.cancelled = cancelled_;
+  }
+  deferral_delay_.MergeInto(statistics.deferral_delay);
+  return statistics;
+}
+
+// Run
+// The governor thread: sleep until the earliest deferred action is due, take
+// its global token (re-queue it if that token is not due yet), run it.
+void RestartGovernor::Run(const std::stop_token &stop_token) {
+  std::unique_lock lock(mutex_);
+  while (!stop_token.stop_requested()) {
+    if (deferred_actions_.empty()) {
+      condition_.wait(lock, stop_token,
+                      [this] { return !deferred_actions_.empty(); });
+      continue;
+    }
+    const auto now{MonotonicNanoseconds()};
+    if (const auto due_time{deferred_actions_.front().due_time};
+        due_time > now) {
+      condition_.wait_for(lock, stop_token,
+                          std::chrono::nanoseconds(due_time - now),
+                          [this, due_time] {
+                            return deferred_actions_.front().due_time <
+                                   due_time; // (An earlier one was queued)
+                          });
+      continue;
+    }
+
+    std::ranges::pop_heap(deferred_actions_,
+                          RunsLater<DeferredAction>);
+    DeferredAction deferred_action{std::move(deferred_actions_.back())};
+    deferred_actions_.pop_back();
+
+    if (!deferred_action.global_token_reserved) {
+      deferred_action.global_token_reserved = true;
+      deferred_action.due_time = global_bucket_.Reserve(now);
+      if (deferred_action.due_time > now) {
+        Defer(std::move(deferred_action));
+        continue;
+      }
+    }
+
+    lock.unlock();
+    deferral_delay_.Record(static_cast<std::uint64_t>(
+        MonotonicNanoseconds() - deferred_action.submit_time));
+    Execute(deferred_action.remediation_function); // <-- REMEDIATE
+    lock.lock();
+  }
+}
+
+// Defer
+// (Called with mutex_ held.)
+void RestartGovernor::Defer(DeferredAction &&deferred_action) {
+  deferred_actions_.push_back(std::move(deferred_action));
+  std::ranges::push_heap(deferred_actions_, RunsLater<DeferredAction>);
+}
+
+// Execute
+void RestartGovernor::Execute(
+    const RemediationFunction &remediation_function) noexcept {
+  try {
+    remediation_function();
+  } catch (...) {
+    // (A throwing action must not take down the dispatcher or the governor
+    // thread.)
+  }
+}
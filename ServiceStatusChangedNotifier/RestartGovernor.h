@@ -0,0 +1,180 @@
+#ifndef AMITG_FC_RESTART_GOVERNOR
+#define AMITG_FC_RESTART_GOVERNOR
+
+/*
+   RestartGovernor.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "LatencyHistogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// TokenBucketOptions
+// refill_per_second tokens are added per second, up to 'burst' (a refill
+// rate of 0 or less: unlimited).
+struct TokenBucketOptions {
+  double refill_per_second{1.0};
+  std::uint32_t burst{1};
+};
+
+// RestartGovernorOptions
+struct RestartGovernorOptions {
+  TokenBucketOptions per_service{1.0 / 30, 3}; // (3 at once, then 1 per 30s)
+  TokenBucketOptions global{5.0, 20};          // (Host-wide)
+};
+
+// GovernorDecision
+enum class GovernorDecision : std::uint8_t {
+  kImmediate, // (Ran on the calling thread)
+  kDeferred,  // (Queued: runs on the governor thread once tokens allow)
+  kRejected   // (Not started)
+};
+
+// RestartGovernorStatistics
+struct RestartGovernorStatistics {
+  std::uint64_t immediate{0};
+  std::uint64_t deferred{0};
+  std::uint64_t pending{0};   // (Deferred, not yet run)
+  std::uint64_t cancelled{0}; // (Pending at Stop())
+  LatencyHistogramSnapshot deferral_delay{}; // (Submit() -> run, ns)
+};
+
+// TokenBucket
+// A lock-free token bucket in GCRA form: the whole state is one atomic
+// "theoretical arrival time" (when the bucket would be full again); taking
+// a token is one compare-exchange. Tokens are reserved rather than refused,
+// so every caller learns when its token is due.
+class TokenBucket final {
+public:
+  TokenBucket() = default;
+  ~TokenBucket() = default;
+
+  // Delete copy constructor and copy assignment operator
+  TokenBucket(const TokenBucket &) = delete;
+  TokenBucket &operator=(const TokenBucket &) = delete;
+
+  // Delete move constructor and move assignment operator
+  TokenBucket(TokenBucket &&) = delete;
+  TokenBucket &operator=(TokenBucket &&) = delete;
+
+  // (Full; not concurrent with Reserve().)
+  void Configure(const TokenBucketOptions &options) noexcept;
+
+  // Reserve the next token, no earlier than 'now' (MonotonicNanoseconds());
+  // returns when it is due (<= now: at once).
+  [[nodiscard]] std::int64_t Reserve(std::int64_t now) noexcept;
+
+private:
+  std::atomic<std::int64_t> theoretical_arrival_time_{0};
+  std::int64_t interval_{0};  // (ns per token; 0: unlimited)
+  std::int64_t tolerance_{0}; // ((burst - 1) * interval_)
+};
+
+// RestartGovernor
+// Rate-limits remediation actions (typically restarts issued from an
+// ActionFunction) with a token bucket per service and one global bucket, so
+// a host-wide failure does not turn into a restart storm.
+//
+// Submit() runs the action at once, on the calling thread, if both buckets
+// have a token; the fast path takes no lock. Otherwise the action is
+// deferred (never dropped): it runs on the governor thread once its
+// service's token is due and then a global token is. Deferred actions of
+// one service run in submission order.
+class RestartGovernor final {
+public:
+  using RemediationFunction = std::function<void()>;
+
+  RestartGovernor() = default;
+  ~RestartGovernor() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  RestartGovernor(const RestartGovernor &) = delete;
+  RestartGovernor &operator=(const RestartGovernor &) = delete;
+
+  // Delete move constructor and move assignment operator
+  RestartGovernor(RestartGovernor &&) = delete;
+  RestartGovernor &operator=(RestartGovernor &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start governing services 0 .. service_count - 1 (replaces a previous
+  // Start(); buckets start full).
+  void Start(std::size_t service_count,
+             const RestartGovernorOptions &options = {});
+
+  // Stop: deferred actions not yet run are cancelled (joins the governor
+  // thread).
+  void Stop() noexcept;
+
+  // Run remediation_function for service_id now or later (any thread; not
+  // concurrent with Start() / Stop()). A service id outside the Start()
+  // range is governed by the global bucket only.
+  GovernorDecision Submit(std::uint32_t service_id,
+                          const RemediationFunction &remediation_function);
+
+  [[nodiscard]] RestartGovernorStatistics GetStatistics() const;
+
+private:
+  struct DeferredAction {
+    std::int64_t due_time{0};
+    std::int64_t submit_time{0};
+    std::uint64_t sequence{0};       // (Ties: submission order)
+    bool global_token_reserved{false};
+    RemediationFunction remediation_function{};
+  };
+
+  void Run(const std::stop_token &stop_token);
+
+  void Defer(DeferredAction &&deferred_action);
+
+  static void Execute(const RemediationFunction &remediation_function) noexcept;
+
+  std::unique_ptr<TokenBucket[]> service_buckets_{}; // (Index: service_id)
+  std::size_t service_count_{0};
+  TokenBucket global_bucket_{};
+
+  std::atomic<std::uint64_t> immediate_{0};
+  std::atomic<std::uint64_t> deferred_{0};
+  std::uint64_t cancelled_{0}; // (Guarded by mutex_)
+
+  mutable std::mutex mutex_{};
+  std::condition_variable_any condition_{};
+  std::vector<DeferredAction> deferred_actions_{}; // (Min-heap on due_time;
+                                                   // guarded by mutex_)
+  std::uint64_t next_sequence_{0};                 // (Guarded by mutex_)
+  LatencyHistogram deferral_delay_{}; // (Written by the governor thread)
+
+  std::jthread governor_thread_{}; // (Last: joined first on destruction)
+};
+
+#endif
@@ -0,0 +1,263 @@
+/*
+   RuleEngine.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "RuleEngine.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+// ServiceState
+RuleExpression RuleExpression::ServiceState(const std::uint32_t service_id,
+                                            const std::uint32_t state_mask) {
+  RuleExpression expression;
+  expression.kind_ = Kind::kServiceState;
+  expression.service_id_ = service_id;
+  expression.argument_ = state_mask;
+  return expression;
+}
+
+// AtLeast
+RuleExpression RuleExpression::AtLeast(const std::uint32_t count,
+                                       std::vector<RuleExpression> operands) {
+  RuleExpression expression;
+  expression.kind_ = Kind::kAtLeast;
+  expression.argument_ = count;
+  expression.operands_ = std::move(operands);
+  return expression;
+}
+
+// operator&&
+// AND is AT-LEAST n of n, OR is AT-LEAST 1 of n; chains are flattened into
+// one node (a && b && c -> one AT-LEAST 3 of 3).
+RuleExpression operator&&(RuleExpression left, RuleExpression right) {
+  if (left.kind_ == RuleExpression::Kind::kAtLeast &&
+      left.argument_ == left.operands_.size()) {
+    left.operands_.push_back(std::move(right));
+    left.argument_ = static_cast<std::uint32_t>(left.operands_.size());
+    return left;
+  }
+  std::vector<RuleExpression> operands;
+  operands.reserve(2);
+  operands.push_back(std::move(left));
+  operands.push_back(std::move(right));
+  return RuleExpression::AtLeast(2, std::move(operands));
+}
+
+// operator||
+RuleExpression operator||(RuleExpression left, RuleExpression right) {
+  if (left.kind_ == RuleExpression::Kind::kAtLeast && left.argument_ == 1) {
+    left.operands_.push_back(std::move(right));
+    return left;
+  }
+  std::vector<RuleExpression> operands;
+  operands.reserve(2);
+  operands.push_back(std::move(left));
+  operands.push_back(std::move(right));
+  return RuleExpression::AtLeast(1, std::move(operands));
+}
+
+// operator!
+RuleExpression operator!(RuleExpression operand) {
+  if (operand.kind_ == RuleExpression::Kind::kNot) {
+    return std::move(operand.operands_.front()); // (!!a -> a)
+  }
+  RuleExpression expression;
+  expression.kind_ = RuleExpression::Kind::kNot;
+  expression.operands_.push_back(std::move(operand));
+  return expression;
+}
+
+// AddRule
+std::uint32_t RuleEngine::AddRule(const RuleExpression &expression,
+                                  const RuleAction &rule_action) {
+  const auto code_offset{code_.size()};
+  std::vector<std::uint32_t> service_ids;
+  std::size_t depth{0};
+  try {
+    depth = Compile(expression, service_ids);
+  } catch (...) {
+    code_.erase(code_.begin() + static_cast<std::ptrdiff_t>(code_offset),
+                code_.end()); // (Discard the partial code)
+    throw;
+  }
+
+  std::ranges::sort(service_ids);
+  const auto [first, last]{std::ranges::unique(service_ids)};
+  service_ids.erase(first, last);
+
+  RuleData &rule_data{rules_.emplace_back()};
+  rule_data.stack.resize(depth);
+  rule_data.code_offset = static_cast<std::uint32_t>(code_offset);
+  rule_data.code_length =
+      static_cast<std::uint32_t>(code_.size() - code_offset);
+  rule_data.action = rule_action;
+  rule_services_.push_back(std::move(service_ids));
+  return static_cast<std::uint32_t>(rules_.size() - 1);
+}
+
+// Compile
+// Postfix code: operands first, then the operator. Returns the maximum
+// stack depth while evaluating 'expression'.
+std::size_t RuleEngine::Compile(const RuleExpression &expression,
+                                std::vector<std::uint32_t> &service_ids) {
+  switch (expression.kind_) {
+  case RuleExpression::Kind::kServiceState:
+    if (expression.service_id_ > kMaxOperand) {
+      throw std::invalid_argument("RuleEngine: service id out of range");
+    }
+    service_ids.push_back(expression.service_id_);
+    code_.push_back(
+        {Opcode::kServiceState, expression.service_id_, expression.argument_});
+    return 1;
+
+  case RuleExpression::Kind::kNot: {
+    const auto depth{Compile(expression.operands_.front(), service_ids)};
+    code_.push_back({Opcode::kNot, 0, 0});
+    return depth;
+  }
+
+  case RuleExpression::Kind::kAtLeast: {
+    const auto operand_count{expression.operands_.size()};
+    if (operand_count > kMaxOperand) {
+      throw std::invalid_argument("RuleEngine: too many operands");
+    }
+    // (Operand i is evaluated on top of the i values already pushed.)
+    std::size_t depth{1};
+    for (std::size_t index{0}; index < operand_count; ++index) {
+      depth = std::max(
+          depth, index + Compile(expression.operands_[index], service_ids));
+    }
+    code_.push_back({Opcode::kAtLeast,
+                     static_cast<std::uint32_t>(operand_count),
+                     expression.argument_});
+    return depth;
+  }
+  }
+  return 0;
+}
+
+// Build
+void RuleEngine::Build() {
+  service_count_ = 0;
+  for (const auto &service_ids : rule_services_) {
+    if (!service_ids.empty()) {
+      service_count_ =
+          std::max<std::size_t>(service_count_, service_ids.back() + 1);
+    }
+  }
+
+  // (Counting sort of the (service, rule) pairs: CSR offsets, then ids.)
+  rule_offsets_.assign(service_count_ + 1, 0);
+  for (const auto &service_ids : rule_services_) {
+    for (const auto service_id : service_ids) {
+      ++rule_offsets_[service_id + 1];
+    }
+  }
+  for (std::size_t service_id{0}; service_id < service_count_; ++service_id) {
+    rule_offsets_[service_id + 1] += rule_offsets_[service_id];
+  }
+  rule_ids_.resize(rule_offsets_.back());
+  std::vector<std::uint32_t> positions(rule_offsets_.begin(),
+                                       rule_offsets_.end() - 1);
+  for (std::uint32_t rule_id{0}; rule_id < rule_services_.size(); ++rule_id) {
+    for (const auto service_id : rule_services_[rule_id]) {
+      rule_ids_[positions[service_id]++] = rule_id;
+    }
+  }
+
+  states_ = std::make_unique<std::atomic<std::uint32_t>[]>(service_count_);
+  for (std::uint32_t rule_id{0}; rule_id < rules_.size(); ++rule_id) {
+    Evaluate(rules_[rule_id], rule_id, false);
+  }
+}
+
+// Update
+void RuleEngine::Update(const std::uint32_t service_id,
+                        const std::uint32_t current_state,
+                        const bool notify) noexcept {
+  if (service_id >= service_count_) {
+    return; // (No rule references it)
+  }
+  states_[service_id].store(current_state, std::memory_order_release);
+
+  // (Evaluated after the store: of two racing updates, the later evaluation
+  // sees both states.)
+  for (auto index{rule_offsets_[service_id]};
+       index < rule_offsets_[service_id + 1]; ++index) {
+    const auto rule_id{rule_ids_[index]};
+    Evaluate(rules_[rule_id], rule_id, notify);
+  }
+}
+
+// Result
+bool RuleEngine::Result(const std::uint32_t rule_id) const {
+  return rules_.at(rule_id).result.load(std::memory_order_acquire);
+}
+
+// Evaluate
+void RuleEngine::Evaluate(RuleData &rule_data, const std::uint32_t rule_id,
+                          const bool notify) noexcept {
+  const std::lock_guard lock(rule_data.mutex);
+
+  std::uint8_t *const stack{rule_data.stack.data()};
+  std::size_t top{0};
+  const Instruction *instruction{code_.data() + rule_data.code_offset};
+  const Instruction *const end{instruction + rule_data.code_length};
+  for (; instruction != end; ++instruction) {
+    switch (instruction->opcode) {
+    case Opcode::kServiceState:
+      stack[top++] =
+          (states_[instruction->operand].load(std::memory_order_acquire) &
+           instruction->argument) != 0;
+      break;
+    case Opcode::kNot:
+      stack[top - 1] ^= 1;
+      break;
+    case Opcode::kAtLeast: {
+      top -= instruction->operand;
+      std::uint32_t true_count{0};
+      for (std::size_t index{top}; index < top + instruction->operand;
+           ++index) {
+        true_count += stack[index];
+      }
+      stack[top++] = true_count >= instruction->argument;
+      break;
+    }
+    }
+  }
+
+  const bool result{stack[0] != 0};
+  if (result == rule_data.result.load(std::memory_order_relaxed)) {
+    return;
+  }
+  rule_data.result.store(result, std::memory_order_release);
+
+  if (notify && rule_data.action) {
+    try {
+      rule_data.action(rule_id, result); // <-- NOTIFY
+    } catch (...) {
+      // (The updating thread must survive a throwing action.)
+    }
+  }
+}
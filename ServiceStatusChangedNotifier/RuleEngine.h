@@ -0,0 +1,172 @@
+#ifndef AMITG_FC_RULE_ENGINE
+#define AMITG_FC_RULE_ENGINE
+
+/*
+   RuleEngine.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ServiceCounters.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// RuleExpression
+// A boolean condition over the states of several services, e.g.
+//	ServiceState(dns, SERVICE_NOTIFY_STOPPED) &&
+//	    ServiceState(dhcp, SERVICE_NOTIFY_STOPPED)
+//	AtLeast(2, {ServiceState(frontend1, SERVICE_NOTIFY_RUNNING),
+//	            ServiceState(frontend2, SERVICE_NOTIFY_RUNNING),
+//	            ServiceState(frontend3, SERVICE_NOTIFY_RUNNING)})
+// Services are identified by caller-chosen ids (dense, from 0).
+class RuleExpression final {
+public:
+  // True while service_id's current state is one of the SERVICE_NOTIFY_xxx
+  // bits of state_mask.
+  [[nodiscard]] static RuleExpression ServiceState(std::uint32_t service_id,
+                                                   std::uint32_t state_mask);
+
+  // True while at least 'count' of the operands are true.
+  [[nodiscard]] static RuleExpression
+  AtLeast(std::uint32_t count, std::vector<RuleExpression> operands);
+
+  friend RuleExpression operator&&(RuleExpression left, RuleExpression right);
+  friend RuleExpression operator||(RuleExpression left, RuleExpression right);
+  friend RuleExpression operator!(RuleExpression operand);
+
+private:
+  friend class RuleEngine;
+
+  enum class Kind : std::uint8_t { kServiceState, kNot, kAtLeast };
+
+  Kind kind_{Kind::kServiceState};
+  std::uint32_t service_id_{0};
+  std::uint32_t argument_{0}; // (kServiceState: state mask, kAtLeast: count)
+  std::vector<RuleExpression> operands_{};
+};
+
+// RuleEngine
+// Evaluates compound rules on every state change, without rebuilding global
+// state under a global mutex.
+//
+// Each rule is compiled into a compact postfix bytecode (8 bytes per
+// instruction; AND and OR are AT-LEAST with count n and 1). A service -> rules
+// index (CSR: one offset array, one rule array) maps a state change to just
+// the rules that reference the service. Each rule has its own lock and keeps
+// its last result; its action is called only when the result flips, under
+// the rule's lock, so the flips of one rule are reported in order.
+class RuleEngine final {
+public:
+  using RuleAction = std::function<void(std::uint32_t rule_id, bool result)>;
+
+  RuleEngine() = default;
+  ~RuleEngine() = default;
+
+  // Delete copy constructor and copy assignment operator
+  RuleEngine(const RuleEngine &) = delete;
+  RuleEngine &operator=(const RuleEngine &) = delete;
+
+  // Delete move constructor and move assignment operator
+  RuleEngine(RuleEngine &&) = delete;
+  RuleEngine &operator=(RuleEngine &&) = delete;
+
+  // Compile a rule; returns its id (0, 1, ...). Add all rules before Build().
+  // Throws std::invalid_argument for a service id above 2^24 - 1 or an
+  // AT-LEAST with more than 2^24 - 1 operands.
+  std::uint32_t AddRule(const RuleExpression &expression,
+                        const RuleAction &rule_action);
+
+  // Build the service -> rules index and evaluate every rule once with all
+  // services in no state (no action is called).
+  void Build();
+
+  // Set a service's current state and re-evaluate the rules that reference
+  // it (any thread, after Build()). With notify false, a flip only updates
+  // the rule's result (e.g. to seed the initial states).
+  void Update(std::uint32_t service_id, std::uint32_t current_state,
+              bool notify = true) noexcept;
+
+  // The last result of a rule.
+  [[nodiscard]] bool Result(std::uint32_t rule_id) const;
+
+  [[nodiscard]] std::size_t RuleCount() const noexcept { return rules_.size(); }
+
+protected:
+  enum class Opcode : std::uint32_t {
+    kServiceState, // push (state[operand] & argument) != 0
+    kNot,          // push !pop
+    kAtLeast       // pop 'operand' values, push (true count >= argument)
+  };
+
+  static constexpr std::uint32_t kMaxOperand{(1U << 24) - 1}; // (24 bits)
+
+  struct Instruction {
+    Instruction(const Opcode opcode_value, const std::uint32_t operand_value,
+                const std::uint32_t argument_value) noexcept
+        : opcode(opcode_value), operand(operand_value & kMaxOperand),
+          argument(argument_value) {
+      assert(operand_value <= kMaxOperand); // (Checked by Compile())
+    }
+
+    Opcode opcode : 8;
+    std::uint32_t operand : 24;
+    std::uint32_t argument;
+  };
+  static_assert(sizeof(Instruction) == 8);
+
+  struct alignas(kCacheLineSize) RuleData {
+    std::mutex mutex{};
+    std::atomic<bool> result{false};   // (Written under mutex)
+    std::vector<std::uint8_t> stack{}; // (Guarded by mutex; max depth)
+    std::uint32_t code_offset{0};
+    std::uint32_t code_length{0};
+    RuleAction action{};
+  };
+
+  // Append the postfix code of 'expression'; returns its stack depth.
+  std::size_t Compile(const RuleExpression &expression,
+                      std::vector<std::uint32_t> &service_ids);
+
+  // Evaluate under the rule's lock; call the action on a flip.
+  void Evaluate(RuleData &rule_data, std::uint32_t rule_id,
+                bool notify) noexcept;
+
+  std::vector<Instruction> code_{}; // (All rules, concatenated)
+  std::deque<RuleData> rules_{};    // (Index: rule id; stable addresses)
+  std::vector<std::vector<std::uint32_t>> rule_services_{}; // (Until Build())
+
+  // Service -> rules index: the rules of service s are
+  // rule_ids_[rule_offsets_[s], rule_offsets_[s + 1]).
+  std::vector<std::uint32_t> rule_offsets_{};
+  std::vector<std::uint32_t> rule_ids_{};
+
+  std::unique_ptr<std::atomic<std::uint32_t>[]> states_{}; // (Index: service)
+  std::size_t service_count_{0};
+};
+
+#endif
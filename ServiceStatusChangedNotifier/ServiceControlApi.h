@@ -0,0 +1,62 @@
+#ifndef AMITG_FC_SERVICE_CONTROL_API
+#define AMITG_FC_SERVICE_CONTROL_API
+
+/*
+   ServiceControlApi.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include <Windows.h> // Windows headers first
+
+// ServiceControlApi
+// The Service Control Manager entry points used by
+// ServiceStatusChangedNotifier, with their Win32 signatures. The default
+// (ServiceStatusChangedNotifier::SystemServiceControlApi()) calls the real SCM
+// and SecHost.dll; a benchmark or a simulation substitutes a synthetic event
+// source by passing its own table to the notifier's constructor.
+struct ServiceControlApi {
+  using OpenSCManagerFunction = SC_HANDLE(WINAPI *)(_In_opt_ LPCWSTR,
+                                                    _In_opt_ LPCWSTR,
+                                                    _In_ DWORD);
+  using OpenServiceFunction = SC_HANDLE(WINAPI *)(_In_ SC_HANDLE, _In_ LPCWSTR,
+                                                  _In_ DWORD);
+  using CloseServiceHandleFunction = BOOL(WINAPI *)(_In_ SC_HANDLE);
+  using SubscribeServiceChangeNotificationsFunction = DWORD(WINAPI *)(
+      _In_ SC_HANDLE, _In_ SC_EVENT_TYPE, _In_ PSC_NOTIFICATION_CALLBACK,
+      _In_opt_ PVOID, _Out_ PSC_NOTIFICATION_REGISTRATION *);
+  using UnsubscribeServiceChangeNotificationsFunction =
+      VOID(WINAPI *)(_In_ PSC_NOTIFICATION_REGISTRATION);
+  using QueryServiceConfigFunction = BOOL(WINAPI *)(
+      _In_ SC_HANDLE, _Out_writes_bytes_opt_(cbBufSize) LPQUERY_SERVICE_CONFIGW,
+      _In_ DWORD cbBufSize, _Out_ LPDWORD);
+
+  OpenSCManagerFunction open_sc_manager{nullptr};
+  OpenServiceFunction open_service{nullptr};
+  CloseServiceHandleFunction close_service_handle{nullptr};
+  SubscribeServiceChangeNotificationsFunction
+      subscribe_service_change_notifications{nullptr};
+  UnsubscribeServiceChangeNotificationsFunction
+      unsubscribe_service_change_notifications{nullptr};
+  QueryServiceConfigFunction query_service_config{
+      nullptr}; // (Dependency tracking only)
+};
+
+#endif
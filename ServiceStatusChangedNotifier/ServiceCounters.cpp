@@ -0,0 +1,75 @@
+/*
+   ServiceCounters.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(_WIN32)
+#include <Windows.h> // Windows headers first
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "ServiceCounters.h"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <thread>
+
+// CurrentCpuIndex
+std::size_t CurrentCpuIndex() noexcept {
+#if defined(_WIN32)
+  return GetCurrentProcessorNumber();
+#elif defined(__linux__)
+  const int cpu{sched_getcpu()};
+  return cpu < 0 ? 0 : static_cast<std::size_t>(cpu);
+#else
+  // (No cheap CPU query: spread by thread instead.)
+  return std::hash<std::thread::id>{}(std::this_thread::get_id());
+#endif
+}
+
+namespace {
+
+// ShardCount
+// One shard per logical processor (rounded up to a power of two, capped).
+std::size_t ShardCount() noexcept {
+  constexpr std::size_t kMaxShards{256};
+  const std::size_t processors{
+      std::max(1U, std::thread::hardware_concurrency())};
+  return std::min(std::bit_ceil(processors), kMaxShards);
+}
+
+} // namespace
+
+// ShardedCounter
+ShardedCounter::ShardedCounter()
+    : shard_mask_{ShardCount() - 1},
+      shards_{std::make_unique<Shard[]>(shard_mask_ + 1)} {}
+
+// Load
+std::uint64_t ShardedCounter::Load() const noexcept {
+  std::uint64_t total{0};
+  for (std::size_t index{0}; index <= shard_mask_; ++index) {
+    total += shards_[index].value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
@@ -0,0 +1,108 @@
+#ifndef AMITG_FC_SERVICE_COUNTERS
+#define AMITG_FC_SERVICE_COUNTERS
+
+/*
+   ServiceCounters.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// (Fixed rather than std::hardware_destructive_interference_size, which
+// varies with compiler flags - an ABI hazard - and warns under GCC.)
+inline constexpr std::size_t kCacheLineSize{64};
+
+// CurrentCpuIndex
+// The processor the calling thread is running on (a hint: the thread may
+// migrate right after the call).
+[[nodiscard]] std::size_t CurrentCpuIndex() noexcept;
+
+// ServiceCounterSnapshot
+struct ServiceCounterSnapshot {
+  std::uint64_t events{0};   // Notifications delivered to the action
+  std::uint64_t filtered{0}; // Notifications rejected by the notify mask
+  std::uint64_t drops{0};    // Notifications discarded before the action ran
+  std::uint64_t errors{0};   // Failed subscriptions and throwing actions
+  std::uint64_t coalesced{0}; // Notifications merged into a queued one
+  std::uint64_t suppressed{0}; // Cascaded stops not delivered (dependencies)
+  std::uint64_t deduplicated{0}; // Duplicates of an action in flight
+  std::uint64_t overruns{0}; // Actions still running at their deadline
+};
+
+// ServiceCounters
+// Per-service counters, padded to their own cache line so that threads
+// updating different services never write to a shared line.
+struct alignas(kCacheLineSize) ServiceCounters {
+  std::atomic<std::uint64_t> events{0};
+  std::atomic<std::uint64_t> filtered{0};
+  std::atomic<std::uint64_t> drops{0};
+  std::atomic<std::uint64_t> errors{0};
+  std::atomic<std::uint64_t> coalesced{0};
+  std::atomic<std::uint64_t> suppressed{0};
+  std::atomic<std::uint64_t> deduplicated{0};
+  std::atomic<std::uint64_t> overruns{0};
+
+  [[nodiscard]] ServiceCounterSnapshot Snapshot() const noexcept {
+    return {events.load(std::memory_order_relaxed),
+            filtered.load(std::memory_order_relaxed),
+            drops.load(std::memory_order_relaxed),
+            errors.load(std::memory_order_relaxed),
+            coalesced.load(std::memory_order_relaxed),
+            suppressed.load(std::memory_order_relaxed),
+            deduplicated.load(std::memory_order_relaxed),
+            overruns.load(std::memory_order_relaxed)};
+  }
+};
+
+// ShardedCounter
+// A counter split into per-CPU, cache-line-sized shards. Add() touches only
+// the shard of the current CPU (uncontended in the common case); Load() sums
+// all shards.
+class ShardedCounter final {
+public:
+  ShardedCounter();
+  ~ShardedCounter() = default;
+
+  ShardedCounter(const ShardedCounter &) = delete;
+  ShardedCounter &operator=(const ShardedCounter &) = delete;
+  ShardedCounter(ShardedCounter &&) = delete;
+  ShardedCounter &operator=(ShardedCounter &&) = delete;
+
+  void Add(const std::uint64_t value = 1) noexcept {
+    shards_[CurrentCpuIndex() & shard_mask_].value.fetch_add(
+        value, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] std::uint64_t Load() const noexcept;
+
+private:
+  struct alignas(kCacheLineSize) Shard {
+    std::atomic<std::uint64_t> value{0};
+  };
+
+  const std::size_t shard_mask_; // (Shard count is a power of two)
+  const std::unique_ptr<Shard[]> shards_;
+};
+
+#endif
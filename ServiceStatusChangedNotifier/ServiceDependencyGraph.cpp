@@ -0,0 +1,220 @@
+/*
+   ServiceDependencyGraph.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ServiceDependencyGraph.h"
+
+#include "ServiceNotify.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr std::uint32_t kStoppingStates{SERVICE_NOTIFY_STOP_PENDING |
+                                        SERVICE_NOTIFY_STOPPED};
+
+// BuildCsr
+// Rows: 'from' ids; row entries: the matching 'to' ids.
+template <typename From, typename To>
+void BuildCsr(const std::size_t service_count,
+              const std::vector<ServiceDependency> &edges, From from, To to,
+              std::vector<std::uint32_t> &offsets,
+              std::vector<std::uint32_t> &ids) {
+  offsets.assign(service_count + 1, 0);
+  for (const auto &edge : edges) {
+    ++offsets[from(edge) + 1];
+  }
+  for (std::size_t row{0}; row < service_count; ++row) {
+    offsets[row + 1] += offsets[row];
+  }
+  ids.resize(offsets.back());
+  std::vector<std::uint32_t> positions(offsets.begin(), offsets.end() - 1);
+  for (const auto &edge : edges) {
+    ids[positions[from(edge)]++] = to(edge);
+  }
+}
+
+} // namespace
+
+// Build
+void ServiceDependencyGraph::Build(
+    const std::size_t service_count,
+    const std::vector<ServiceDependency> &dependencies) {
+  std::vector<ServiceDependency> edges;
+  edges.reserve(dependencies.size());
+  for (const auto &edge : dependencies) {
+    if (edge.dependent < service_count && edge.dependency < service_count &&
+        edge.dependent != edge.dependency) {
+      edges.push_back(edge);
+    }
+  }
+  std::ranges::sort(edges, [](const ServiceDependency &left,
+                              const ServiceDependency &right) {
+    return left.dependent != right.dependent
+               ? left.dependent < right.dependent
+               : left.dependency < right.dependency;
+  });
+  const auto [first, last]{std::ranges::unique(
+      edges, [](const ServiceDependency &left, const ServiceDependency &right) {
+        return left.dependent == right.dependent &&
+               left.dependency == right.dependency;
+      })};
+  edges.erase(first, last);
+
+  service_count_ = service_count;
+  BuildCsr(
+      service_count, edges,
+      [](const ServiceDependency &edge) { return edge.dependent; },
+      [](const ServiceDependency &edge) { return edge.dependency; },
+      dependency_offsets_, dependency_ids_);
+  BuildCsr(
+      service_count, edges,
+      [](const ServiceDependency &edge) { return edge.dependency; },
+      [](const ServiceDependency &edge) { return edge.dependent; },
+      dependent_offsets_, dependent_ids_);
+
+  // Topological order (Kahn): a service is ready once all its dependencies
+  // are placed.
+  std::vector<std::uint32_t> pending(service_count);
+  order_.clear();
+  order_.reserve(service_count);
+  for (std::uint32_t service_id{0}; service_id < service_count; ++service_id) {
+    pending[service_id] = dependency_offsets_[service_id + 1] -
+                          dependency_offsets_[service_id];
+    if (pending[service_id] == 0) {
+      order_.push_back(service_id);
+    }
+  }
+  for (std::size_t index{0}; index < order_.size(); ++index) {
+    for (const auto dependent : Dependents(order_[index])) {
+      if (--pending[dependent] == 0) {
+        order_.push_back(dependent);
+      }
+    }
+  }
+  has_cycle_ = order_.size() != service_count;
+  for (std::uint32_t service_id{0}; has_cycle_ && service_id < service_count;
+       ++service_id) {
+    if (pending[service_id] != 0) {
+      order_.push_back(service_id); // (On or behind a cycle)
+    }
+  }
+  rank_.resize(service_count);
+  for (std::uint32_t rank{0}; rank < order_.size(); ++rank) {
+    rank_[order_[rank]] = rank;
+  }
+
+  // (Dependencies by rank: the most basic one wins a tie.)
+  for (std::size_t service_id{0}; service_id < service_count; ++service_id) {
+    std::sort(dependency_ids_.begin() + dependency_offsets_[service_id],
+              dependency_ids_.begin() + dependency_offsets_[service_id + 1],
+              [this](const std::uint32_t left, const std::uint32_t right) {
+                return rank_[left] < rank_[right];
+              });
+  }
+
+  nodes_ = std::make_unique<NodeState[]>(service_count);
+  for (std::uint32_t service_id{0}; service_id < service_count; ++service_id) {
+    nodes_[service_id].root_service_id.store(service_id,
+                                             std::memory_order_relaxed);
+  }
+}
+
+// InheritStops
+void ServiceDependencyGraph::InheritStops(
+    const ServiceDependencyGraph &previous) noexcept {
+  const auto service_count{std::min(service_count_, previous.service_count_)};
+  for (std::size_t service_id{0}; service_id < service_count; ++service_id) {
+    const NodeState &previous_node{previous.nodes_[service_id]};
+    NodeState &node{nodes_[service_id]};
+    const auto stop_time{
+        previous_node.stop_time.load(std::memory_order_acquire)};
+    node.root_service_id.store(
+        previous_node.root_service_id.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+    node.stop_time.store(stop_time, std::memory_order_release);
+  }
+}
+
+// OnTransition
+DependencyVerdict
+ServiceDependencyGraph::OnTransition(const std::uint32_t service_id,
+                                     const std::uint32_t current_state,
+                                     const std::int64_t timestamp) noexcept {
+  if (service_id >= service_count_) {
+    return {service_id, false};
+  }
+  NodeState &node{nodes_[service_id]};
+
+  if (!(current_state & kStoppingStates)) {
+    node.stop_time.store(0, std::memory_order_relaxed);
+    return {service_id, false};
+  }
+  if (node.stop_time.load(std::memory_order_acquire) != 0) {
+    // (STOP_PENDING, then STOPPED: one stop, resolved at its start.)
+    const auto root{node.root_service_id.load(std::memory_order_relaxed)};
+    return {root, root != service_id};
+  }
+
+  auto root{service_id};
+  auto earliest{std::numeric_limits<std::int64_t>::max()};
+  for (const auto dependency : Dependencies(service_id)) {
+    const NodeState &dependency_node{nodes_[dependency]};
+    const auto stop_time{
+        dependency_node.stop_time.load(std::memory_order_acquire)};
+    if (stop_time != 0 && stop_time <= timestamp &&
+        timestamp - stop_time <= window_ && stop_time < earliest) {
+      earliest = stop_time;
+      root = dependency_node.root_service_id.load(std::memory_order_relaxed);
+    }
+  }
+
+  // (The root is published before the stop time that makes it visible.)
+  node.root_service_id.store(root, std::memory_order_relaxed);
+  node.stop_time.store(timestamp, std::memory_order_release);
+  return {root, root != service_id};
+}
+
+// Dependencies
+std::span<const std::uint32_t> ServiceDependencyGraph::Dependencies(
+    const std::uint32_t service_id) const noexcept {
+  if (service_id >= service_count_) {
+    return {};
+  }
+  return std::span(dependency_ids_)
+      .subspan(dependency_offsets_[service_id],
+               dependency_offsets_[service_id + 1] -
+                   dependency_offsets_[service_id]);
+}
+
+// Dependents
+std::span<const std::uint32_t> ServiceDependencyGraph::Dependents(
+    const std::uint32_t service_id) const noexcept {
+  if (service_id >= service_count_) {
+    return {};
+  }
+  return std::span(dependent_ids_)
+      .subspan(dependent_offsets_[service_id],
+               dependent_offsets_[service_id + 1] -
+                   dependent_offsets_[service_id]);
+}
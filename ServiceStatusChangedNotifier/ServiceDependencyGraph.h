@@ -0,0 +1,140 @@
+#ifndef AMITG_FC_SERVICE_DEPENDENCY_GRAPH
+#define AMITG_FC_SERVICE_DEPENDENCY_GRAPH
+
+/*
+   ServiceDependencyGraph.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// ServiceDependency
+// 'dependent' depends on 'dependency' (it cannot run without it).
+struct ServiceDependency {
+  std::uint32_t dependent{0};
+  std::uint32_t dependency{0};
+};
+
+// DependencyTrackingOptions
+struct DependencyTrackingOptions {
+  // A service that stops within this long after one of its dependencies
+  // stopped is tagged with that dependency's root.
+  std::chrono::milliseconds window{5000};
+  // Do not deliver such cascaded stops (they are counted as suppressed).
+  bool suppress_dependents{false};
+};
+
+// DependencyVerdict
+struct DependencyVerdict {
+  std::uint32_t root_service_id{0}; // (The service itself if not cascaded)
+  bool cascaded{false};
+};
+
+// ServiceDependencyGraph
+// The service dependency graph, loaded once, in CSR form (one offset array
+// and one id array per direction), with every service ranked in topological
+// order (dependencies before dependents) and each dependency list sorted by
+// rank.
+//
+// OnTransition() tags cascaded stops with their probable root: when a
+// service starts stopping, it looks only at its own dependencies (O(out-
+// degree)); if one of them stopped within the window, the service inherits
+// the root of the earliest such dependency, so a chain of stops resolves to
+// the service that stopped first. Services are identified by dense ids.
+class ServiceDependencyGraph final {
+public:
+  explicit ServiceDependencyGraph(const DependencyTrackingOptions &options = {})
+      : window_{std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    options.window)
+                    .count()} {}
+  ~ServiceDependencyGraph() = default;
+
+  // Delete copy constructor and copy assignment operator
+  ServiceDependencyGraph(const ServiceDependencyGraph &) = delete;
+  ServiceDependencyGraph &operator=(const ServiceDependencyGraph &) = delete;
+
+  // Delete move constructor and move assignment operator
+  ServiceDependencyGraph(ServiceDependencyGraph &&) = delete;
+  ServiceDependencyGraph &operator=(ServiceDependencyGraph &&) = delete;
+
+  // Build the graph of service ids below service_count (dependencies naming
+  // other ids, or a service itself, are ignored). Not concurrent with
+  // OnTransition().
+  void Build(std::size_t service_count,
+             const std::vector<ServiceDependency> &dependencies);
+
+  // Carry over the stops in progress (and their roots) of the services both
+  // graphs know, e.g. from the graph this one replaces (after Build();
+  // 'previous' may still be in use).
+  void InheritStops(const ServiceDependencyGraph &previous) noexcept;
+
+  // Record a service's new state (any thread, after Build()). A stop
+  // (SERVICE_NOTIFY_STOP_PENDING or SERVICE_NOTIFY_STOPPED) is resolved to
+  // its probable root; any other state ends the service's stop.
+  DependencyVerdict OnTransition(std::uint32_t service_id,
+                                 std::uint32_t current_state,
+                                 std::int64_t timestamp) noexcept;
+
+  [[nodiscard]] std::span<const std::uint32_t>
+  Dependencies(std::uint32_t service_id) const noexcept;
+  [[nodiscard]] std::span<const std::uint32_t>
+  Dependents(std::uint32_t service_id) const noexcept;
+
+  // All services, dependencies first (services on a cycle come last).
+  [[nodiscard]] std::span<const std::uint32_t>
+  TopologicalOrder() const noexcept {
+    return order_;
+  }
+  [[nodiscard]] std::uint32_t Rank(std::uint32_t service_id) const noexcept {
+    return rank_[service_id];
+  }
+  [[nodiscard]] bool HasCycle() const noexcept { return has_cycle_; }
+  [[nodiscard]] std::size_t ServiceCount() const noexcept {
+    return service_count_;
+  }
+
+protected:
+  struct NodeState {
+    std::atomic<std::int64_t> stop_time{0}; // (0: not stopping)
+    std::atomic<std::uint32_t> root_service_id{0};
+  };
+
+  const std::int64_t window_; // (Nanoseconds)
+
+  std::size_t service_count_{0};
+  std::vector<std::uint32_t> dependency_offsets_{}; // (CSR: service ->
+  std::vector<std::uint32_t> dependency_ids_{};     //  its dependencies)
+  std::vector<std::uint32_t> dependent_offsets_{};  // (CSR: service ->
+  std::vector<std::uint32_t> dependent_ids_{};      //  its dependents)
+  std::vector<std::uint32_t> order_{};              // (Topological order)
+  std::vector<std::uint32_t> rank_{};               // (Index: service)
+  bool has_cycle_{false};
+
+  std::unique_ptr<NodeState[]> nodes_{}; // (Index: service)
+};
+
+#endif
@@ -0,0 +1,216 @@
+/*
+   ServiceGroups.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ServiceGroups.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace {
+
+constexpr std::size_t kBitsPerWord{64};
+
+// StateIndex
+std::size_t StateIndex(const std::uint32_t current_state) noexcept {
+  return std::has_single_bit(current_state) &&
+                 current_state <= SERVICE_NOTIFY_DELETE_PENDING
+             ? static_cast<std::size_t>(std::countr_zero(current_state))
+             : kServiceStateCount;
+}
+
+// Clamp
+// A count read while racing transitions of one service are applied may
+// briefly be off by one per race (see ServiceGroups).
+std::uint32_t Clamp(const std::int32_t count,
+                    const std::uint32_t member_count) noexcept {
+  return count <= 0 ? 0
+                    : std::min(static_cast<std::uint32_t>(count), member_count);
+}
+
+} // namespace
+
+// AddGroup
+std::uint32_t ServiceGroups::AddGroup(
+    const std::vector<std::uint32_t> &service_ids,
+    const std::uint32_t healthy_mask, const std::uint32_t quorum) {
+  definitions_.push_back({service_ids, healthy_mask, quorum});
+  return static_cast<std::uint32_t>(definitions_.size() - 1);
+}
+
+// Build
+void ServiceGroups::Build(const std::size_t service_count) {
+  const auto group_count{definitions_.size()};
+  const auto words_per_service{(group_count + kBitsPerWord - 1) /
+                               kBitsPerWord};
+
+  // (The states recorded so far are kept.)
+  const Tables *const previous{tables_.load(std::memory_order_acquire)};
+  auto states{std::make_unique<std::atomic<std::uint32_t>[]>(service_count)};
+  const auto kept{previous ? std::min(service_count, previous->service_count)
+                           : 0};
+  for (std::size_t service_id{0}; service_id < kept; ++service_id) {
+    states[service_id].store(
+        previous->states[service_id].load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+  }
+
+  std::vector<std::uint64_t> membership(service_count * words_per_service, 0);
+  auto groups{std::make_unique<GroupData[]>(group_count)};
+  for (std::size_t group_id{0}; group_id < group_count; ++group_id) {
+    const GroupDefinition &definition{definitions_[group_id]};
+    GroupData &group_data{groups[group_id]};
+    group_data.healthy_mask = definition.healthy_mask;
+
+    const auto word{group_id / kBitsPerWord};
+    const auto bit{std::uint64_t{1} << group_id % kBitsPerWord};
+    for (const auto service_id : definition.service_ids) {
+      if (service_id >= service_count) {
+        continue;
+      }
+      std::uint64_t &bits{membership[service_id * words_per_service + word]};
+      if (bits & bit) {
+        continue; // (Listed twice)
+      }
+      bits |= bit;
+
+      const auto current_state{
+          states[service_id].load(std::memory_order_relaxed)};
+      ++group_data.member_count;
+      group_data.state_counts[StateIndex(current_state)].fetch_add(
+          1, std::memory_order_relaxed);
+      if (current_state & definition.healthy_mask) {
+        group_data.healthy_count.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    group_data.quorum =
+        definition.quorum != 0 ? definition.quorum : group_data.member_count;
+  }
+
+  auto tables{std::make_unique<Tables>()};
+  tables->groups = std::move(groups);
+  tables->group_count = group_count;
+  tables->membership = std::move(membership);
+  tables->words_per_service = words_per_service;
+  tables->states = std::move(states);
+  tables->service_count = service_count;
+
+  built_tables_.reserve(built_tables_.size() + 1); // (No throw after publish)
+  tables_.store(tables.get(), std::memory_order_release);
+  built_tables_.push_back(std::move(tables));
+}
+
+// Update
+void ServiceGroups::Update(const std::uint32_t service_id,
+                           const std::uint32_t current_state) noexcept {
+  const Tables *const tables{tables_.load(std::memory_order_acquire)};
+  if (!tables || service_id >= tables->service_count) {
+    return;
+  }
+  // (The exchange orders racing transitions of one service: each one moves
+  // exactly one count, from the state it replaced.)
+  const auto previous_state{tables->states[service_id].exchange(
+      current_state, std::memory_order_relaxed)};
+  if (previous_state == current_state) {
+    return;
+  }
+  const auto previous_index{StateIndex(previous_state)};
+  const auto current_index{StateIndex(current_state)};
+
+  const std::uint64_t *const words{tables->membership.data() +
+                                   service_id * tables->words_per_service};
+  for (std::size_t word{0}; word < tables->words_per_service; ++word) {
+    for (auto bits{words[word]}; bits != 0; bits &= bits - 1) {
+      GroupData &group_data{
+          tables->groups[word * kBitsPerWord +
+                         static_cast<std::size_t>(std::countr_zero(bits))]};
+      if (previous_index != current_index) { // (Add first: see the class)
+        group_data.state_counts[current_index].fetch_add(
+            1, std::memory_order_relaxed);
+        group_data.state_counts[previous_index].fetch_sub(
+            1, std::memory_order_relaxed);
+      }
+      const bool was_healthy{(previous_state & group_data.healthy_mask) != 0};
+      const bool is_healthy{(current_state & group_data.healthy_mask) != 0};
+      if (was_healthy != is_healthy) {
+        if (is_healthy) {
+          group_data.healthy_count.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          group_data.healthy_count.fetch_sub(1, std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+}
+
+// Count
+std::uint32_t
+ServiceGroups::Count(const std::uint32_t group_id,
+                     const std::uint32_t state_mask) const noexcept {
+  const Tables *const tables{tables_.load(std::memory_order_acquire)};
+  if (!tables || group_id >= tables->group_count) {
+    return 0;
+  }
+  const GroupData &group_data{tables->groups[group_id]};
+  std::int32_t count{0};
+  for (std::size_t index{0}; index < kServiceStateCount; ++index) {
+    if (state_mask & (1U << index)) {
+      count += group_data.state_counts[index].load(std::memory_order_relaxed);
+    }
+  }
+  return Clamp(count, group_data.member_count);
+}
+
+// IsHealthy
+bool ServiceGroups::IsHealthy(const std::uint32_t group_id) const noexcept {
+  const Tables *const tables{tables_.load(std::memory_order_acquire)};
+  if (!tables || group_id >= tables->group_count) {
+    return false;
+  }
+  const GroupData &group_data{tables->groups[group_id]};
+  return Clamp(group_data.healthy_count.load(std::memory_order_relaxed),
+               group_data.member_count) >= group_data.quorum;
+}
+
+// Status
+ServiceGroupStatus
+ServiceGroups::Status(const std::uint32_t group_id) const noexcept {
+  ServiceGroupStatus status;
+  const Tables *const tables{tables_.load(std::memory_order_acquire)};
+  if (!tables || group_id >= tables->group_count) {
+    return status;
+  }
+  const GroupData &group_data{tables->groups[group_id]};
+  status.member_count = group_data.member_count;
+  status.healthy_count =
+      Clamp(group_data.healthy_count.load(std::memory_order_relaxed),
+            group_data.member_count);
+  status.quorum = group_data.quorum;
+  status.healthy = status.healthy_count >= status.quorum;
+  for (std::size_t index{0}; index <= kServiceStateCount; ++index) {
+    status.state_counts[index] =
+        Clamp(group_data.state_counts[index].load(std::memory_order_relaxed),
+              group_data.member_count);
+  }
+  return status;
+}
@@ -0,0 +1,160 @@
+#ifndef AMITG_FC_SERVICE_GROUPS
+#define AMITG_FC_SERVICE_GROUPS
+
+/*
+   ServiceGroups.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "ServiceCounters.h"
+#include "ServiceNotify.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// The SERVICE_NOTIFY_xxx states counted per group (STOPPED .. DELETE_PENDING:
+// index = bit position); any other state (e.g. none reported yet) is counted
+// as unknown, at index kServiceStateCount.
+inline constexpr std::size_t kServiceStateCount{10};
+
+// ServiceGroupStatus
+struct ServiceGroupStatus {
+  std::uint32_t member_count{0};
+  std::uint32_t healthy_count{0}; // (Members in one of the healthy states)
+  std::uint32_t quorum{0};
+  bool healthy{false}; // (healthy_count >= quorum)
+  std::array<std::uint32_t, kServiceStateCount + 1> state_counts{};
+};
+
+// ServiceGroups
+// Named groups of services with running aggregates: how many members are in
+// each state, and whether a quorum of members is healthy, in O(1) at any
+// time.
+//
+// The aggregates are adjusted on each transition, never recounted: a
+// service's group membership is a bitset (one bit per group), so a
+// transition walks the set bits and moves one count from the old state to
+// the new one in each of the service's groups. Each group's counters share
+// one cache line.
+//
+// The counts are eventually exact: each Update() adds to the new state before
+// it subtracts from the old one, but racing transitions of one service (e.g.
+// A -> B and B -> C on two threads) may still subtract from B before adding
+// to it. The counters are signed so such a transient dip cannot wrap, and
+// the readers clamp them to [0, member_count].
+//
+// Build() publishes a new set of tables through an atomic pointer (as the
+// dependency graph is published), so it may run while Update() is called
+// from live callbacks: the replaced tables are kept until destruction.
+//
+// Services are identified by dense ids (0, 1, ...).
+class ServiceGroups final {
+public:
+  ServiceGroups() = default;
+  ~ServiceGroups() = default;
+
+  // Delete copy constructor and copy assignment operator
+  ServiceGroups(const ServiceGroups &) = delete;
+  ServiceGroups &operator=(const ServiceGroups &) = delete;
+
+  // Delete move constructor and move assignment operator
+  ServiceGroups(ServiceGroups &&) = delete;
+  ServiceGroups &operator=(ServiceGroups &&) = delete;
+
+  // Define a group; returns its id (0, 1, ...). The group is healthy while
+  // at least 'quorum' members (0: all members) are in one of the
+  // healthy_mask states. Takes effect on the next Build().
+  std::uint32_t AddGroup(const std::vector<std::uint32_t> &service_ids,
+                         std::uint32_t healthy_mask = SERVICE_NOTIFY_RUNNING,
+                         std::uint32_t quorum = 0);
+
+  // Build the membership bitsets for service ids below service_count, count
+  // the current states once and publish the result. Concurrent with Update()
+  // (a transition racing the build may be recorded in the replaced tables
+  // only: the service is counted in its earlier state until its next
+  // transition), but not with another Build() or AddGroup().
+  void Build(std::size_t service_count);
+
+  // True if groups were added since the last Build().
+  [[nodiscard]] bool NeedsBuild() const noexcept {
+    return GroupCount() != definitions_.size();
+  }
+
+  // Record a service's current state (any thread; ignored for ids not built).
+  void Update(std::uint32_t service_id, std::uint32_t current_state) noexcept;
+
+  // Members in one of the state_mask states.
+  [[nodiscard]] std::uint32_t Count(std::uint32_t group_id,
+                                    std::uint32_t state_mask) const noexcept;
+
+  [[nodiscard]] bool IsHealthy(std::uint32_t group_id) const noexcept;
+
+  [[nodiscard]] ServiceGroupStatus
+  Status(std::uint32_t group_id) const noexcept;
+
+  [[nodiscard]] std::size_t GroupCount() const noexcept {
+    const Tables *const tables{tables_.load(std::memory_order_acquire)};
+    return tables ? tables->group_count : 0;
+  }
+
+protected:
+  struct GroupDefinition {
+    std::vector<std::uint32_t> service_ids{};
+    std::uint32_t healthy_mask{0};
+    std::uint32_t quorum{0};
+  };
+
+  struct alignas(kCacheLineSize) GroupData {
+    std::array<std::atomic<std::int32_t>, kServiceStateCount + 1>
+        state_counts{}; // (Signed: see the class comment)
+    std::atomic<std::int32_t> healthy_count{0};
+    std::uint32_t member_count{0};
+    std::uint32_t healthy_mask{0};
+    std::uint32_t quorum{0};
+  };
+
+  // One Build()'s result; immutable once published, except the counters.
+  struct Tables {
+    std::unique_ptr<GroupData[]> groups{}; // (Index: group id)
+    std::size_t group_count{0};
+
+    // Membership: the groups of service s are the set bits of
+    // membership[s * words_per_service, (s + 1) * words_per_service).
+    std::vector<std::uint64_t> membership{};
+    std::size_t words_per_service{0};
+
+    std::unique_ptr<std::atomic<std::uint32_t>[]> states{}; // (Index: service)
+    std::size_t service_count{0};
+  };
+
+  std::vector<GroupDefinition> definitions_{};
+
+  std::vector<std::unique_ptr<Tables>>
+      built_tables_{}; // (Current: last; earlier ones live until destruction:
+                       // a callback may still hold them.)
+  std::atomic<const Tables *> tables_{nullptr}; // (nullptr: not built)
+};
+
+#endif
@@ -23,32 +23,247 @@
 
 #include "ServiceStatusChangedNotifier.h"
 
+#include "MonotonicClock.h"
+#include "Tracepoints.h"
+
+#include <algorithm>
 #include <bit>
+#include <cwchar>
+#include <iomanip>
 #include <memory>
+#include <ostream>
 #include <ranges>
+#include <string_view>
 
 // NotifyCallbackFunc
 // The callback has no access to instance-specific data directly because
 // it is not associated with any instance of the class and does not have access
-// to 'this' pointer.
+// to 'this' pointer. Instead, notify_buffer->pContext points to the
+// service's ServiceData, which holds the (shared) Context.
 // ** Important: The callback function must not block execution. **
 VOID CALLBACK ServiceStatusChangedNotifier::NotifyCallbackFunc(
     _In_ DWORD dwNotify, _In_ PVOID pCallbackContext) {
-  if (const auto notify_buffer{
-          static_cast<PSERVICE_NOTIFY>(pCallbackContext)}) {
-    if (const auto context{static_cast<Context *>(notify_buffer->pContext)}) {
-      if (context->action_function &&
-              (dwNotify | context->notify_mask) == context->notify_mask ||
-          dwNotify == 0) {
-        // Note: If the value of dwNotify is zero (0), it means that no specific
-        // change flags were provided. In this case, the callback cannot rely on
-        // dwNotify to determine what changed. Instead, the application is
-        // responsible for verifying the current state of the service to
-        // identify what has changed.
-        context->action_function(notify_buffer->pszServiceNames,
-                                 dwNotify); // <-- NOTIFY
+  const auto entry_time{MonotonicNanoseconds()};
+
+  const auto notify_buffer{static_cast<PSERVICE_NOTIFY>(pCallbackContext)};
+  if (!notify_buffer) {
+    return;
+  }
+  const auto service_data{static_cast<ServiceData *>(notify_buffer->pContext)};
+  if (!service_data || !service_data->context) {
+    return;
+  }
+  const Context &context{*service_data->context};
+  ServiceCounters &counters{service_data->counters};
+  TotalCounters &total_counters{*context.total_counters};
+
+  SSCN_TRACE_CALLBACK_ENTRY(service_data->service_id, dwNotify, entry_time);
+
+  DependencyVerdict verdict{service_data->service_id, false};
+  if (dwNotify != 0) { // (Zero: no specific change reported)
+    context.service_groups->Update(service_data->service_id, dwNotify);
+
+    if (DependencyState *const dependencies{
+            context.dependencies.load(std::memory_order_acquire)}) {
+      verdict = dependencies->graph.OnTransition(service_data->service_id,
+                                                 dwNotify, entry_time);
+      if (verdict.cascaded && dependencies->suppress_dependents) {
+        if (TimelineRecorder *const timeline_recorder{
+                context.timeline_recorder.load(std::memory_order_relaxed)}) {
+          timeline_recorder->Record(TimelinePhase::kArrival,
+                                    service_data->service_id, dwNotify,
+                                    context.dispatcher->NextSequence(),
+                                    entry_time);
+        }
+        counters.suppressed.fetch_add(1, std::memory_order_relaxed);
+        total_counters.suppressed.Add();
+        if (context.action_preparer) {
+          UpdatePreparation(*service_data, *context.action_preparer, dwNotify,
+                            false);
+        }
+        return;
+      }
+    }
+  }
+
+  const bool dispatch{context.action_function &&
+                          (dwNotify | context.notify_mask) ==
+                              context.notify_mask ||
+                      dwNotify == 0};
+
+  std::shared_ptr<Preparation> preparation{};
+  if (dwNotify != 0 && context.action_preparer) {
+    preparation = UpdatePreparation(*service_data, *context.action_preparer,
+                                    dwNotify, dispatch);
+  }
+
+  if (dispatch) {
+    // Note: If the value of dwNotify is zero (0), it means that no specific
+    // change flags were provided. In this case, the callback cannot rely on
+    // dwNotify to determine what changed. Instead, the application is
+    // responsible for verifying the current state of the service to
+    // identify what has changed.
+    const auto result{context.dispatcher->Dispatch(
+        service_data->strand, dwNotify, entry_time, verdict.root_service_id,
+        std::move(preparation))}; // (-> Deliver())
+
+    // (Recorded here, on the notifying thread, whichever thread delivers.)
+    if (TimelineRecorder *const timeline_recorder{
+            context.timeline_recorder.load(std::memory_order_relaxed)}) {
+      timeline_recorder->Record(TimelinePhase::kArrival,
+                                service_data->service_id, dwNotify,
+                                result.sequence, entry_time);
+      if (result.enqueue_time != 0) {
+        timeline_recorder->Record(TimelinePhase::kEnqueue,
+                                  service_data->service_id, dwNotify,
+                                  result.sequence, result.enqueue_time);
       }
     }
+
+    switch (result.outcome) {
+    case DispatchOutcome::kDroppedNewest:
+    case DispatchOutcome::kDroppedOldest:
+      counters.drops.fetch_add(1, std::memory_order_relaxed);
+      total_counters.drops.Add();
+      break;
+    case DispatchOutcome::kCoalesced:
+      counters.coalesced.fetch_add(1, std::memory_order_relaxed);
+      total_counters.coalesced.Add();
+      break;
+    case DispatchOutcome::kDeduplicated:
+    case DispatchOutcome::kMerged:
+      counters.deduplicated.fetch_add(1, std::memory_order_relaxed);
+      total_counters.deduplicated.Add();
+      break;
+    default:
+      break;
+    }
+  } else {
+    const auto sequence{context.dispatcher->NextSequence()};
+
+    SSCN_TRACE_FILTER_REJECT(service_data->service_id, dwNotify, entry_time);
+
+    if (TimelineRecorder *const timeline_recorder{
+            context.timeline_recorder.load(std::memory_order_relaxed)}) {
+      timeline_recorder->Record(TimelinePhase::kArrival,
+                                service_data->service_id, dwNotify, sequence,
+                                entry_time);
+    }
+
+    counters.filtered.fetch_add(1, std::memory_order_relaxed);
+    total_counters.filtered.Add();
+  }
+}
+
+// Deliver
+// Runs on the strand's owner thread: the notifying thread (inline) or a
+// dispatcher worker.
+void ServiceStatusChangedNotifier::Deliver(
+    void *const context, const Notification &notification) noexcept {
+  const auto service_data{static_cast<ServiceData *>(context)};
+  const Context &service_context{*service_data->context};
+  ServiceCounters &counters{service_data->counters};
+  TotalCounters &total_counters{*service_context.total_counters};
+  LatencyRecorder &latency_recorder{*service_context.latency_recorder};
+
+  const auto action_start_time{MonotonicNanoseconds()};
+  latency_recorder.Record(
+      static_cast<std::size_t>(LatencyStage::kCallbackToDispatch),
+      notification.enqueue_time - notification.arrival_time);
+  latency_recorder.Record(
+      static_cast<std::size_t>(LatencyStage::kDispatchToActionStart),
+      action_start_time - notification.enqueue_time);
+  service_context.queue_wait_recorder->Record(
+      static_cast<std::size_t>(notification.priority),
+      action_start_time - notification.enqueue_time);
+
+  counters.events.fetch_add(1, std::memory_order_relaxed);
+  total_counters.events.Add();
+
+  TimelineRecorder *const timeline_recorder{
+      service_context.timeline_recorder.load(std::memory_order_relaxed)};
+  if (timeline_recorder) {
+    const auto record = [&](const TimelinePhase phase,
+                            const std::int64_t timestamp) {
+      timeline_recorder->Record(phase, notification.service_id,
+                                notification.state, notification.sequence,
+                                timestamp);
+    };
+    // (Arrival and enqueue are recorded by NotifyCallbackFunc() on the
+    // notifying thread; a trailing re-run is queued by this thread.)
+    if (notification.rerun) {
+      record(TimelinePhase::kEnqueue, notification.enqueue_time);
+    }
+    record(TimelinePhase::kDequeue, action_start_time);
+    record(TimelinePhase::kActionBegin, action_start_time);
+  }
+
+  NotificationDetails notification_details{notification.sequence};
+  notification_details.service_id = notification.service_id;
+  notification_details.deadline = notification.deadline;
+  if (notification.root_service_id != notification.service_id) {
+    // (Service ids are never reused: any later graph names the same root.)
+    if (const DependencyState *const dependencies{
+            service_context.dependencies.load(std::memory_order_acquire)};
+        dependencies &&
+        notification.root_service_id < dependencies->service_names.size()) {
+      notification_details.root_service =
+          &dependencies->service_names[notification.root_service_id];
+    }
+  }
+
+  if (notification.payload && service_context.action_preparer) {
+    notification_details.prepared = service_context.action_preparer->Take(
+        *static_cast<Preparation *>(notification.payload.get()));
+  }
+
+  ActionWatchdog *const action_watchdog{
+      notification.deadline != kNoDeadline ? service_context.action_watchdog
+                                           : nullptr};
+  WatchedAction watched_action{service_data, notification.service_id,
+                               notification.state, notification.sequence,
+                               action_start_time, notification.deadline};
+  if (action_watchdog) {
+    action_watchdog->Arm(watched_action);
+  }
+
+  // An exception must not unwind into the SCM threadpool (or a worker):
+  try {
+    service_context.action_function(service_data->service_name,
+                                    notification.state,
+                                    notification_details); // <-- NOTIFY
+  } catch (...) {
+    counters.errors.fetch_add(1, std::memory_order_relaxed);
+    total_counters.errors.Add();
+  }
+
+  const auto action_end_time{MonotonicNanoseconds()};
+  latency_recorder.Record(
+      static_cast<std::size_t>(LatencyStage::kActionDuration),
+      action_end_time - action_start_time);
+
+  if (action_watchdog) {
+    action_watchdog->Disarm(watched_action, action_end_time);
+  }
+
+  SSCN_TRACE_ACTION_COMPLETE(notification.service_id, notification.state,
+                             action_start_time, action_end_time);
+
+  if (timeline_recorder) {
+    timeline_recorder->Record(TimelinePhase::kActionEnd,
+                              notification.service_id, notification.state,
+                              notification.sequence, action_end_time);
+  }
+}
+
+// ReleasePayload
+// (Under the strand mutex: Cancel() only flags the preparation.)
+void ServiceStatusChangedNotifier::ReleasePayload(
+    void *const context, const std::shared_ptr<void> payload) noexcept {
+  const auto service_data{static_cast<ServiceData *>(context)};
+  if (ActionPreparer *const action_preparer{
+          service_data->context->action_preparer}) {
+    action_preparer->Cancel(*static_cast<Preparation *>(payload.get()));
   }
 }
 
@@ -64,6 +279,7 @@ VOID CALLBACK ServiceStatusChangedNotifier::NotifyCallbackFunc(
 //		SC_EVENT_TYPE enumeration.
 //	- action_function: A callback function that will be called whenever
 //		a service state change occurs.
+//	- dispatch_options: Where action_function runs (see DispatchOptions).
 //
 // Return:
 //	- The function does not return any value.
@@ -74,9 +290,12 @@ namespace {
 // A custom deleter to manage the lifetime of an SC_HANDLE and close it when it
 // goes out of scope.
 struct SCHandleCloser {
+  ServiceControlApi::CloseServiceHandleFunction close_service_handle{
+      nullptr};
+
   void operator()(const SC_HANDLE handle) const noexcept {
-    if (handle) {
-      CloseServiceHandle(handle);
+    if (handle && close_service_handle) {
+      close_service_handle(handle);
     }
   }
 };
@@ -86,45 +305,162 @@ struct SCHandleCloser {
 // Start
 void ServiceStatusChangedNotifier::Start(
     const std::vector<std::wstring> &service_list, const DWORD notify_mask,
-    const ActionFunction &action_function) noexcept {
+    const ActionFunction &action_function,
+    const DispatchOptions &dispatch_options) noexcept {
+  SequencedActionFunction sequenced_action_function{};
+  if (action_function) {
+    try {
+      sequenced_action_function = [action_function](
+                                      const std::wstring &service_name,
+                                      const DWORD current_state,
+                                      std::uint64_t) {
+        action_function(service_name, current_state);
+      };
+    } catch (...) {
+      return; // (Out of memory)
+    }
+  }
+  Start(service_list, notify_mask, sequenced_action_function,
+        dispatch_options);
+}
+
+// Start
+void ServiceStatusChangedNotifier::Start(
+    const std::vector<std::wstring> &service_list, const DWORD notify_mask,
+    const SequencedActionFunction &action_function,
+    const DispatchOptions &dispatch_options) noexcept {
+  DetailedActionFunction detailed_action_function{};
+  if (action_function) {
+    try {
+      detailed_action_function =
+          [action_function](const std::wstring &service_name,
+                            const DWORD current_state,
+                            const NotificationDetails &notification_details) {
+            action_function(service_name, current_state,
+                            notification_details.sequence);
+          };
+    } catch (...) {
+      return; // (Out of memory)
+    }
+  }
+  Start(service_list, notify_mask, detailed_action_function,
+        dispatch_options);
+}
+
+// Start
+void ServiceStatusChangedNotifier::Start(
+    const std::vector<std::wstring> &service_list, const DWORD notify_mask,
+    const DetailedActionFunction &action_function,
+    const DispatchOptions &dispatch_options) noexcept {
   using ScopedSCHandle =
       const std::unique_ptr<std::remove_pointer_t<SC_HANDLE>, SCHandleCloser>;
 
   // Instance-specific data (a context) for the static 'NotifyCallbackFunc':
   context_.notify_mask = notify_mask;
   context_.action_function = action_function;
+  context_.latency_recorder = &latency_recorder_;
+  context_.queue_wait_recorder = &queue_wait_recorder_;
+  context_.total_counters = &total_counters_;
+  context_.service_groups = &service_groups_;
+  context_.action_preparer = nullptr;
+  context_.action_watchdog = nullptr;
+  context_.dispatcher = &dispatcher_;
+
+  if (action_preparer_) {
+    try {
+      action_preparer_->Start();
+      context_.action_preparer = action_preparer_.get();
+    } catch (...) {
+      // (No threads: notifications are delivered without preparation.)
+    }
+  }
+
+  if (action_watchdog_) {
+    try {
+      action_watchdog_->Start();
+      context_.action_watchdog = action_watchdog_.get();
+    } catch (...) {
+      // (No thread: actions are not watched.)
+    }
+  }
+
+  dispatcher_.Start(dispatch_options);
+
+  if (service_groups_.NeedsBuild()) { // (Published: safe under live callbacks)
+    service_groups_.Build(service_index_.size());
+  }
 
   // Open the Service Control Manager (SCM) and manage its lifetime using
   // std::unique_ptr
+  const SCHandleCloser sc_handle_closer{
+      service_control_api_.close_service_handle};
   if (ScopedSCHandle scm{
-          OpenSCManager(nullptr, SERVICES_ACTIVE_DATABASE,
-                        SC_MANAGER_ALL_ACCESS),
-          SCHandleCloser()}) { // If OpenSCManager fails, it returns nullptr.
+          service_control_api_.open_sc_manager(
+              nullptr, SERVICES_ACTIVE_DATABASE, SC_MANAGER_ALL_ACCESS),
+          sc_handle_closer}) { // If OpenSCManager fails, it returns nullptr.
 
     for (const auto &service_name : service_list) { // For each service name
       // Open the service handle and manage its lifetime using std::unique_ptr
       if (ScopedSCHandle service{
-              OpenService(scm.get(), service_name.c_str(), SERVICE_ALL_ACCESS),
-              SCHandleCloser()}) { // If OpenService fails, it returns nullptr.
-        service_name.copy(service_data_map_[service_name].service_name,
-                          service_name.length());
-        const PSERVICE_NOTIFY notify_buffer =
-            &service_data_map_[service_name].notify_buffer;
+              service_control_api_.open_service(
+                  scm.get(), service_name.c_str(), SERVICE_ALL_ACCESS),
+              sc_handle_closer}) { // If OpenService fails, it returns nullptr.
+        ServiceData &service_data{GetServiceData(service_name)};
+        service_data.context = &context_;
+        service_data.strand.context = &service_data;
+        service_data.strand.service_id = service_data.service_id;
+        {
+          const std::lock_guard lock(service_data.strand.mutex);
+          service_data.strand.capacity = dispatch_options.strand_capacity;
+          service_data.strand.overflow_policy =
+              dispatch_options.overflow_policy;
+          service_data.strand.action_deadline =
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  dispatch_options.action_deadline)
+                  .count();
+          dispatcher_.SetDuplicatePolicy(service_data.strand,
+                                         dispatch_options.duplicate_policy);
+        }
+        if (const auto priority{service_priorities_.find(service_name)};
+            priority != service_priorities_.end()) {
+          service_data.strand.priority.store(priority->second,
+                                             std::memory_order_relaxed);
+        }
+
+        if (dependency_tracking_) {
+          LoadServiceDependencies(service.get(), service_data.service_id);
+        }
+
+        service_name.copy(service_data.service_name, service_name.length());
+        const PSERVICE_NOTIFY notify_buffer = &service_data.notify_buffer;
 
         std::memset(notify_buffer, 0, sizeof(SERVICE_NOTIFY)); // (Clear)
-        notify_buffer->pContext = &context_; // Provide callback a context.
-        notify_buffer->pszServiceNames =
-            service_data_map_[service_name].service_name;
+        notify_buffer->pContext =
+            &service_data; // Provide callback a context (via the service).
+        notify_buffer->pszServiceNames = service_data.service_name;
 
         // Subscribe to SC_EVENT_STATUS_CHANGE:
-        service_data_map_[service_name]
-            .system_error_code = SubscribeServiceChangeNotificationsWrapper(
-            service.get(), SC_EVENT_STATUS_CHANGE, NotifyCallbackFunc,
-            notify_buffer,
-            &service_data_map_[service_name].registration); // Set the callback
+        service_data.system_error_code =
+            service_control_api_.subscribe_service_change_notifications(
+                service.get(), SC_EVENT_STATUS_CHANGE, NotifyCallbackFunc,
+                notify_buffer,
+                &service_data.registration); // Set the callback
+
+        SSCN_TRACE_SUBSCRIBE(service_data.service_id, notify_mask,
+                             MonotonicNanoseconds(),
+                             service_data.system_error_code);
+
+        if (service_data.system_error_code != ERROR_SUCCESS) {
+          service_data.counters.errors.fetch_add(1, std::memory_order_relaxed);
+          total_counters_.errors.Add();
+        }
       }
     }
   }
+
+  if (dependency_tracking_) {
+    PublishDependencies();
+  }
 }
 
 // ServiceStatusChangedNotifier
@@ -132,10 +468,499 @@ void ServiceStatusChangedNotifier::Start(
 void ServiceStatusChangedNotifier::Stop() noexcept {
   for (auto &value : service_data_map_ | std::views::values) {
     if (value.registration) {
-      UnsubscribeServiceChangeNotificationsWrapper(value.registration);
+      service_control_api_.unsubscribe_service_change_notifications(
+          value.registration);
       value.registration = nullptr;
+
+      SSCN_TRACE_UNSUBSCRIBE(value.service_id, context_.notify_mask,
+                             MonotonicNanoseconds());
+    }
+  }
+
+  dispatcher_.Stop(); // (Delivers what is still queued)
+
+  if (dependency_states_.size() > 1) { // (No callback holds a replaced graph)
+    dependency_states_.erase(dependency_states_.begin(),
+                             dependency_states_.end() - 1);
+  }
+
+  if (action_preparer_) {
+    for (auto &value : service_data_map_ | std::views::values) {
+      if (const auto preparation{value.preparation.exchange(nullptr)}) {
+        action_preparer_->Cancel(*preparation);
+      }
+    }
+    action_preparer_->Stop();
+  }
+
+  if (action_watchdog_) {
+    action_watchdog_->Stop();
+  }
+}
+
+// SetServicePriority
+void ServiceStatusChangedNotifier::SetServicePriority(
+    const std::wstring &service_name, const NotificationPriority priority) {
+  service_priorities_.insert_or_assign(service_name, priority);
+  if (const auto found{service_data_map_.find(service_name)};
+      found != service_data_map_.end()) {
+    found->second.strand.priority.store(priority, std::memory_order_relaxed);
+  }
+}
+
+// GetLatencyStatistics
+ServiceStatusChangedNotifier::LatencyStatistics
+ServiceStatusChangedNotifier::GetLatencyStatistics() const {
+  return {latency_recorder_.Snapshot(), queue_wait_recorder_.Snapshot()};
+}
+
+// StartLatencyDump
+// (Re)starts the dump thread. The thread waits on a stop_token-aware
+// condition variable, so StopLatencyDump() / destruction never wait out a
+// full interval.
+void ServiceStatusChangedNotifier::StartLatencyDump(
+    const std::chrono::milliseconds interval,
+    const LatencyDumpFunction &dump_function) {
+  StopLatencyDump();
+
+  if (!dump_function || interval <= std::chrono::milliseconds::zero()) {
+    return;
+  }
+
+  latency_dump_thread_ = std::jthread([this, interval, dump_function](
+                                          const std::stop_token &stop_token) {
+    std::unique_lock lock(latency_dump_mutex_);
+    while (!latency_dump_condition_.wait_for(lock, stop_token, interval,
+                                             [] { return false; })) {
+      if (stop_token.stop_requested()) {
+        break;
+      }
+      lock.unlock();
+      dump_function(GetLatencyStatistics()); // <-- DUMP
+      lock.lock();
+    }
+  });
+}
+
+// StopLatencyDump
+void ServiceStatusChangedNotifier::StopLatencyDump() noexcept {
+  if (latency_dump_thread_.joinable()) {
+    latency_dump_thread_.request_stop();
+    latency_dump_thread_.join();
+  }
+}
+
+// LatencyStageName
+const wchar_t *ServiceStatusChangedNotifier::LatencyStageName(
+    const LatencyStage stage) noexcept {
+  switch (stage) {
+  case LatencyStage::kCallbackToDispatch:
+    return L"callback_to_dispatch";
+  case LatencyStage::kDispatchToActionStart:
+    return L"dispatch_to_action_start";
+  case LatencyStage::kActionDuration:
+    return L"action_duration";
+  default:
+    return L"unknown";
+  }
+}
+
+// PriorityName
+const wchar_t *ServiceStatusChangedNotifier::PriorityName(
+    const NotificationPriority priority) noexcept {
+  switch (priority) {
+  case NotificationPriority::kHigh:
+    return L"high";
+  case NotificationPriority::kNormal:
+    return L"normal";
+  case NotificationPriority::kLow:
+    return L"low";
+  default:
+    return L"unknown";
+  }
+}
+
+// WriteLatencyStatistics
+void ServiceStatusChangedNotifier::WriteLatencyStatistics(
+    std::wostream &stream, const LatencyStatistics &latency_statistics) {
+  const auto microseconds = [](const std::uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1000.0;
+  };
+
+  const auto write = [&](const LatencyHistogramSnapshot &snapshot) {
+    stream << L": count=" << snapshot.count
+           << L" p50=" << microseconds(snapshot.ValueAtPercentile(50.0))
+           << L"us p90=" << microseconds(snapshot.ValueAtPercentile(90.0))
+           << L"us p99=" << microseconds(snapshot.ValueAtPercentile(99.0))
+           << L"us p99.9=" << microseconds(snapshot.ValueAtPercentile(99.9))
+           << L"us max=" << microseconds(snapshot.max) << L"us\n";
+  };
+
+  const auto flags{stream.flags()};
+  stream << std::fixed << std::setprecision(3);
+  for (std::size_t stage{0}; stage < latency_statistics.stages.size();
+       ++stage) {
+    stream << LatencyStageName(static_cast<LatencyStage>(stage));
+    write(latency_statistics.stages[stage]);
+  }
+  for (std::size_t priority{0};
+       priority < latency_statistics.queue_wait.size(); ++priority) {
+    stream << L"queue_wait["
+           << PriorityName(static_cast<NotificationPriority>(priority))
+           << L']';
+    write(latency_statistics.queue_wait[priority]);
+  }
+  stream.flags(flags);
+}
+
+// GetServiceCounters
+std::optional<ServiceCounterSnapshot>
+ServiceStatusChangedNotifier::GetServiceCounters(
+    const std::wstring &service_name) const noexcept {
+  if (const auto found{service_data_map_.find(service_name)};
+      found != service_data_map_.end() &&
+      found->second.context) { // (Not only a group member)
+    return found->second.counters.Snapshot();
+  }
+  return std::nullopt;
+}
+
+// AddServiceGroup
+std::uint32_t ServiceStatusChangedNotifier::AddServiceGroup(
+    const std::wstring &group_name,
+    const std::vector<std::wstring> &service_list, const DWORD healthy_mask,
+    const std::uint32_t quorum) {
+  if (const auto found{service_group_ids_.find(group_name)};
+      found != service_group_ids_.end()) {
+    return found->second;
+  }
+
+  std::vector<std::uint32_t> service_ids;
+  service_ids.reserve(service_list.size());
+  for (const auto &service_name : service_list) {
+    service_ids.push_back(GetServiceData(service_name).service_id);
+  }
+  const auto group_id{
+      service_groups_.AddGroup(service_ids, healthy_mask, quorum)};
+  service_group_ids_.emplace(group_name, group_id);
+  return group_id;
+}
+
+// GetServiceGroupId
+std::optional<std::uint32_t> ServiceStatusChangedNotifier::GetServiceGroupId(
+    const std::wstring &group_name) const noexcept {
+  if (const auto found{service_group_ids_.find(group_name)};
+      found != service_group_ids_.end()) {
+    return found->second;
+  }
+  return std::nullopt;
+}
+
+// CountInServiceGroup
+std::uint32_t ServiceStatusChangedNotifier::CountInServiceGroup(
+    const std::uint32_t group_id, const DWORD state_mask) const noexcept {
+  return service_groups_.Count(group_id, state_mask);
+}
+
+// IsServiceGroupHealthy
+bool ServiceStatusChangedNotifier::IsServiceGroupHealthy(
+    const std::uint32_t group_id) const noexcept {
+  return service_groups_.IsHealthy(group_id);
+}
+
+// GetServiceGroupStatus
+ServiceGroupStatus ServiceStatusChangedNotifier::GetServiceGroupStatus(
+    const std::uint32_t group_id) const noexcept {
+  return service_groups_.Status(group_id);
+}
+
+// EnableDependencyTracking
+void ServiceStatusChangedNotifier::EnableDependencyTracking(
+    const DependencyTrackingOptions &options) {
+  dependency_tracking_ = options;
+}
+
+// LoadServiceDependencies
+// lpDependencies is a double-null-terminated list of service names; names
+// prefixed with SC_GROUP_IDENTIFIER are load-order groups (skipped).
+void ServiceStatusChangedNotifier::LoadServiceDependencies(
+    const SC_HANDLE service, const std::uint32_t service_id) noexcept {
+  if (!service_control_api_.query_service_config) {
+    return;
+  }
+  try {
+    DWORD bytes_needed{0};
+    service_control_api_.query_service_config(service, nullptr, 0,
+                                              &bytes_needed);
+    if (bytes_needed == 0) {
+      return;
+    }
+    // (QUERY_SERVICE_CONFIGW is followed by the strings it points to.)
+    std::vector<std::uint64_t> buffer((bytes_needed + 7) / 8);
+    const auto config{reinterpret_cast<LPQUERY_SERVICE_CONFIGW>(buffer.data())};
+    if (!service_control_api_.query_service_config(
+            service, config, static_cast<DWORD>(buffer.size() * 8),
+            &bytes_needed) ||
+        !config->lpDependencies) {
+      return;
+    }
+    std::vector<std::wstring> names;
+    for (const wchar_t *name{config->lpDependencies}; *name != L'\0';
+         name += std::wcslen(name) + 1) {
+      if (*name != SC_GROUP_IDENTIFIERW) {
+        names.emplace_back(name);
+      }
+    }
+    if (dependency_names_.size() <= service_id) {
+      dependency_names_.resize(service_id + 1);
+    }
+    dependency_names_[service_id] = std::move(names);
+  } catch (...) {
+    // (Out of memory: the service is tracked without (all) dependencies.)
+  }
+}
+
+// PublishDependencies
+// A dependency without a subscription gets no transitions (it could never be
+// a root): only edges between subscribed services are kept. An unchanged
+// graph stays published as is (with its stop tracking).
+void ServiceStatusChangedNotifier::PublishDependencies() noexcept {
+  try {
+    std::vector<ServiceDependency> dependencies;
+    for (std::uint32_t service_id{0}; service_id < dependency_names_.size();
+         ++service_id) {
+      if (!service_index_[service_id]->registration) {
+        continue;
+      }
+      for (const auto &name : dependency_names_[service_id]) {
+        if (const auto found{service_data_map_.find(name)};
+            found != service_data_map_.end() && found->second.registration) {
+          dependencies.push_back({service_id, found->second.service_id});
+        }
+      }
+    }
+
+    const DependencyState *const current{
+        dependency_states_.empty() ? nullptr : dependency_states_.back().get()};
+    if (current && current->graph.ServiceCount() == service_index_.size() &&
+        std::ranges::equal(current->dependencies, dependencies,
+                           [](const ServiceDependency &left,
+                              const ServiceDependency &right) {
+                             return left.dependent == right.dependent &&
+                                    left.dependency == right.dependency;
+                           })) {
+      return;
     }
+
+    auto dependency_state{
+        std::make_unique<DependencyState>(*dependency_tracking_)};
+    dependency_state->graph.Build(service_index_.size(), dependencies);
+    if (current) {
+      dependency_state->graph.InheritStops(current->graph);
+    }
+    dependency_state->dependencies = std::move(dependencies);
+    dependency_state->service_names.resize(service_index_.size());
+    for (const auto &[service_name, service_data] : service_data_map_) {
+      dependency_state->service_names[service_data.service_id] = service_name;
+    }
+    dependency_states_.push_back(std::move(dependency_state));
+    context_.dependencies.store(dependency_states_.back().get(),
+                                std::memory_order_release);
+  } catch (...) {
+    // (Out of memory: the previous graph stays.)
+  }
+}
+
+// EnableActionPreparation
+void ServiceStatusChangedNotifier::EnableActionPreparation(
+    const ActionPreparer::PrepareFunction &prepare_function,
+    const PreparationOptions &options) {
+  action_preparer_ =
+      std::make_unique<ActionPreparer>(prepare_function, options);
+}
+
+// GetPreparationStatistics
+PreparationStatistics
+ServiceStatusChangedNotifier::GetPreparationStatistics() const noexcept {
+  return action_preparer_ ? action_preparer_->GetStatistics()
+                          : PreparationStatistics{};
+}
+
+// EnableActionWatchdog
+void ServiceStatusChangedNotifier::EnableActionWatchdog(
+    const OverrunFunction &overrun_function) {
+  action_watchdog_ = std::make_unique<ActionWatchdog>(
+      [overrun_function](const WatchedAction &watched_action) {
+        auto &service_data{*static_cast<ServiceData *>(watched_action.context)};
+        SSCN_TRACE_ACTION_OVERRUN(watched_action.service_id,
+                                  watched_action.state,
+                                  watched_action.start_time,
+                                  watched_action.deadline);
+        service_data.counters.overruns.fetch_add(1, std::memory_order_relaxed);
+        service_data.context->total_counters->overruns.Add();
+        if (overrun_function) {
+          overrun_function(service_data.service_name, watched_action.state,
+                           watched_action); // <-- OVERRUN
+        }
+      });
+}
+
+// GetWatchdogStatistics
+ActionWatchdogStatistics
+ServiceStatusChangedNotifier::GetWatchdogStatistics() const {
+  return action_watchdog_ ? action_watchdog_->GetStatistics()
+                          : ActionWatchdogStatistics{};
+}
+
+// UpdatePreparation
+// (The slot is swapped atomically: a preparation has one owner at a time, the
+// slot or the notification that carries it to Deliver().)
+std::shared_ptr<Preparation> ServiceStatusChangedNotifier::UpdatePreparation(
+    ServiceData &service_data, ActionPreparer &action_preparer,
+    const DWORD current_state, const bool deliver) noexcept {
+  if ((current_state & action_preparer.Options().pending_mask) != 0 &&
+      PreparedState(current_state) != 0) {
+    if (const auto current{service_data.preparation.load()};
+        current && current->PendingState() == current_state) {
+      return nullptr; // (Repeated: keep preparing)
+    }
+    if (const auto previous{service_data.preparation.exchange(
+            action_preparer.Prepare(service_data.service_name,
+                                    current_state))}) {
+      action_preparer.Cancel(*previous);
+    }
+    return nullptr;
+  }
+
+  if (!service_data.preparation.load(std::memory_order_relaxed)) {
+    return nullptr; // (Nothing prepared: the common case)
+  }
+  auto preparation{service_data.preparation.exchange(nullptr)};
+  if (!preparation || (deliver && PreparedState(preparation->PendingState()) ==
+                                      current_state)) {
+    return preparation;
+  }
+  action_preparer.Cancel(*preparation);
+  return nullptr;
+}
+
+// RestartServices
+RemediationResult ServiceStatusChangedNotifier::RestartServices(
+    const std::vector<std::wstring> &service_list,
+    const std::function<bool(const std::wstring &service_name)>
+        &restart_function,
+    const RemediationOptions &options, const std::stop_token stop_token) const {
+  std::vector<std::uint32_t> failed_services;
+  failed_services.reserve(service_list.size());
+  for (const auto &service_name : service_list) {
+    if (const auto found{service_data_map_.find(service_name)};
+        found != service_data_map_.end()) {
+      failed_services.push_back(found->second.service_id);
+    }
+  }
+
+  const RemediationScheduler remediation_scheduler(
+      [this, &restart_function](const std::uint32_t service_id) {
+        return restart_function(service_index_[service_id]->service_name);
+      },
+      options);
+
+  if (const DependencyState *const dependencies{
+          context_.dependencies.load(std::memory_order_acquire)}) {
+    return remediation_scheduler.Run(dependencies->graph, failed_services,
+                                     stop_token);
   }
+  ServiceDependencyGraph graph; // (No dependencies: no order)
+  graph.Build(service_index_.size(), {});
+  return remediation_scheduler.Run(graph, failed_services, stop_token);
+}
+
+// GetServiceName
+const wchar_t *ServiceStatusChangedNotifier::GetServiceName(
+    const std::uint32_t service_id) const noexcept {
+  return service_id < service_index_.size()
+             ? service_index_[service_id]->service_name
+             : nullptr;
+}
+
+// GetServiceData
+ServiceStatusChangedNotifier::ServiceData &
+ServiceStatusChangedNotifier::GetServiceData(const std::wstring &service_name) {
+  auto [entry, inserted] = service_data_map_.try_emplace(service_name);
+  ServiceData &service_data{entry->second};
+  if (inserted) {
+    service_data.service_id = static_cast<std::uint32_t>(service_index_.size());
+    service_index_.push_back(&service_data);
+  }
+  return service_data;
+}
+
+// GetTotalCounters
+ServiceCounterSnapshot
+ServiceStatusChangedNotifier::GetTotalCounters() const noexcept {
+  return {total_counters_.events.Load(), total_counters_.filtered.Load(),
+          total_counters_.drops.Load(), total_counters_.errors.Load(),
+          total_counters_.coalesced.Load(),
+          total_counters_.suppressed.Load(),
+          total_counters_.deduplicated.Load(),
+          total_counters_.overruns.Load()};
+}
+
+// StartTimeline
+void ServiceStatusChangedNotifier::StartTimeline(const std::size_t capacity) {
+  if (!timeline_recorder_) {
+    timeline_recorder_ = std::make_unique<TimelineRecorder>(capacity);
+  }
+  context_.timeline_recorder.store(timeline_recorder_.get(),
+                                   std::memory_order_relaxed);
+}
+
+// StopTimeline
+void ServiceStatusChangedNotifier::StopTimeline() noexcept {
+  context_.timeline_recorder.store(nullptr, std::memory_order_relaxed);
+}
+
+namespace {
+
+// Utf8
+// UTF-16 service name -> UTF-8 (for the JSON timeline).
+std::string Utf8(const std::wstring_view text) {
+  if (text.empty()) {
+    return {};
+  }
+  const auto size{WideCharToMultiByte(CP_UTF8, 0, text.data(),
+                                      static_cast<int>(text.size()), nullptr,
+                                      0, nullptr, nullptr)};
+  std::string utf8(static_cast<std::size_t>(std::max(size, 0)), '\0');
+  if (size > 0) {
+    WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+                        utf8.data(), size, nullptr, nullptr);
+  }
+  return utf8;
+}
+
+} // namespace
+
+// WriteTimeline
+void ServiceStatusChangedNotifier::WriteTimeline(std::ostream &stream) const {
+  if (!timeline_recorder_) {
+    stream << R"({"traceEvents":[]})" << '\n';
+    return;
+  }
+  timeline_recorder_->WriteChromeTrace(
+      stream, [this](const std::uint32_t service_id) {
+        return service_id < service_index_.size()
+                   ? Utf8(service_index_[service_id]->service_name)
+                   : std::to_string(service_id);
+      });
+}
+
+// SystemServiceControlApi
+ServiceControlApi
+ServiceStatusChangedNotifier::SystemServiceControlApi() noexcept {
+  return {OpenSCManager, OpenService, CloseServiceHandle,
+          SubscribeServiceChangeNotificationsWrapper,
+          UnsubscribeServiceChangeNotificationsWrapper, QueryServiceConfig};
 }
 
 namespace {
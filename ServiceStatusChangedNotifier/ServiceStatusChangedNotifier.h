@@ -26,8 +26,28 @@
 
 #include <Windows.h> // Windows headers first
 
+#include "ActionPreparer.h"
+#include "ActionWatchdog.h"
+#include "LatencyHistogram.h"
+#include "NotificationDispatcher.h"
+#include "RemediationScheduler.h"
+#include "ServiceControlApi.h"
+#include "ServiceCounters.h"
+#include "ServiceDependencyGraph.h"
+#include "ServiceGroups.h"
+#include "TimelineRecorder.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -37,7 +57,71 @@ public:
   using ActionFunction = std::function<void(const std::wstring &service_name,
                                             DWORD current_state)>;
 
+  // The same, plus the notification's global sequence number (strictly
+  // increasing per service in delivery order).
+  using SequencedActionFunction =
+      std::function<void(const std::wstring &service_name,
+                         DWORD current_state, std::uint64_t sequence)>;
+
+  // The details of a notification:
+  struct NotificationDetails {
+    std::uint64_t sequence{0}; // (As for SequencedActionFunction)
+    // A cascaded stop: the probable root-cause service (see
+    // EnableDependencyTracking()); nullptr otherwise.
+    const std::wstring *root_service{nullptr};
+    std::uint32_t service_id{0}; // (Dense, stable for the notifier's
+                                 // lifetime: see GetServiceName())
+    // The context prepared on entry to the pending state that led here (see
+    // EnableActionPreparation()); nullptr if none.
+    std::shared_ptr<void> prepared{};
+    // MonotonicNanoseconds(): when the action is due (see
+    // DispatchOptions::action_deadline); kNoDeadline if none.
+    std::int64_t deadline{kNoDeadline};
+  };
+
+  using DetailedActionFunction = std::function<void(
+      const std::wstring &service_name, DWORD current_state,
+      const NotificationDetails &notification_details)>;
+
+  // Notification pipeline stages measured into latency histograms:
+  enum class LatencyStage : std::size_t {
+    kCallbackToDispatch,    // NotifyCallbackFunc() entry -> event dispatched
+    kDispatchToActionStart, // Event dispatched -> ActionFunction called
+    kActionDuration,        // ActionFunction duration
+    kCount
+  };
+
+  struct LatencyStatistics {
+    std::vector<LatencyHistogramSnapshot> stages{}; // (Index: LatencyStage)
+    std::vector<LatencyHistogramSnapshot>
+        queue_wait{}; // Dispatch -> action start (Index: NotificationPriority)
+
+    [[nodiscard]] const LatencyHistogramSnapshot &
+    operator[](const LatencyStage stage) const noexcept {
+      return stages[static_cast<std::size_t>(stage)];
+    }
+    [[nodiscard]] const LatencyHistogramSnapshot &
+    operator[](const NotificationPriority priority) const noexcept {
+      return queue_wait[static_cast<std::size_t>(priority)];
+    }
+  };
+
+  // An action still running at its deadline (see EnableActionWatchdog()):
+  using OverrunFunction = std::function<void(
+      const std::wstring &service_name, DWORD current_state,
+      const WatchedAction &watched_action)>;
+
+  using LatencyDumpFunction =
+      std::function<void(const LatencyStatistics &latency_statistics)>;
+
   ServiceStatusChangedNotifier() = default;
+
+  // Use the given SCM entry points instead of the system ones (e.g. a
+  // synthetic event source for benchmarks).
+  explicit ServiceStatusChangedNotifier(
+      const ServiceControlApi &service_control_api) noexcept
+      : service_control_api_{service_control_api} {}
+
   ~ServiceStatusChangedNotifier() { Stop(); } // (Non-default destructor)
 
   // Since non-default destructor__
@@ -56,17 +140,190 @@ public:
 
   // Subscribe to SC_EVENT_STATUS_CHANGE notifications for the specified
   // services.
+  // The notifications of one service are delivered one at a time, in
+  // sequence order; different services are delivered in parallel.
+  // The worker options of dispatch_options take effect on the first Start()
+  // (after Stop()); its backpressure options (strand_capacity,
+  // overflow_policy) apply to the services of each Start() call.
   void Start(const std::vector<std::wstring> &service_list, DWORD notify_mask,
-             const ActionFunction &action_function) noexcept;
+             const ActionFunction &action_function,
+             const DispatchOptions &dispatch_options = {}) noexcept;
+  void Start(const std::vector<std::wstring> &service_list, DWORD notify_mask,
+             const SequencedActionFunction &action_function,
+             const DispatchOptions &dispatch_options = {}) noexcept;
+  void Start(const std::vector<std::wstring> &service_list, DWORD notify_mask,
+             const DetailedActionFunction &action_function,
+             const DispatchOptions &dispatch_options = {}) noexcept;
 
-  // Unsubscribe from all service notifications.
+  // Unsubscribe from all service notifications, then deliver the
+  // notifications still queued.
   void Stop() noexcept;
 
+  // Assign a dispatch class to a service (default: kNormal). Set it before
+  // Start() subscribes the service; a later call applies from the service's
+  // next notification.
+  void SetServicePriority(const std::wstring &service_name,
+                          NotificationPriority priority);
+
+  // Per-stage latency histograms (merged from all recording threads).
+  [[nodiscard]] LatencyStatistics GetLatencyStatistics() const;
+
+  // Call dump_function with GetLatencyStatistics() every interval (on a
+  // dedicated thread) until StopLatencyDump() or destruction.
+  void StartLatencyDump(std::chrono::milliseconds interval,
+                        const LatencyDumpFunction &dump_function);
+  void StopLatencyDump() noexcept;
+
+  [[nodiscard]] static const wchar_t *
+  LatencyStageName(LatencyStage stage) noexcept;
+  [[nodiscard]] static const wchar_t *
+  PriorityName(NotificationPriority priority) noexcept;
+
+  // Write p50/p90/p99/p99.9/max (microseconds) per stage and per priority
+  // class.
+  static void
+  WriteLatencyStatistics(std::wostream &stream,
+                         const LatencyStatistics &latency_statistics);
+
+  // Event / filtered / drop / error / coalesced / suppressed / deduplicated /
+  // overrun counters of one subscribed service (std::nullopt if the service
+  // was never passed to Start()). Not to be called concurrently with Start().
+  [[nodiscard]] std::optional<ServiceCounterSnapshot>
+  GetServiceCounters(const std::wstring &service_name) const noexcept;
+
+  // The same counters summed over all services.
+  [[nodiscard]] ServiceCounterSnapshot GetTotalCounters() const noexcept;
+
+  // Load the dependencies (QueryServiceConfig()) of the services subscribed
+  // from now on, and tag each stop of a service that follows a stop of one
+  // of its dependencies within options.window with the probable root cause
+  // (NotificationDetails::root_service); optionally suppress such cascaded
+  // stops. Only dependencies that are subscribed themselves count (a stop is
+  // never traced back to a service without notifications). Call before
+  // Start(). A Start() that changes the graph rebuilds it, in topologically
+  // sorted CSR form (stops in progress carry over); a stop costs one look at
+  // each of the service's dependencies.
+  void EnableDependencyTracking(const DependencyTrackingOptions &options = {});
+
+  // Speculatively prepare the action for a service's next state: on entry to
+  // a pending state in options.pending_mask (e.g. STOP_PENDING),
+  // prepare_function runs on a preparer thread; the notification of the
+  // state it leads to (STOPPED) gets its result as
+  // NotificationDetails::prepared (waiting for it if still running). Any
+  // other next state (e.g. back to RUNNING) cancels it. Call before Start().
+  void EnableActionPreparation(
+      const ActionPreparer::PrepareFunction &prepare_function,
+      const PreparationOptions &options = {});
+
+  [[nodiscard]] PreparationStatistics GetPreparationStatistics() const noexcept;
+
+  // Watch the actions that have a deadline (DispatchOptions::action_deadline)
+  // with one shared timer (ActionWatchdog). An action still running at its
+  // deadline is counted (ServiceCounters::overruns), traced
+  // (SSCN_TRACE_ACTION_OVERRUN) and passed to overrun_function, on the
+  // watchdog thread, while it still runs. Call before Start().
+  void EnableActionWatchdog(const OverrunFunction &overrun_function = {});
+
+  [[nodiscard]] ActionWatchdogStatistics GetWatchdogStatistics() const;
+
+  // Restart the given subscribed services in dependency order, independent
+  // branches in parallel (RemediationScheduler over the graph of the last
+  // Start(); without EnableDependencyTracking() no order is imposed).
+  // restart_function is called with the service name; unknown names are
+  // ignored. The result lists service ids (GetServiceName()). Not to be
+  // called concurrently with Start().
+  [[nodiscard]] RemediationResult RestartServices(
+      const std::vector<std::wstring> &service_list,
+      const std::function<bool(const std::wstring &service_name)>
+          &restart_function,
+      const RemediationOptions &options = {},
+      std::stop_token stop_token = {}) const;
+
+  // The name of a service id (nullptr if unknown). Not to be called
+  // concurrently with Start().
+  [[nodiscard]] const wchar_t *
+  GetServiceName(std::uint32_t service_id) const noexcept;
+
+  // Define a named service group, counted from the next Start() (which
+  // republishes the group tables, so subscriptions of an earlier Start() may
+  // still be live); returns its id (a name already defined keeps its first
+  // definition and id). The group's running aggregates follow every
+  // notification of a member, whether or not it passes the notify mask. The
+  // group is healthy while at least 'quorum' members (0: all members) are in
+  // one of the healthy_mask states; until its first notification a member
+  // is in no state.
+  std::uint32_t AddServiceGroup(const std::wstring &group_name,
+                                const std::vector<std::wstring> &service_list,
+                                DWORD healthy_mask = SERVICE_NOTIFY_RUNNING,
+                                std::uint32_t quorum = 0);
+
+  [[nodiscard]] std::optional<std::uint32_t>
+  GetServiceGroupId(const std::wstring &group_name) const noexcept;
+
+  // Group aggregates, O(1) (0 / false / empty for an unknown group id):
+  // members in one of the state_mask states, quorum reached, all counts.
+  [[nodiscard]] std::uint32_t
+  CountInServiceGroup(std::uint32_t group_id, DWORD state_mask) const noexcept;
+  [[nodiscard]] bool
+  IsServiceGroupHealthy(std::uint32_t group_id) const noexcept;
+  [[nodiscard]] ServiceGroupStatus
+  GetServiceGroupStatus(std::uint32_t group_id) const noexcept;
+
+  // Start recording each notification's lifecycle (arrival, queueing, action
+  // begin/end, per thread) into a fixed-size ring that overwrites the oldest
+  // entries. The ring is allocated by the first call (later calls re-enable
+  // it and ignore 'capacity'). While stopped, the hot path pays one relaxed
+  // load.
+  void StartTimeline(std::size_t capacity = kDefaultTimelineCapacity);
+  void StopTimeline() noexcept; // (Keeps the recorded events)
+
+  // Write the recorded events as Chrome Trace Event JSON (chrome://tracing,
+  // ui.perfetto.dev). Writes an empty trace if StartTimeline() was never
+  // called.
+  void WriteTimeline(std::ostream &stream) const;
+
+  static constexpr std::size_t kDefaultTimelineCapacity{1 << 16};
+
+  // The real SCM (advapi32) and SecHost.dll entry points.
+  [[nodiscard]] static ServiceControlApi SystemServiceControlApi() noexcept;
+
 protected:
+  // Notifier-wide totals, sharded per CPU (aggregated on read):
+  struct TotalCounters {
+    ShardedCounter events{};
+    ShardedCounter filtered{};
+    ShardedCounter drops{};
+    ShardedCounter errors{};
+    ShardedCounter coalesced{};
+    ShardedCounter suppressed{};
+    ShardedCounter deduplicated{};
+    ShardedCounter overruns{};
+  };
+
+  // A published dependency graph, with the service names to report roots.
+  struct DependencyState {
+    explicit DependencyState(const DependencyTrackingOptions &options)
+        : graph{options}, suppress_dependents{options.suppress_dependents} {}
+
+    ServiceDependencyGraph graph;
+    std::vector<ServiceDependency> dependencies{}; // (The graph's edges)
+    std::vector<std::wstring> service_names{};     // (Index: service_id)
+    const bool suppress_dependents;
+  };
+
   // Tailored context for NotifyCallbackFunc():
   using Context = struct {
     DWORD notify_mask;
-    ActionFunction action_function;
+    DetailedActionFunction action_function;
+    NotificationDispatcher *dispatcher;
+    LatencyRecorder *latency_recorder;
+    LatencyRecorder *queue_wait_recorder; // (Stage: NotificationPriority)
+    TotalCounters *total_counters;
+    ServiceGroups *service_groups;
+    ActionPreparer *action_preparer; // (nullptr: off)
+    ActionWatchdog *action_watchdog; // (nullptr: off)
+    std::atomic<TimelineRecorder *> timeline_recorder; // (nullptr: off)
+    std::atomic<DependencyState *> dependencies; // (nullptr: off)
   };
 
   // Keeps data (per monitored service) *that has to be persistent* as long as
@@ -81,17 +338,93 @@ protected:
                      // default values.
     PSC_NOTIFICATION_REGISTRATION registration{nullptr};
     DWORD system_error_code{ERROR_SUCCESS};
+    std::uint32_t service_id{0}; // (Index in service_index_)
+    Context *context{nullptr};   // (notify_buffer.pContext points to this
+                                 // ServiceData; the context is shared.)
+    std::atomic<std::shared_ptr<Preparation>>
+        preparation{}; // (Of the current pending state)
+    ServiceCounters counters{};  // (Own cache line)
+    NotificationStrand strand{}; // (strand.context points to this
+                                 // ServiceData)
   };
 
+  const ServiceControlApi service_control_api_{SystemServiceControlApi()};
+
   std::unordered_map<std::wstring, ServiceData>
       service_data_map_{}; // Key: service_name, Value: SERVICE_DATA (see
                            // above).
+  std::vector<ServiceData *> service_index_{}; // Key: service_id (map nodes
+                                               // are address-stable)
+
+  std::unordered_map<std::wstring, NotificationPriority>
+      service_priorities_{}; // Key: service_name (SetServicePriority())
+
+  std::optional<DependencyTrackingOptions> dependency_tracking_{};
+  std::vector<std::vector<std::wstring>>
+      dependency_names_{}; // Index: service_id (as last loaded)
+  std::vector<std::unique_ptr<DependencyState>>
+      dependency_states_{}; // (Current: last; earlier ones live until
+                            // Stop(): the callback may still hold them.)
+
+  std::unique_ptr<ActionPreparer> action_preparer_{};
+  std::unique_ptr<ActionWatchdog> action_watchdog_{};
+
+  ServiceGroups service_groups_{};
+  std::unordered_map<std::wstring, std::uint32_t>
+      service_group_ids_{}; // Key: group name, Value: group id
+
+  LatencyRecorder latency_recorder_{
+      static_cast<std::size_t>(LatencyStage::kCount)};
+  LatencyRecorder queue_wait_recorder_{kNotificationPriorityCount};
+  TotalCounters total_counters_{};
+  std::unique_ptr<TimelineRecorder> timeline_recorder_{}; // (Lives until
+                                                          // destruction: the
+                                                          // callback may still
+                                                          // hold it.)
 
   Context context_{};
 
+  NotificationDispatcher dispatcher_{Deliver,
+                                     ReleasePayload}; // (Runs ActionFunction)
+
+  // Periodic latency dump:
+  std::mutex latency_dump_mutex_{};
+  std::condition_variable_any latency_dump_condition_{};
+  std::jthread latency_dump_thread_{}; // (Last: joined first on destruction)
+
+  // Load the names of a service's dependencies into dependency_names_.
+  void LoadServiceDependencies(SC_HANDLE service,
+                               std::uint32_t service_id) noexcept;
+
+  // Build and publish the graph of the dependencies between subscribed
+  // services (unless it is the current one).
+  void PublishDependencies() noexcept;
+
+  // The ServiceData of a service name, created (with the next service id)
+  // on first use.
+  ServiceData &GetServiceData(const std::wstring &service_name);
+
+  // On entry to a pending state, start preparing; on any other state, end
+  // the service's preparation: returned for delivery if this is the state it
+  // was prepared for (and 'deliver'), cancelled otherwise.
+  static std::shared_ptr<Preparation>
+  UpdatePreparation(ServiceData &service_data, ActionPreparer &action_preparer,
+                    DWORD current_state, bool deliver) noexcept;
+
   static VOID CALLBACK NotifyCallbackFunc(_In_ DWORD dwNotify,
                                           _In_ PVOID pCallbackContext);
 
+  // Deliver
+  // NotificationDispatcher::DeliverFunction: calls the ActionFunction of the
+  // service (context: its ServiceData).
+  static void Deliver(void *context, const Notification &notification) noexcept;
+
+  // ReleasePayload
+  // NotificationDispatcher::ReleaseFunction: cancels the preparation of a
+  // notification that will not be delivered (context: its ServiceData).
+  static void ReleasePayload(void *context,
+                             std::shared_ptr<void> payload) noexcept;
+
   // SecHost.dll function wrappers:
 
   // SubscribeServiceChangeNotifications_wrapper()
@@ -0,0 +1,308 @@
+/*
+   SupervisorStatusNotifier.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "SupervisorStatusNotifier.h"
+
+#include "InotifyBatch.h"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr char kStatusFileName[]{"status"};
+constexpr char kSuperviseName[]{"supervise"};
+
+// The service directories: supervise created, removed or replaced.
+constexpr std::uint32_t kDirectoryMask{IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                       IN_MOVED_TO | IN_ONLYDIR};
+
+std::uint64_t LittleEndian(const std::span<const std::byte> bytes) noexcept {
+  std::uint64_t value{0};
+  for (std::size_t index{bytes.size()}; index > 0; --index) {
+    value = value << 8 | std::to_integer<std::uint64_t>(bytes[index - 1]);
+  }
+  return value;
+}
+
+std::uint64_t BigEndian(const std::span<const std::byte> bytes) noexcept {
+  std::uint64_t value{0};
+  for (const auto byte : bytes) {
+    value = value << 8 | std::to_integer<std::uint64_t>(byte);
+  }
+  return value;
+}
+
+} // namespace
+
+// DecodeSupervisorStatus
+bool DecodeSupervisorStatus(const std::span<const std::byte> status,
+                            SupervisorStatus &decoded) noexcept {
+  switch (status.size()) {
+  case 18:   // daemontools
+  case 20: { // runit
+    decoded.pid = LittleEndian(status.subspan(12, 4));
+    const bool paused{status[16] != std::byte{0}};
+    const auto run_state{status.size() == 20
+                             ? std::to_integer<unsigned>(status[19])
+                             : (decoded.pid != 0 ? 1U : 0U)};
+    if (run_state == 2) {
+      decoded.current_state = SERVICE_NOTIFY_STOP_PENDING; // (./finish)
+    } else if (decoded.pid == 0) {
+      decoded.current_state = SERVICE_NOTIFY_STOPPED;
+    } else {
+      decoded.current_state =
+          paused ? SERVICE_NOTIFY_PAUSED : SERVICE_NOTIFY_RUNNING;
+    }
+    return true;
+  }
+  case 35:   // s6
+  case 43: { // s6 >= 2.11 (with pgid)
+    decoded.pid = BigEndian(status.subspan(24, 8));
+    const auto flags{std::to_integer<unsigned>(status.back())};
+    if (flags & 0x2) {
+      decoded.current_state = SERVICE_NOTIFY_STOP_PENDING; // (./finish)
+    } else if (decoded.pid == 0) {
+      decoded.current_state = SERVICE_NOTIFY_STOPPED;
+    } else if (flags & 0x1) {
+      decoded.current_state = SERVICE_NOTIFY_PAUSED;
+    } else {
+      decoded.current_state = flags & 0x8 ? SERVICE_NOTIFY_RUNNING
+                                          : SERVICE_NOTIFY_START_PENDING;
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+// Start
+void SupervisorStatusNotifier::Start(
+    const std::vector<std::string> &service_list,
+    const std::uint32_t notify_mask,
+    const ActionFunction &action_function) noexcept {
+  Stop();
+
+  notify_mask_ = notify_mask;
+  action_function_ = action_function;
+
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (inotify_fd_ < 0 || wake_fd_ < 0) {
+    Stop(); // (Closes whatever was opened.)
+    return;
+  }
+
+  try {
+    services_.reserve(service_list.size());
+    for (const auto &service_name : service_list) { // For each service dir
+      const auto service_index{static_cast<std::uint32_t>(services_.size())};
+      ServiceData &service_data{services_.emplace_back()};
+      service_data.service_name = service_name;
+      service_data.supervise_path = service_name + "/" + kSuperviseName;
+
+      // (The service directory first: a supervise directory created in
+      // between is reported by it.)
+      const int directory_watch{inotify_add_watch(
+          inotify_fd_, service_name.c_str(), kDirectoryMask)};
+      if (directory_watch >= 0) {
+        directory_watches_[directory_watch] = service_index;
+      }
+      if (!Attach(service_index)) {
+        if (directory_watch < 0) {
+          services_.pop_back(); // (No service directory)
+        }
+        continue; // (Not supervised yet: STOPPED until supervise appears.)
+      }
+
+      Refresh(service_data, false); // (Initial state: not notified.)
+    }
+  } catch (...) {
+    // (Out of memory: watch what was set up so far.)
+  }
+
+  watcher_thread_ = std::jthread(
+      [this](const std::stop_token &stop_token) { Run(stop_token); });
+}
+
+// Stop
+void SupervisorStatusNotifier::Stop() noexcept {
+  if (watcher_thread_.joinable()) {
+    watcher_thread_.request_stop();
+    const std::uint64_t wake{1};
+    [[maybe_unused]] const auto written{write(wake_fd_, &wake, sizeof(wake))};
+    watcher_thread_.join();
+  }
+
+  for (const auto &service_data : services_) {
+    if (service_data.supervise_fd >= 0) {
+      close(service_data.supervise_fd);
+    }
+  }
+  services_.clear();
+  watches_.clear();
+  directory_watches_.clear();
+
+  for (int *const fd : {&inotify_fd_, &wake_fd_}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+// Run
+// The watcher thread: wake up, drain all queued inotify records, mark the
+// services whose status file changed (or whose supervise directory was
+// created, removed or replaced), then refresh each of them once.
+void SupervisorStatusNotifier::Run(const std::stop_token &stop_token) noexcept {
+  try {
+    InotifyChanges changes(services_.size());
+    RunInotifyBatches(
+        stop_token, inotify_fd_, wake_fd_, changes,
+        [this, &changes](const inotify_event &record) {
+          if (const auto found{watches_.find(record.wd)};
+              found != watches_.end()) {
+            if (record.mask & IN_IGNORED) {
+              changes.Mark(found->second, InotifyChanges::Change::kReplaced);
+            } else if (record.len != 0 &&
+                       std::strcmp(record.name, kStatusFileName) == 0) {
+              changes.Mark(found->second); // (Not status.new, lock, ...)
+            }
+          } else if (const auto directory{directory_watches_.find(record.wd)};
+                     directory != directory_watches_.end()) {
+            if (record.mask & IN_IGNORED) { // (The service directory is gone)
+              changes.Mark(directory->second,
+                           InotifyChanges::Change::kReplaced);
+              directory_watches_.erase(directory);
+            } else if (record.len != 0 &&
+                       std::strcmp(record.name, kSuperviseName) == 0) {
+              changes.Mark(directory->second,
+                           InotifyChanges::Change::kReplaced);
+            }
+          }
+        },
+        [this](const std::uint32_t service_index, const bool replaced) {
+          ServiceData &service_data{services_[service_index]};
+          if (replaced) {
+            Detach(service_data);
+            if (!Attach(service_index)) {
+              SetState(service_data, SERVICE_NOTIFY_STOPPED, true); // (Gone)
+              return;
+            }
+          }
+          Refresh(service_data, true);
+        });
+  } catch (...) {
+    // (Out of memory: nothing is watched.)
+  }
+}
+
+// Attach
+bool SupervisorStatusNotifier::Attach(
+    const std::uint32_t service_index) noexcept {
+  ServiceData &service_data{services_[service_index]};
+  const int supervise_watch{
+      inotify_add_watch(inotify_fd_, service_data.supervise_path.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR)};
+  if (supervise_watch < 0) {
+    return false;
+  }
+  try {
+    watches_[supervise_watch] = service_index;
+  } catch (...) {
+    inotify_rm_watch(inotify_fd_, supervise_watch);
+    return false; // (Out of memory)
+  }
+  service_data.supervise_watch = supervise_watch;
+  service_data.supervise_fd = open(service_data.supervise_path.c_str(),
+                                   O_PATH | O_DIRECTORY | O_CLOEXEC);
+  return true;
+}
+
+// Detach
+void SupervisorStatusNotifier::Detach(ServiceData &service_data) noexcept {
+  if (service_data.supervise_watch >= 0) {
+    watches_.erase(service_data.supervise_watch);
+    inotify_rm_watch(inotify_fd_, service_data.supervise_watch);
+    service_data.supervise_watch = -1;
+  }
+  if (service_data.supervise_fd >= 0) {
+    close(service_data.supervise_fd);
+    service_data.supervise_fd = -1;
+  }
+}
+
+// Refresh
+void SupervisorStatusNotifier::Refresh(ServiceData &service_data,
+                                       const bool notify) noexcept {
+  if (service_data.supervise_fd < 0) {
+    return;
+  }
+
+  const int status_fd{
+      openat(service_data.supervise_fd, kStatusFileName, O_RDONLY | O_CLOEXEC)};
+  if (status_fd < 0) {
+    return;
+  }
+  std::array<std::byte, 64> status{};
+  const auto size{read(status_fd, status.data(), status.size())};
+  close(status_fd);
+
+  SupervisorStatus decoded;
+  if (size > 0 &&
+      DecodeSupervisorStatus(
+          std::span(status).first(static_cast<std::size_t>(size)), decoded)) {
+    SetState(service_data, decoded.current_state, notify);
+  }
+}
+
+// SetState
+void SupervisorStatusNotifier::SetState(ServiceData &service_data,
+                                        const std::uint32_t current_state,
+                                        const bool notify) noexcept {
+  if (current_state == service_data.current_state) {
+    return;
+  }
+  service_data.current_state = current_state;
+
+  if (notify && action_function_ &&
+      (current_state | notify_mask_) == notify_mask_) {
+    try {
+      action_function_(service_data.service_name,
+                       current_state); // <-- NOTIFY
+    } catch (...) {
+      // (The watcher thread must survive a throwing action.)
+    }
+  }
+}
+
+#endif
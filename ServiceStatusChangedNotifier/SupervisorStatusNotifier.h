@@ -0,0 +1,153 @@
+#ifndef AMITG_FC_SUPERVISOR_STATUS_NOTIFIER
+#define AMITG_FC_SUPERVISOR_STATUS_NOTIFIER
+
+/*
+   SupervisorStatusNotifier.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include "ServiceNotify.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// SupervisorStatus
+// A decoded supervise/status file.
+struct SupervisorStatus {
+  std::uint64_t pid{0};
+  std::uint32_t current_state{SERVICE_NOTIFY_STOPPED}; // (SERVICE_NOTIFY_xxx)
+};
+
+// DecodeSupervisorStatus
+// Decodes a supervise/status file in place (no copy, no allocation). The
+// format is told apart by its size:
+//	- 18 bytes (daemontools): tai64na[12], pid[4] (little-endian),
+//	  paused[1], want[1].
+//	- 20 bytes (runit): daemontools + term[1], state[1] (0 down, 1 run,
+//	  2 finish).
+//	- 35 / 43 bytes (s6): stamp[12], readystamp[12], pid[8] (big-endian),
+//	  [pgid[8], s6 >= 2.11,] wstat[2], flags[1] (paused 0x1, finishing 0x2,
+//	  want up 0x4, ready 0x8).
+// Returns false for any other size.
+[[nodiscard]] bool DecodeSupervisorStatus(std::span<const std::byte> status,
+                                          SupervisorStatus &decoded) noexcept;
+
+// Linux implementation for runit / s6 / daemontools supervision trees
+// A service is a service directory (e.g. "/etc/service/nginx"); its state
+// follows <service directory>/supervise/status:
+//	- up, paused                -> SERVICE_NOTIFY_PAUSED
+//	- up (s6: and ready)        -> SERVICE_NOTIFY_RUNNING
+//	- up, s6 not yet ready      -> SERVICE_NOTIFY_START_PENDING
+//	- finish script running     -> SERVICE_NOTIFY_STOP_PENDING
+//	- down                      -> SERVICE_NOTIFY_STOPPED
+//
+// The supervise directories are watched through one inotify descriptor
+// (status is replaced by rename, so IN_MOVED_TO / IN_CLOSE_WRITE on
+// "status"). A wakeup drains all queued records, de-duplicates the services,
+// and reads each status file once via openat() on a kept-open supervise
+// directory descriptor (RunInotifyBatches()). If the inotify queue
+// overflowed, every status file is re-read.
+//
+// The service directories are watched too (a kept-open supervise directory
+// never reports its own removal): a removed supervise directory reports
+// SERVICE_NOTIFY_STOPPED, and one created again is watched again. A service
+// whose supervise directory does not exist yet when Start() is called (the
+// supervisor has not started it) is STOPPED until the supervisor creates it.
+class SupervisorStatusNotifier final {
+public:
+  using ActionFunction = std::function<void(const std::string &service_name,
+                                            std::uint32_t current_state)>;
+
+  SupervisorStatusNotifier() = default;
+  ~SupervisorStatusNotifier() { Stop(); } // (Non-default destructor)
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  SupervisorStatusNotifier(const SupervisorStatusNotifier &) = delete;
+  SupervisorStatusNotifier &
+  operator=(const SupervisorStatusNotifier &) = delete;
+
+  // Delete move constructor and move assignment operator
+  SupervisorStatusNotifier(SupervisorStatusNotifier &&) = delete;
+  SupervisorStatusNotifier &operator=(SupervisorStatusNotifier &&) = delete;
+
+  // __Since non-default destructor
+
+  // Start watching the specified service directories (replaces a previous
+  // Start(); a service directory that does not exist is skipped).
+  // action_function is called on the watcher thread with the service
+  // directory as the service name.
+  void Start(const std::vector<std::string> &service_list,
+             std::uint32_t notify_mask,
+             const ActionFunction &action_function) noexcept;
+
+  // Stop watching (joins the watcher thread, closes all descriptors).
+  void Stop() noexcept;
+
+protected:
+  struct ServiceData {
+    std::string service_name{};
+    std::string supervise_path{}; // (<service_name>/supervise)
+    int supervise_watch{-1};
+    int supervise_fd{-1}; // (O_PATH descriptor of <service>/supervise)
+    std::uint32_t current_state{SERVICE_NOTIFY_STOPPED};
+  };
+
+  void Run(const std::stop_token &stop_token) noexcept;
+
+  // Watch and open the service's supervise directory; false if it has none.
+  bool Attach(std::uint32_t service_index) noexcept;
+  void Detach(ServiceData &service_data) noexcept;
+
+  // Re-read supervise/status; notify if the state changed.
+  void Refresh(ServiceData &service_data, bool notify) noexcept;
+
+  void SetState(ServiceData &service_data, std::uint32_t current_state,
+                bool notify) noexcept;
+
+  std::vector<ServiceData> services_{}; // (Index: service index)
+  std::unordered_map<int, std::uint32_t>
+      watches_{}; // Key: supervise watch descriptor, Value: service index
+  std::unordered_map<int, std::uint32_t>
+      directory_watches_{}; // Key: service directory watch descriptor,
+                            // Value: service index
+
+  std::uint32_t notify_mask_{0};
+  ActionFunction action_function_{};
+
+  int inotify_fd_{-1};
+  int wake_fd_{-1}; // (eventfd: wakes the watcher thread on Stop())
+
+  std::jthread watcher_thread_{}; // (Last: joined first on destruction)
+};
+
+#endif
+
+#endif
@@ -0,0 +1,214 @@
+/*
+   TimelineRecorder.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#if defined(_WIN32)
+#include <Windows.h> // Windows headers first
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "TimelineRecorder.h"
+
+#include <algorithm>
+#include <bit>
+#include <ostream>
+#include <string_view>
+#include <thread>
+
+namespace {
+
+// CurrentThreadId
+// (The OS thread id, so the timeline lines up with ETW / perf traces.)
+std::uint32_t CurrentThreadId() noexcept {
+#if defined(_WIN32)
+  return GetCurrentThreadId();
+#elif defined(__linux__)
+  return static_cast<std::uint32_t>(gettid());
+#else
+  return static_cast<std::uint32_t>(
+      std::hash<std::thread::id>{}(std::this_thread::get_id()));
+#endif
+}
+
+std::uint32_t CurrentProcessId() noexcept {
+#if defined(_WIN32)
+  return GetCurrentProcessId();
+#elif defined(__linux__)
+  return static_cast<std::uint32_t>(getpid());
+#else
+  return 1;
+#endif
+}
+
+// WriteJsonString
+// Writes a quoted JSON string (UTF-8 passes through; quotes, backslashes and
+// control characters are escaped).
+void WriteJsonString(std::ostream &stream, const std::string_view text) {
+  constexpr char kHexDigits[]{"0123456789abcdef"};
+  stream << '"';
+  for (const char character : text) {
+    const auto byte{static_cast<unsigned char>(character)};
+    if (character == '"' || character == '\\') {
+      stream << '\\' << character;
+    } else if (byte < 0x20) {
+      stream << "\\u00" << kHexDigits[byte >> 4] << kHexDigits[byte & 0xF];
+    } else {
+      stream << character;
+    }
+  }
+  stream << '"';
+}
+
+} // namespace
+
+// TimelineRecorder
+TimelineRecorder::TimelineRecorder(const std::size_t capacity)
+    : mask_{std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1},
+      slots_{std::make_unique<Slot[]>(mask_ + 1)} {}
+
+// Record
+// Seqlock writer. (Two writers can only race on one slot if the whole ring is
+// lapped while the first is between its two sequence stores.)
+void TimelineRecorder::Record(const TimelinePhase phase,
+                              const std::uint32_t service_id,
+                              const std::uint32_t state,
+                              const std::uint64_t event_id,
+                              const std::int64_t timestamp) noexcept {
+  const auto position{next_position_.fetch_add(1, std::memory_order_relaxed)};
+  Slot &slot{slots_[position & mask_]};
+
+  slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.timestamp.store(timestamp, std::memory_order_relaxed);
+  slot.event_id.store(event_id, std::memory_order_relaxed);
+  slot.service_and_state.store(
+      static_cast<std::uint64_t>(service_id) << 32 | state,
+      std::memory_order_relaxed);
+  slot.thread_and_phase.store(
+      static_cast<std::uint64_t>(CurrentThreadId()) << 8 |
+          static_cast<std::uint8_t>(phase),
+      std::memory_order_relaxed);
+
+  slot.sequence.store(2 * (position + 1), std::memory_order_release);
+}
+
+// Events
+std::vector<TimelineEvent> TimelineRecorder::Events() const {
+  const auto end{next_position_.load(std::memory_order_acquire)};
+  const auto begin{end > Capacity() ? end - Capacity() : 0};
+
+  std::vector<TimelineEvent> events;
+  events.reserve(static_cast<std::size_t>(end - begin));
+
+  for (auto position{begin}; position < end; ++position) {
+    const Slot &slot{slots_[position & mask_]};
+    const auto sequence{slot.sequence.load(std::memory_order_acquire)};
+    if (sequence != 2 * (position + 1)) {
+      continue; // (Still being written, or already overwritten.)
+    }
+
+    TimelineEvent event;
+    event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+    event.event_id = slot.event_id.load(std::memory_order_relaxed);
+    const auto service_and_state{
+        slot.service_and_state.load(std::memory_order_relaxed)};
+    const auto thread_and_phase{
+        slot.thread_and_phase.load(std::memory_order_relaxed)};
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue; // (Overwritten while reading.)
+    }
+
+    event.service_id = static_cast<std::uint32_t>(service_and_state >> 32);
+    event.state = static_cast<std::uint32_t>(service_and_state);
+    event.thread_id = static_cast<std::uint32_t>(thread_and_phase >> 8);
+    event.phase = static_cast<TimelinePhase>(thread_and_phase & 0xFF);
+    events.push_back(event);
+  }
+
+  std::ranges::stable_sort(events, {}, &TimelineEvent::timestamp);
+  return events;
+}
+
+// WriteChromeTrace
+// Arrival -> instant event; Enqueue/Dequeue -> async span "queued" (id:
+// event id); ActionBegin/ActionEnd -> duration span on the action's thread.
+// Timestamps are microseconds relative to the oldest retained event.
+void TimelineRecorder::WriteChromeTrace(
+    std::ostream &stream, const ServiceNameFunction &service_name) const {
+  const auto events{Events()};
+  const auto origin{events.empty() ? 0 : events.front().timestamp};
+  const auto process_id{CurrentProcessId()};
+
+  stream << R"({"displayTimeUnit":"ns","traceEvents":[)";
+
+  bool first{true};
+  for (const auto &event : events) {
+    stream << (first ? "\n" : ",\n");
+    first = false;
+
+    const auto name{service_name ? service_name(event.service_id)
+                                 : std::to_string(event.service_id)};
+    const auto microseconds{static_cast<double>(event.timestamp - origin) /
+                            1000.0};
+
+    stream << R"({"name":)";
+    switch (event.phase) {
+    case TimelinePhase::kArrival:
+      WriteJsonString(stream, name + " arrival");
+      stream << R"(,"cat":"notification","ph":"i","s":"t")";
+      break;
+    case TimelinePhase::kEnqueue:
+    case TimelinePhase::kDequeue:
+      WriteJsonString(stream, name + " queued");
+      stream << R"(,"cat":"queue","ph":")"
+             << (event.phase == TimelinePhase::kEnqueue ? 'b' : 'e')
+             << R"(","id":)" << event.event_id;
+      break;
+    case TimelinePhase::kActionBegin:
+    case TimelinePhase::kActionEnd:
+      WriteJsonString(stream, name);
+      stream << R"(,"cat":"action","ph":")"
+             << (event.phase == TimelinePhase::kActionBegin ? 'B' : 'E')
+             << '"';
+      break;
+    }
+
+    const auto flags{stream.flags()};
+    const auto precision{stream.precision()};
+    stream << std::fixed;
+    stream.precision(3);
+    stream << R"(,"ts":)" << microseconds;
+    stream.flags(flags);
+    stream.precision(precision);
+
+    stream << R"(,"pid":)" << process_id << R"(,"tid":)" << event.thread_id
+           << R"(,"args":{"service_id":)" << event.service_id
+           << R"(,"state":)" << event.state << R"(,"event_id":)"
+           << event.event_id << "}}";
+  }
+
+  stream << "\n]}\n";
+}
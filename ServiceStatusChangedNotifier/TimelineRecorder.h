@@ -0,0 +1,104 @@
+#ifndef AMITG_FC_TIMELINE_RECORDER
+#define AMITG_FC_TIMELINE_RECORDER
+
+/*
+   TimelineRecorder.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+// TimelinePhase
+// The lifecycle points of a notification captured by TimelineRecorder.
+enum class TimelinePhase : std::uint8_t {
+  kArrival,     // Notification entered the notifier (instant)
+  kEnqueue,     // Queued for dispatch (async span begin, keyed by event id)
+  kDequeue,     // Taken off the queue (async span end)
+  kActionBegin, // ActionFunction started (duration begin, on its thread)
+  kActionEnd    // ActionFunction returned (duration end)
+};
+
+// TimelineEvent
+struct TimelineEvent {
+  std::int64_t timestamp{0}; // (MonotonicNanoseconds())
+  std::uint64_t event_id{0};
+  std::uint32_t service_id{0};
+  std::uint32_t state{0};
+  std::uint32_t thread_id{0};
+  TimelinePhase phase{TimelinePhase::kArrival};
+};
+
+// TimelineRecorder
+// Fixed-memory, lock-free, multi-writer ring buffer of TimelineEvent: a
+// writer claims a slot with one fetch_add and overwrites the oldest entry.
+// Each slot is guarded by a sequence word (seqlock), so a reader skips slots
+// that are being rewritten instead of blocking writers.
+class TimelineRecorder final {
+public:
+  using ServiceNameFunction = std::function<std::string(std::uint32_t)>;
+
+  // (Capacity is rounded up to a power of two.)
+  explicit TimelineRecorder(std::size_t capacity);
+  ~TimelineRecorder() = default;
+
+  TimelineRecorder(const TimelineRecorder &) = delete;
+  TimelineRecorder &operator=(const TimelineRecorder &) = delete;
+  TimelineRecorder(TimelineRecorder &&) = delete;
+  TimelineRecorder &operator=(TimelineRecorder &&) = delete;
+
+  void Record(TimelinePhase phase, std::uint32_t service_id,
+              std::uint32_t state, std::uint64_t event_id,
+              std::int64_t timestamp) noexcept;
+
+  // Consistent copy of the retained events, ordered by timestamp.
+  [[nodiscard]] std::vector<TimelineEvent> Events() const;
+
+  // Write the retained events as Chrome Trace Event JSON (chrome://tracing,
+  // ui.perfetto.dev). service_name returns a UTF-8 name for a service id.
+  void WriteChromeTrace(std::ostream &stream,
+                        const ServiceNameFunction &service_name) const;
+
+  [[nodiscard]] std::size_t Capacity() const noexcept { return mask_ + 1; }
+
+private:
+  // A slot is four relaxed atomic words published by 'sequence':
+  // odd = being written, 2 * (position + 1) = holds the event of 'position'.
+  struct Slot {
+    std::atomic<std::uint64_t> sequence{0};
+    std::atomic<std::int64_t> timestamp{0};
+    std::atomic<std::uint64_t> event_id{0};
+    std::atomic<std::uint64_t> service_and_state{0}; // (id << 32 | state)
+    std::atomic<std::uint64_t> thread_and_phase{0};  // (tid << 8 | phase)
+  };
+
+  const std::size_t mask_;
+  const std::unique_ptr<Slot[]> slots_;
+  std::atomic<std::uint64_t> next_position_{0};
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+   Tracepoints.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "Tracepoints.h"
+
+#if !defined(SSCN_DISABLE_TRACEPOINTS) && defined(_WIN32)
+
+// "AmitG.ServiceStatusChangedNotifier"
+// {b085d947-a54c-44a1-97ef-83c5e176ce63}
+TRACELOGGING_DEFINE_PROVIDER(service_status_notifier_trace_provider,
+                             "AmitG.ServiceStatusChangedNotifier",
+                             (0xb085d947, 0xa54c, 0x44a1, 0x97, 0xef, 0x83,
+                              0xc5, 0xe1, 0x76, 0xce, 0x63));
+
+namespace {
+
+// TraceProviderRegistration
+// Registers the provider for the lifetime of the module (static
+// initialization), so probes never check for registration themselves.
+struct TraceProviderRegistration {
+  TraceProviderRegistration() noexcept {
+    TraceLoggingRegister(service_status_notifier_trace_provider);
+  }
+  ~TraceProviderRegistration() {
+    TraceLoggingUnregister(service_status_notifier_trace_provider);
+  }
+
+  TraceProviderRegistration(const TraceProviderRegistration &) = delete;
+  TraceProviderRegistration &
+  operator=(const TraceProviderRegistration &) = delete;
+  TraceProviderRegistration(TraceProviderRegistration &&) = delete;
+  TraceProviderRegistration &operator=(TraceProviderRegistration &&) = delete;
+};
+
+const TraceProviderRegistration trace_provider_registration{};
+
+} // namespace
+
+#endif
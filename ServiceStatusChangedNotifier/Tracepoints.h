@@ -0,0 +1,161 @@
+#ifndef AMITG_FC_TRACEPOINTS
+#define AMITG_FC_TRACEPOINTS
+
+/*
+   Tracepoints.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+// Static tracepoints in the dispatch hot path.
+//
+// Every probe carries the service ID, the state (SERVICE_NOTIFY_xxx) and
+// MonotonicNanoseconds() timestamps already taken by the caller (a probe never
+// reads the clock itself).
+//
+// - Windows: TraceLogging (ETW) events of provider
+//   "AmitG.ServiceStatusChangedNotifier"
+//   {b085d947-a54c-44a1-97ef-83c5e176ce63}. A disabled provider costs one
+//   predictable branch per probe. E.g.:
+//     wpr -start GeneralProfile / tracelog / xperf, or
+//     logman start sscn -p {b085d947-a54c-44a1-97ef-83c5e176ce63} -ets
+// - Linux: <sys/sdt.h> USDT probes of provider "sscn" (a NOP instruction until
+//   a tracer attaches). E.g.:
+//     bpftrace -e 'usdt:./app:sscn:callback_entry { @[arg1] = count(); }'
+// - Elsewhere, or with SSCN_DISABLE_TRACEPOINTS defined: compiled out.
+
+#include <cstdint>
+
+#if !defined(SSCN_DISABLE_TRACEPOINTS) && defined(_WIN32)
+
+#include <Windows.h> // Windows headers first
+
+#include <TraceLoggingProvider.h>
+
+TRACELOGGING_DECLARE_PROVIDER(service_status_notifier_trace_provider);
+
+// (Each TraceLoggingWrite() is spelled out: TraceLogging counts its
+// arguments, which does not survive forwarding through a helper macro under
+// the traditional MSVC preprocessor.)
+#define SSCN_TRACE_SUBSCRIBE(service_id, state, timestamp, error_code)       \
+  TraceLoggingWrite(                                                         \
+      service_status_notifier_trace_provider, "Subscribe",                   \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(service_id), "ServiceId"), \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(state), "State"),        \
+      TraceLoggingInt64(static_cast<std::int64_t>(timestamp), "Timestamp"),  \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(error_code), "Error"))
+#define SSCN_TRACE_UNSUBSCRIBE(service_id, state, timestamp)                 \
+  TraceLoggingWrite(                                                         \
+      service_status_notifier_trace_provider, "Unsubscribe",                 \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(service_id), "ServiceId"), \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(state), "State"),        \
+      TraceLoggingInt64(static_cast<std::int64_t>(timestamp), "Timestamp"))
+#define SSCN_TRACE_CALLBACK_ENTRY(service_id, state, timestamp)              \
+  TraceLoggingWrite(                                                         \
+      service_status_notifier_trace_provider, "CallbackEntry",               \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(service_id), "ServiceId"), \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(state), "State"),        \
+      TraceLoggingInt64(static_cast<std::int64_t>(timestamp), "Timestamp"))
+#define SSCN_TRACE_FILTER_REJECT(service_id, state, timestamp)               \
+  TraceLoggingWrite(                                                         \
+      service_status_notifier_trace_provider, "FilterReject",                \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(service_id), "ServiceId"), \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(state), "State"),        \
+      TraceLoggingInt64(static_cast<std::int64_t>(timestamp), "Timestamp"))
+#define SSCN_TRACE_ENQUEUE(service_id, state, timestamp)                     \
+  TraceLoggingWrite(                                                         \
+      service_status_notifier_trace_provider, "Enqueue",                     \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(service_id), "ServiceId"), \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(state), "State"),        \
+      TraceLoggingInt64(static_cast<std::int64_t>(timestamp), "Timestamp"))
+#define SSCN_TRACE_DEQUEUE(service_id, state, timestamp)                     \
+  TraceLoggingWrite(                                                         \
+      service_status_notifier_trace_provider, "Dequeue",                     \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(service_id), "ServiceId"), \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(state), "State"),        \
+      TraceLoggingInt64(static_cast<std::int64_t>(timestamp), "Timestamp"))
+#define SSCN_TRACE_ACTION_COMPLETE(service_id, state, start_timestamp,       \
+                                   end_timestamp)                            \
+  TraceLoggingWrite(                                                         \
+      service_status_notifier_trace_provider, "ActionComplete",              \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(service_id), "ServiceId"), \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(state), "State"),        \
+      TraceLoggingInt64(static_cast<std::int64_t>(start_timestamp),          \
+                        "Timestamp"),                                        \
+      TraceLoggingInt64(static_cast<std::int64_t>(end_timestamp),            \
+                        "EndTimestamp"))
+#define SSCN_TRACE_ACTION_OVERRUN(service_id, state, start_timestamp,        \
+                                  deadline)                                  \
+  TraceLoggingWrite(                                                         \
+      service_status_notifier_trace_provider, "ActionOverrun",               \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(service_id), "ServiceId"), \
+      TraceLoggingUInt32(static_cast<std::uint32_t>(state), "State"),        \
+      TraceLoggingInt64(static_cast<std::int64_t>(start_timestamp),          \
+                        "Timestamp"),                                        \
+      TraceLoggingInt64(static_cast<std::int64_t>(deadline), "Deadline"))
+
+#elif !defined(SSCN_DISABLE_TRACEPOINTS) && defined(__linux__) &&           \
+    __has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+
+#define SSCN_TRACE_SUBSCRIBE(service_id, state, timestamp, error_code)       \
+  DTRACE_PROBE4(sscn, subscribe, service_id, state, timestamp, error_code)
+#define SSCN_TRACE_UNSUBSCRIBE(service_id, state, timestamp)                 \
+  DTRACE_PROBE3(sscn, unsubscribe, service_id, state, timestamp)
+#define SSCN_TRACE_CALLBACK_ENTRY(service_id, state, timestamp)              \
+  DTRACE_PROBE3(sscn, callback_entry, service_id, state, timestamp)
+#define SSCN_TRACE_FILTER_REJECT(service_id, state, timestamp)               \
+  DTRACE_PROBE3(sscn, filter_reject, service_id, state, timestamp)
+#define SSCN_TRACE_ENQUEUE(service_id, state, timestamp)                     \
+  DTRACE_PROBE3(sscn, enqueue, service_id, state, timestamp)
+#define SSCN_TRACE_DEQUEUE(service_id, state, timestamp)                     \
+  DTRACE_PROBE3(sscn, dequeue, service_id, state, timestamp)
+#define SSCN_TRACE_ACTION_COMPLETE(service_id, state, start_timestamp,       \
+                                   end_timestamp)                            \
+  DTRACE_PROBE4(sscn, action_complete, service_id, state, start_timestamp,   \
+                end_timestamp)
+#define SSCN_TRACE_ACTION_OVERRUN(service_id, state, start_timestamp,        \
+                                  deadline)                                  \
+  DTRACE_PROBE4(sscn, action_overrun, service_id, state, start_timestamp,    \
+                deadline)
+
+#else
+
+#define SSCN_TRACE_SUBSCRIBE(service_id, state, timestamp, error_code)       \
+  static_cast<void>(0)
+#define SSCN_TRACE_UNSUBSCRIBE(service_id, state, timestamp)                 \
+  static_cast<void>(0)
+#define SSCN_TRACE_CALLBACK_ENTRY(service_id, state, timestamp)              \
+  static_cast<void>(0)
+#define SSCN_TRACE_FILTER_REJECT(service_id, state, timestamp)               \
+  static_cast<void>(0)
+#define SSCN_TRACE_ENQUEUE(service_id, state, timestamp) static_cast<void>(0)
+#define SSCN_TRACE_DEQUEUE(service_id, state, timestamp) static_cast<void>(0)
+#define SSCN_TRACE_ACTION_COMPLETE(service_id, state, start_timestamp,       \
+                                   end_timestamp)                            \
+  static_cast<void>(0)
+#define SSCN_TRACE_ACTION_OVERRUN(service_id, state, start_timestamp,        \
+                                  deadline)                                  \
+  static_cast<void>(0)
+
+#endif
+
+#endif
@@ -36,6 +36,15 @@ int main() {
       SERVICE_NOTIFY_STOPPED, // Notify about service STOPPED (Notify Mask).
       OnNotificationActionFunction); // <-- Notify to this function (see above).
 
+  // Dump the notification pipeline latency histograms once a minute:
+  service_status_change_notifier.StartLatencyDump(
+      std::chrono::minutes(1),
+      [](const ServiceStatusChangedNotifier::LatencyStatistics &statistics) {
+        std::wosyncstream sync_stream(std::wcout);
+        ServiceStatusChangedNotifier::WriteLatencyStatistics(sync_stream,
+                                                             statistics);
+      });
+
   // Provide 5 minutes to manually Start / Stop "W32Time" and "WebClient"
   // services and to check the functionality.
   std::this_thread::sleep_for(std::chrono::minutes(5));
@@ -0,0 +1,197 @@
+/*
+   SyntheticServiceControl.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "SyntheticServiceControl.h"
+
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <unordered_map>
+
+namespace {
+
+// The synthetic "SCM" and "service" handles (never dereferenced).
+SC_HANDLE__ synthetic_sc_manager{};
+SC_HANDLE__ synthetic_service{};
+
+// SubscriptionRegistry
+// Owns the recorded subscriptions; a registration handle is the address of
+// its Subscription.
+struct SubscriptionRegistry {
+  std::mutex mutex{};
+  std::unordered_map<SyntheticServiceControl::Subscription *,
+                     std::unique_ptr<SyntheticServiceControl::Subscription>>
+      subscriptions{}; // Key: registration handle
+};
+
+SubscriptionRegistry &Registry() {
+  static SubscriptionRegistry registry;
+  return registry;
+}
+
+// DependencyRegistry
+// The dependency table, and one handle per service name while it is set (a
+// handle is the address of its name's entry).
+struct DependencyRegistry {
+  std::mutex mutex{};
+  std::unordered_map<std::wstring, std::vector<std::wstring>>
+      dependencies{}; // Key: service name
+  std::unordered_map<std::wstring, std::unique_ptr<SC_HANDLE__>>
+      handles{}; // Key: service name
+  std::unordered_map<SC_HANDLE, std::wstring> names{}; // Key: handle
+};
+
+DependencyRegistry &Dependencies() {
+  static DependencyRegistry registry;
+  return registry;
+}
+
+SC_HANDLE WINAPI OpenSCManagerSynthetic(_In_opt_ LPCWSTR, _In_opt_ LPCWSTR,
+                                        _In_ DWORD) {
+  return &synthetic_sc_manager;
+}
+
+SC_HANDLE WINAPI OpenServiceSynthetic(_In_ SC_HANDLE,
+                                      _In_ LPCWSTR lpServiceName, _In_ DWORD) {
+  auto &registry{Dependencies()};
+  const std::lock_guard lock(registry.mutex);
+  if (registry.dependencies.empty()) {
+    return &synthetic_service;
+  }
+  auto &handle{registry.handles[lpServiceName]};
+  if (!handle) {
+    handle = std::make_unique<SC_HANDLE__>();
+    registry.names.emplace(handle.get(), lpServiceName);
+  }
+  return handle.get();
+}
+
+BOOL WINAPI CloseServiceHandleSynthetic(_In_ SC_HANDLE) { return TRUE; }
+
+DWORD WINAPI SubscribeServiceChangeNotificationsSynthetic(
+    _In_ SC_HANDLE, _In_ SC_EVENT_TYPE,
+    _In_ PSC_NOTIFICATION_CALLBACK pCallback, _In_opt_ PVOID pCallbackContext,
+    _Out_ PSC_NOTIFICATION_REGISTRATION *pSubscription) {
+  auto subscription{std::make_unique<SyntheticServiceControl::Subscription>(
+      SyntheticServiceControl::Subscription{pCallback, pCallbackContext})};
+  *pSubscription =
+      std::bit_cast<PSC_NOTIFICATION_REGISTRATION>(subscription.get());
+
+  auto &registry{Registry()};
+  const std::lock_guard lock(registry.mutex);
+  registry.subscriptions.emplace(subscription.get(), std::move(subscription));
+  return ERROR_SUCCESS;
+}
+
+VOID WINAPI UnsubscribeServiceChangeNotificationsSynthetic(
+    _In_ PSC_NOTIFICATION_REGISTRATION pSubscription) {
+  const auto subscription{
+      std::bit_cast<SyntheticServiceControl::Subscription *>(pSubscription)};
+
+  auto &registry{Registry()};
+  const std::lock_guard lock(registry.mutex);
+  registry.subscriptions.erase(subscription);
+}
+
+// QueryServiceConfigSynthetic
+// Fills lpDependencies only (as a double-null-terminated list after the
+// structure).
+BOOL WINAPI QueryServiceConfigSynthetic(
+    _In_ SC_HANDLE hService,
+    _Out_writes_bytes_opt_(cbBufSize) LPQUERY_SERVICE_CONFIGW
+        lpServiceConfig,
+    _In_ DWORD cbBufSize, _Out_ LPDWORD pcbBytesNeeded) {
+  auto &registry{Dependencies()};
+  const std::lock_guard lock(registry.mutex);
+  std::wstring list;
+  if (const auto name{registry.names.find(hService)};
+      name != registry.names.end()) {
+    if (const auto found{registry.dependencies.find(name->second)};
+        found != registry.dependencies.end()) {
+      for (const auto &dependency : found->second) {
+        list += dependency;
+        list += L'\0';
+      }
+    }
+  }
+  list += L'\0';
+
+  const auto bytes_needed{static_cast<DWORD>(sizeof(QUERY_SERVICE_CONFIGW) +
+                                             list.size() * sizeof(wchar_t))};
+  *pcbBytesNeeded = bytes_needed;
+  if (!lpServiceConfig || cbBufSize < bytes_needed) {
+    return FALSE; // (ERROR_INSUFFICIENT_BUFFER)
+  }
+  std::memset(lpServiceConfig, 0, sizeof(QUERY_SERVICE_CONFIGW));
+  lpServiceConfig->lpDependencies =
+      reinterpret_cast<LPWSTR>(lpServiceConfig + 1);
+  std::memcpy(lpServiceConfig->lpDependencies, list.data(),
+              list.size() * sizeof(wchar_t));
+  return TRUE;
+}
+
+} // namespace
+
+// Api
+ServiceControlApi SyntheticServiceControl::Api() noexcept {
+  return {OpenSCManagerSynthetic, OpenServiceSynthetic,
+          CloseServiceHandleSynthetic,
+          SubscribeServiceChangeNotificationsSynthetic,
+          UnsubscribeServiceChangeNotificationsSynthetic,
+          QueryServiceConfigSynthetic};
+}
+
+// Subscriptions
+std::vector<SyntheticServiceControl::Subscription>
+SyntheticServiceControl::Subscriptions() {
+  auto &registry{Registry()};
+  const std::lock_guard lock(registry.mutex);
+  std::vector<Subscription> subscriptions;
+  subscriptions.reserve(registry.subscriptions.size());
+  for (const auto &subscription : registry.subscriptions | std::views::values) {
+    subscriptions.push_back(*subscription);
+  }
+  return subscriptions;
+}
+
+// SubscriptionCount
+std::size_t SyntheticServiceControl::SubscriptionCount() {
+  auto &registry{Registry()};
+  const std::lock_guard lock(registry.mutex);
+  return registry.subscriptions.size();
+}
+
+// SetDependencies
+void SyntheticServiceControl::SetDependencies(
+    const std::unordered_map<std::wstring, std::vector<std::wstring>>
+        &dependencies) {
+  auto &registry{Dependencies()};
+  const std::lock_guard lock(registry.mutex);
+  registry.dependencies = dependencies;
+  if (dependencies.empty()) {
+    registry.handles.clear();
+    registry.names.clear();
+  }
+}
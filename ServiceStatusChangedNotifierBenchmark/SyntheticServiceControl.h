@@ -0,0 +1,77 @@
+#ifndef AMITG_FC_SYNTHETIC_SERVICE_CONTROL
+#define AMITG_FC_SYNTHETIC_SERVICE_CONTROL
+
+/*
+   SyntheticServiceControl.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include <Windows.h> // Windows headers first
+
+#include "ServiceControlApi.h"
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// SyntheticServiceControl
+// An in-process stand-in for the Service Control Manager: every service name
+// opens, subscriptions are recorded instead of registered with the SCM, and
+// the benchmark fires notifications by invoking the recorded callbacks
+// directly (as the SCM threadpool would).
+class SyntheticServiceControl final {
+public:
+  // A recorded subscription: the notifier's callback and its context.
+  struct Subscription {
+    PSC_NOTIFICATION_CALLBACK callback{nullptr};
+    PVOID callback_context{nullptr};
+
+    void Fire(const DWORD notify) const { callback(notify, callback_context); }
+
+    // The subscribed service (the notifier passes its SERVICE_NOTIFY buffer
+    // as the callback context, as SubscribeServiceChangeNotifications
+    // expects).
+    [[nodiscard]] const wchar_t *ServiceName() const noexcept {
+      return static_cast<PSERVICE_NOTIFY>(callback_context)->pszServiceNames;
+    }
+  };
+
+  SyntheticServiceControl() = delete;
+
+  // The ServiceControlApi table to pass to ServiceStatusChangedNotifier.
+  [[nodiscard]] static ServiceControlApi Api() noexcept;
+
+  // Copy of the active subscriptions, in no particular order. (Firing one
+  // after the owning notifier unsubscribed is undefined, as with the SCM.)
+  [[nodiscard]] static std::vector<Subscription> Subscriptions();
+
+  [[nodiscard]] static std::size_t SubscriptionCount();
+
+  // Dependencies reported by QueryServiceConfig() (Key: service name, Value:
+  // the names of the services it depends on). While the table is not empty,
+  // each service name opens its own handle.
+  static void SetDependencies(
+      const std::unordered_map<std::wstring, std::vector<std::wstring>>
+          &dependencies);
+};
+
+#endif
@@ -0,0 +1,1847 @@
+/*
+   main.cpp (ServiceStatusChangedNotifierBenchmark)
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+// Benchmark suite for the notifier core, driven by SyntheticServiceControl
+// (no SCM, no admin rights needed). Results are written to stdout as JSON:
+//   {"suite": "...", "quick": false, "results": [
+//     {"name": "...", "parameters": {...}, "metrics": {...}}, ...]}
+//
+// Usage: ServiceStatusChangedNotifierBenchmark [--quick]
+//   --quick: one tenth of the iterations (smoke run).
+//   (--action-worker: the ActionExecutor worker the suite starts itself.)
+
+#include <Windows.h> // Windows headers first
+
+#include "ActionExecutor.h"
+#include "EventCorrelator.h"
+#include "MonotonicClock.h"
+#include "ProcessScanNotifier.h"
+#include "RemediationScheduler.h"
+#include "RestartGovernor.h"
+#include "RuleEngine.h"
+#include "ServiceCounters.h"
+#include "ServiceStatusChangedNotifier.h"
+#include "SyntheticServiceControl.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace // (Anonymous namespace)
+{
+
+// Allocation accounting (memory per service): every allocation carries a
+// header with its size, so live bytes are exact regardless of the CRT.
+std::atomic<std::int64_t> live_bytes{0};
+
+struct AllocationHeader {
+  void *raw{nullptr};
+  std::size_t size{0};
+};
+
+void *CountedAllocate(const std::size_t size, std::size_t alignment) {
+  alignment = std::max(alignment, alignof(std::max_align_t));
+  auto *const raw{static_cast<char *>(
+      std::malloc(size + alignment + sizeof(AllocationHeader)))};
+  if (!raw) {
+    throw std::bad_alloc();
+  }
+  const auto user{(reinterpret_cast<std::uintptr_t>(raw) +
+                   sizeof(AllocationHeader) + alignment - 1) &
+                  ~(static_cast<std::uintptr_t>(alignment) - 1)};
+  auto *const header{
+      reinterpret_cast<AllocationHeader *>(user - sizeof(AllocationHeader))};
+  header->raw = raw;
+  header->size = size;
+  live_bytes.fetch_add(static_cast<std::int64_t>(size),
+                       std::memory_order_relaxed);
+  return reinterpret_cast<void *>(user);
+}
+
+void CountedFree(void *const pointer) noexcept {
+  if (pointer) {
+    auto *const header{reinterpret_cast<AllocationHeader *>(
+        static_cast<char *>(pointer) - sizeof(AllocationHeader))};
+    live_bytes.fetch_sub(static_cast<std::int64_t>(header->size),
+                         std::memory_order_relaxed);
+    std::free(header->raw);
+  }
+}
+
+// BenchmarkResult
+struct BenchmarkResult {
+  std::string name{};
+  std::vector<std::pair<std::string, double>> parameters{};
+  std::vector<std::pair<std::string, double>> metrics{};
+};
+
+void WriteJsonObject(
+    std::ostream &stream,
+    const std::vector<std::pair<std::string, double>> &fields) {
+  stream << '{';
+  for (std::size_t index{0}; index < fields.size(); ++index) {
+    stream << (index ? ", " : "") << '"' << fields[index].first
+           << "\": " << fields[index].second;
+  }
+  stream << '}';
+}
+
+void WriteJsonReport(std::ostream &stream,
+                     const std::vector<BenchmarkResult> &results,
+                     const bool quick) {
+  stream.precision(6);
+  stream << "{\"suite\": \"ServiceStatusChangedNotifier\", \"quick\": "
+         << (quick ? "true" : "false") << ", \"results\": [";
+  for (std::size_t index{0}; index < results.size(); ++index) {
+    stream << (index ? ",\n  " : "\n  ") << "{\"name\": \""
+           << results[index].name << "\", \"parameters\": ";
+    WriteJsonObject(stream, results[index].parameters);
+    stream << ", \"metrics\": ";
+    WriteJsonObject(stream, results[index].metrics);
+    stream << '}';
+  }
+  stream << "\n]}\n";
+}
+
+std::vector<std::wstring> ServiceNames(const std::size_t count) {
+  std::vector<std::wstring> service_names;
+  service_names.reserve(count);
+  for (std::size_t index{0}; index < count; ++index) {
+    service_names.push_back(L"SyntheticService" + std::to_wstring(index));
+  }
+  return service_names;
+}
+
+constexpr DWORD kNotifyMask{SERVICE_NOTIFY_STOPPED | SERVICE_NOTIFY_RUNNING};
+
+void NoOpAction(const std::wstring &, DWORD) {}
+
+// RunOnThreads
+// Runs body(thread_index) on 'thread_count' threads released together;
+// returns the wall time in nanoseconds.
+template <typename Body>
+std::int64_t RunOnThreads(const std::size_t thread_count, Body body) {
+  std::atomic<bool> go{false};
+  std::vector<std::jthread> threads;
+  threads.reserve(thread_count);
+  for (std::size_t thread_index{0}; thread_index < thread_count;
+       ++thread_index) {
+    threads.emplace_back([&go, &body, thread_index] {
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      body(thread_index);
+    });
+  }
+  const auto start{MonotonicNanoseconds()};
+  go.store(true, std::memory_order_release);
+  threads.clear(); // (Joins)
+  return MonotonicNanoseconds() - start;
+}
+
+// Callback path: ns per NotifyCallbackFunc() call (delivered, filtered, and
+// delivered with the timeline recorder on).
+void BenchmarkCallbackPath(std::vector<BenchmarkResult> &results,
+                           const std::size_t iterations) {
+  ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+  notifier.Start(ServiceNames(1), kNotifyMask, NoOpAction);
+  const auto subscription{SyntheticServiceControl::Subscriptions().front()};
+
+  const auto measure = [&](const DWORD notify) {
+    const auto start{MonotonicNanoseconds()};
+    for (std::size_t iteration{0}; iteration < iterations; ++iteration) {
+      subscription.Fire(notify);
+    }
+    return static_cast<double>(MonotonicNanoseconds() - start) /
+           static_cast<double>(iterations);
+  };
+
+  const auto delivered{measure(SERVICE_NOTIFY_STOPPED)};
+  const auto filtered{measure(SERVICE_NOTIFY_PAUSED)};
+  notifier.StartTimeline();
+  const auto timeline{measure(SERVICE_NOTIFY_STOPPED)};
+  notifier.StopTimeline();
+
+  results.push_back({"callback_path",
+                     {{"iterations", static_cast<double>(iterations)}},
+                     {{"delivered_ns_per_op", delivered},
+                      {"filtered_ns_per_op", filtered},
+                      {"delivered_with_timeline_ns_per_op", timeline}}});
+  notifier.Stop();
+}
+
+// Subscribe / unsubscribe throughput (per service).
+void BenchmarkSubscribeUnsubscribe(std::vector<BenchmarkResult> &results,
+                                   const std::size_t rounds) {
+  constexpr std::size_t kServiceCount{1000};
+  const auto service_names{ServiceNames(kServiceCount)};
+  ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+
+  std::int64_t subscribe_time{0};
+  std::int64_t unsubscribe_time{0};
+  for (std::size_t round{0}; round < rounds; ++round) {
+    const auto start{MonotonicNanoseconds()};
+    notifier.Start(service_names, kNotifyMask, NoOpAction);
+    const auto middle{MonotonicNanoseconds()};
+    notifier.Stop();
+    unsubscribe_time += MonotonicNanoseconds() - middle;
+    subscribe_time += middle - start;
+  }
+
+  const auto operations{static_cast<double>(kServiceCount * rounds)};
+  results.push_back(
+      {"subscribe_unsubscribe",
+       {{"services", static_cast<double>(kServiceCount)},
+        {"rounds", static_cast<double>(rounds)}},
+       {{"subscribes_per_second",
+         operations * 1e9 / static_cast<double>(subscribe_time)},
+        {"unsubscribes_per_second",
+         operations * 1e9 / static_cast<double>(unsubscribe_time)}}});
+}
+
+// Start() time versus service count.
+void BenchmarkStartTime(std::vector<BenchmarkResult> &results) {
+  for (const std::size_t service_count : {10, 100, 1000, 10000, 50000}) {
+    const auto service_names{ServiceNames(service_count)};
+    ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+
+    const auto start{MonotonicNanoseconds()};
+    notifier.Start(service_names, kNotifyMask, NoOpAction);
+    const auto elapsed{MonotonicNanoseconds() - start};
+    notifier.Stop();
+
+    results.push_back(
+        {"start_time",
+         {{"services", static_cast<double>(service_count)}},
+         {{"milliseconds", static_cast<double>(elapsed) / 1e6},
+          {"ns_per_service", static_cast<double>(elapsed) /
+                                 static_cast<double>(service_count)}}});
+  }
+}
+
+// Memory per service: live heap bytes of a started notifier, minus an empty
+// one, per service.
+void BenchmarkMemoryPerService(std::vector<BenchmarkResult> &results) {
+  const auto live_bytes_of = [](const std::vector<std::wstring> &names) {
+    const auto before{live_bytes.load()};
+    auto notifier{std::make_unique<ServiceStatusChangedNotifier>(
+        SyntheticServiceControl::Api())};
+    notifier->Start(names, kNotifyMask, NoOpAction);
+    const auto after{live_bytes.load()};
+    notifier->Stop();
+    return after - before;
+  };
+
+  const auto empty{live_bytes_of({})};
+  for (const std::size_t service_count : {1000, 10000}) {
+    const auto service_names{ServiceNames(service_count)};
+    const auto bytes{live_bytes_of(service_names) - empty};
+    results.push_back(
+        {"memory_per_service",
+         {{"services", static_cast<double>(service_count)}},
+         {{"bytes_per_service", static_cast<double>(bytes) /
+                                    static_cast<double>(service_count)},
+          {"sizeof_notifier",
+           static_cast<double>(sizeof(ServiceStatusChangedNotifier))}}});
+  }
+}
+
+// Delivery throughput versus the number of threads firing notifications
+// concurrently (as the SCM threadpool does), each on its own services.
+void BenchmarkThroughputVersusThreads(std::vector<BenchmarkResult> &results,
+                                      const std::size_t total_events) {
+  constexpr std::size_t kServicesPerThread{16};
+  for (const std::size_t thread_count : {1, 2, 4, 8, 16, 32, 64}) {
+    ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+    notifier.Start(ServiceNames(thread_count * kServicesPerThread),
+                   kNotifyMask, NoOpAction);
+    const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+
+    const auto events_per_thread{total_events / thread_count};
+    const auto elapsed{RunOnThreads(thread_count, [&](const std::size_t
+                                                          thread_index) {
+      for (std::size_t event{0}; event < events_per_thread; ++event) {
+        subscriptions[thread_index * kServicesPerThread +
+                      event % kServicesPerThread]
+            .Fire(event & 1 ? SERVICE_NOTIFY_RUNNING : SERVICE_NOTIFY_STOPPED);
+      }
+    })};
+    notifier.Stop();
+
+    const auto events{static_cast<double>(events_per_thread * thread_count)};
+    results.push_back(
+        {"throughput_vs_threads",
+         {{"threads", static_cast<double>(thread_count)}},
+         {{"events_per_second", events * 1e9 / static_cast<double>(elapsed)}}});
+  }
+}
+
+// Ordering stress: 16 threads fire notifications for the same 8 services
+// concurrently (as the SCM threadpool may). Per service, the action checks
+// that it is never entered concurrently and that sequence numbers only
+// increase; violations and lost notifications are reported (both must be 0).
+void BenchmarkOrderingStress(std::vector<BenchmarkResult> &results,
+                             const std::size_t events_per_thread) {
+  constexpr std::size_t kServiceCount{8};
+  constexpr std::size_t kThreadCount{16};
+  constexpr std::size_t kPrefixLength{
+      std::wstring_view(L"SyntheticService").size()};
+
+  for (const std::size_t worker_threads : {0, 4}) {
+    struct ServiceCheck {
+      std::atomic<std::uint64_t> last_sequence{0};
+      std::atomic<int> in_flight{0};
+    };
+    std::vector<ServiceCheck> checks(kServiceCount);
+    std::atomic<std::uint64_t> violations{0};
+    std::atomic<std::uint64_t> delivered{0};
+
+    ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+    notifier.Start(
+        ServiceNames(kServiceCount), kNotifyMask,
+        [&](const std::wstring &service_name, DWORD,
+            const std::uint64_t sequence) {
+          auto &check{checks[std::stoul(service_name.substr(kPrefixLength))]};
+          if (check.in_flight.fetch_add(1) != 0) {
+            violations.fetch_add(1);
+          }
+          if (sequence <= check.last_sequence.load(std::memory_order_relaxed)) {
+            violations.fetch_add(1);
+          }
+          check.last_sequence.store(sequence, std::memory_order_relaxed);
+          check.in_flight.fetch_sub(1);
+          delivered.fetch_add(1, std::memory_order_relaxed);
+        },
+        DispatchOptions{worker_threads});
+    const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+
+    const auto elapsed{RunOnThreads(kThreadCount, [&](const std::size_t
+                                                          thread_index) {
+      for (std::size_t event{0}; event < events_per_thread; ++event) {
+        subscriptions[(thread_index + event) % kServiceCount].Fire(
+            event & 1 ? SERVICE_NOTIFY_RUNNING : SERVICE_NOTIFY_STOPPED);
+      }
+    })};
+    notifier.Stop(); // (Delivers what is still queued)
+
+    const auto events{events_per_thread * kThreadCount};
+    results.push_back(
+        {"ordering_stress",
+         {{"threads", static_cast<double>(kThreadCount)},
+          {"services", static_cast<double>(kServiceCount)},
+          {"worker_threads", static_cast<double>(worker_threads)}},
+         {{"events_per_second",
+           static_cast<double>(events) * 1e9 / static_cast<double>(elapsed)},
+          {"ordering_violations", static_cast<double>(violations.load())},
+          {"lost", static_cast<double>(events - delivered.load())}}});
+  }
+}
+
+// Dispatcher throughput versus worker threads: 4 threads fire notifications
+// for 256 services; each action spins for ~2us (a "slow" action). Measured
+// from the first notification until Stop() has delivered the last one.
+void BenchmarkDispatcherThroughput(std::vector<BenchmarkResult> &results,
+                                   const std::size_t total_events) {
+  constexpr std::size_t kServiceCount{256};
+  constexpr std::size_t kFiringThreads{4};
+  constexpr std::int64_t kActionNanoseconds{2000};
+
+  const auto slow_action = [](const std::wstring &, DWORD) {
+    const auto until{MonotonicNanoseconds() + kActionNanoseconds};
+    while (MonotonicNanoseconds() < until) {
+    }
+  };
+
+  for (const bool pin_workers : {false, true}) {
+    for (const std::size_t worker_threads : {1, 2, 4, 8, 16, 32, 64}) {
+      ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+      notifier.Start(ServiceNames(kServiceCount), kNotifyMask, slow_action,
+                     DispatchOptions{worker_threads, pin_workers});
+      const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+
+      const auto events_per_thread{total_events / kFiringThreads};
+      const auto start{MonotonicNanoseconds()};
+      RunOnThreads(kFiringThreads, [&](const std::size_t thread_index) {
+        for (std::size_t event{0}; event < events_per_thread; ++event) {
+          subscriptions[(thread_index + event * kFiringThreads) %
+                        kServiceCount]
+              .Fire(event & 1 ? SERVICE_NOTIFY_RUNNING
+                              : SERVICE_NOTIFY_STOPPED);
+        }
+      });
+      notifier.Stop(); // (Delivers what is still queued)
+      const auto elapsed{MonotonicNanoseconds() - start};
+
+      const auto events{
+          static_cast<double>(events_per_thread * kFiringThreads)};
+      results.push_back(
+          {"dispatcher_throughput_vs_workers",
+           {{"worker_threads", static_cast<double>(worker_threads)},
+            {"pinned", pin_workers ? 1.0 : 0.0},
+            {"action_ns", static_cast<double>(kActionNanoseconds)}},
+           {{"events_per_second",
+             events * 1e9 / static_cast<double>(elapsed)}}});
+    }
+  }
+}
+
+// Priority storm (the reboot case): 800 services change state at once, 16 of
+// them high priority and 384 low; 2 workers run 20us actions. Reports the
+// queueing latency per class.
+void BenchmarkPriorityStorm(std::vector<BenchmarkResult> &results,
+                            const std::size_t rounds) {
+  constexpr std::size_t kServiceCount{800};
+  constexpr std::size_t kHighCount{16};
+  constexpr std::size_t kLowCount{384};
+  constexpr std::int64_t kActionNanoseconds{20000};
+
+  const auto service_names{ServiceNames(kServiceCount)};
+  ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+  for (std::size_t index{0}; index < kServiceCount; ++index) {
+    if (index % (kServiceCount / kHighCount) == 0) {
+      notifier.SetServicePriority(service_names[index],
+                                  NotificationPriority::kHigh);
+    } else if (index % 2 == 1 && index / 2 < kLowCount) {
+      notifier.SetServicePriority(service_names[index],
+                                  NotificationPriority::kLow);
+    }
+  }
+  notifier.Start(
+      service_names, kNotifyMask,
+      [](const std::wstring &, DWORD) {
+        const auto until{MonotonicNanoseconds() + kActionNanoseconds};
+        while (MonotonicNanoseconds() < until) {
+        }
+      },
+      DispatchOptions{2});
+  const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+
+  for (std::size_t round{0}; round < rounds; ++round) {
+    for (const auto &subscription : subscriptions) {
+      subscription.Fire(SERVICE_NOTIFY_RUNNING);
+    }
+  }
+  notifier.Stop(); // (Delivers what is still queued)
+
+  const auto statistics{notifier.GetLatencyStatistics()};
+  for (std::size_t priority{0}; priority < kNotificationPriorityCount;
+       ++priority) {
+    const auto &queue_wait{statistics.queue_wait[priority]};
+    results.push_back(
+        {"priority_storm",
+         {{"services", static_cast<double>(kServiceCount)},
+          {"priority", static_cast<double>(priority)},
+          {"rounds", static_cast<double>(rounds)}},
+         {{"count", static_cast<double>(queue_wait.count)},
+          {"queue_wait_p50_us",
+           static_cast<double>(queue_wait.ValueAtPercentile(50.0)) / 1e3},
+          {"queue_wait_p99_us",
+           static_cast<double>(queue_wait.ValueAtPercentile(99.0)) / 1e3}}});
+  }
+}
+
+// Backpressure storm: one thread offers 100k events/s (paced) to 100
+// services for 'duration' while a single worker runs 100us actions (10k/s).
+// Per overflow policy: the rate actually offered (kBlock throttles the
+// notifying thread), delivered, dropped and coalesced counts, the longest
+// notifying-thread stall, and the queue memory at the end of the storm.
+void BenchmarkBackpressureStorm(std::vector<BenchmarkResult> &results,
+                                const std::chrono::milliseconds duration) {
+  constexpr std::size_t kServiceCount{100};
+  constexpr std::int64_t kEventIntervalNanoseconds{10000}; // (100k/s)
+  constexpr std::int64_t kActionNanoseconds{100000};
+
+  const std::pair<OverflowPolicy, std::size_t> policies[]{
+      {OverflowPolicy::kBlock, 16},
+      {OverflowPolicy::kDropNewest, 16},
+      {OverflowPolicy::kDropOldest, 16},
+      {OverflowPolicy::kCoalesce, 1}};
+  for (const auto &[policy, capacity] : policies) {
+    std::atomic<std::uint64_t> delivered{0};
+    ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+    DispatchOptions dispatch_options{1};
+    dispatch_options.strand_capacity = capacity;
+    dispatch_options.overflow_policy = policy;
+    notifier.Start(
+        ServiceNames(kServiceCount), kNotifyMask,
+        [&delivered](const std::wstring &, DWORD) {
+          const auto until{MonotonicNanoseconds() + kActionNanoseconds};
+          while (MonotonicNanoseconds() < until) {
+          }
+          delivered.fetch_add(1, std::memory_order_relaxed);
+        },
+        dispatch_options);
+    const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+
+    const auto bytes_before{live_bytes.load()};
+    const auto start{MonotonicNanoseconds()};
+    const auto end{start + std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               duration)
+                               .count()};
+    std::size_t offered{0};
+    std::int64_t longest_stall{0};
+    for (auto next{start}; next < end; next += kEventIntervalNanoseconds) {
+      while (MonotonicNanoseconds() < next) {
+      }
+      const auto fire_start{MonotonicNanoseconds()};
+      subscriptions[offered % kServiceCount].Fire(
+          offered / kServiceCount & 1 ? SERVICE_NOTIFY_RUNNING
+                                      : SERVICE_NOTIFY_STOPPED);
+      longest_stall =
+          std::max(longest_stall, MonotonicNanoseconds() - fire_start);
+      ++offered;
+      next = std::max(next, MonotonicNanoseconds() - kEventIntervalNanoseconds);
+    }
+    const auto elapsed{MonotonicNanoseconds() - start};
+    const auto queue_bytes{live_bytes.load() - bytes_before};
+    notifier.Stop(); // (Delivers what is still queued)
+
+    const auto counters{notifier.GetTotalCounters()};
+    results.push_back(
+        {"backpressure_storm",
+         {{"policy", static_cast<double>(policy)},
+          {"strand_capacity", static_cast<double>(capacity)},
+          {"services", static_cast<double>(kServiceCount)},
+          {"target_events_per_second", 1e9 / kEventIntervalNanoseconds}},
+         {{"offered_events_per_second",
+           static_cast<double>(offered) * 1e9 / static_cast<double>(elapsed)},
+          {"delivered", static_cast<double>(delivered.load())},
+          {"dropped", static_cast<double>(counters.drops)},
+          {"coalesced", static_cast<double>(counters.coalesced)},
+          {"longest_stall_us", static_cast<double>(longest_stall) / 1e3},
+          {"queue_bytes_at_end", static_cast<double>(queue_bytes)}}});
+  }
+}
+
+// Flapping dedup: 20 services flap STOPPED / RUNNING 'flaps' times each, as
+// fast as one thread can fire, while one worker runs 50us actions. Per
+// duplicate policy: actions run, duplicates dropped or merged, the time until
+// every action has run, and the services whose last action was not for their
+// last state (kDrop can leave one; kTrailingRerun must not).
+void BenchmarkFlappingDedup(std::vector<BenchmarkResult> &results,
+                            const std::size_t flaps) {
+  constexpr std::size_t kServiceCount{20};
+  constexpr std::int64_t kActionNanoseconds{50000};
+
+  const auto service_names{ServiceNames(kServiceCount)};
+  for (const auto policy : {DuplicatePolicy::kDeliver, DuplicatePolicy::kDrop,
+                            DuplicatePolicy::kTrailingRerun}) {
+    std::atomic<std::uint64_t> actions{0};
+    std::unordered_map<std::wstring, DWORD> last_states; // (Per strand: no
+                                                         // two at once)
+    std::mutex last_states_mutex;
+    ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+    DispatchOptions dispatch_options{1};
+    dispatch_options.duplicate_policy = policy;
+    notifier.Start(
+        service_names, kNotifyMask,
+        [&](const std::wstring &service_name, const DWORD current_state) {
+          const auto until{MonotonicNanoseconds() + kActionNanoseconds};
+          while (MonotonicNanoseconds() < until) {
+          }
+          actions.fetch_add(1, std::memory_order_relaxed);
+          const std::scoped_lock lock(last_states_mutex);
+          last_states[service_name] = current_state;
+        },
+        dispatch_options);
+    const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+
+    const auto start{MonotonicNanoseconds()};
+    for (std::size_t flap{0}; flap < flaps; ++flap) {
+      for (const auto &subscription : subscriptions) {
+        subscription.Fire(SERVICE_NOTIFY_STOPPED);
+        subscription.Fire(SERVICE_NOTIFY_RUNNING);
+      }
+    }
+    for (const auto &subscription : subscriptions) {
+      subscription.Fire(SERVICE_NOTIFY_STOPPED); // (Each ends stopped)
+    }
+    notifier.Stop(); // (Delivers what is still queued)
+    const auto elapsed{MonotonicNanoseconds() - start};
+
+    std::size_t final_state_mismatches{0};
+    for (const auto &service_name : service_names) {
+      if (last_states[service_name] != SERVICE_NOTIFY_STOPPED) {
+        ++final_state_mismatches;
+      }
+    }
+
+    results.push_back(
+        {"flapping_dedup",
+         {{"policy", static_cast<double>(policy)},
+          {"services", kServiceCount},
+          {"flaps", static_cast<double>(flaps)}},
+         {{"actions", static_cast<double>(actions.load())},
+          {"deduplicated",
+           static_cast<double>(notifier.GetTotalCounters().deduplicated)},
+          {"drain_ms", static_cast<double>(elapsed) / 1e6},
+          {"final_state_mismatches",
+           static_cast<double>(final_state_mismatches)}}});
+  }
+}
+
+// Bounded flapping: 20 services flap through four states in random order
+// into strands of capacity 2 (kDropOldest) while the single worker is held
+// busy by a gate service, then the worker is released. Per duplicate policy:
+// the services that ran no action after the release for one of their two
+// most recent states (expected to be 0: an evicted action that duplicates
+// relied on is replaced by their re-run).
+void BenchmarkBoundedFlapping(std::vector<BenchmarkResult> &results,
+                              const std::size_t rounds) {
+  constexpr std::size_t kServiceCount{20};
+  constexpr std::size_t kFiresPerService{12};
+  constexpr std::size_t kStrandCapacity{2};
+  constexpr std::array<DWORD, 4> kStates{
+      SERVICE_NOTIFY_STOPPED, SERVICE_NOTIFY_START_PENDING,
+      SERVICE_NOTIFY_RUNNING, SERVICE_NOTIFY_STOP_PENDING};
+  constexpr DWORD kFlappingMask{SERVICE_NOTIFY_STOPPED |
+                                SERVICE_NOTIFY_START_PENDING |
+                                SERVICE_NOTIFY_RUNNING |
+                                SERVICE_NOTIFY_STOP_PENDING};
+
+  auto service_names{ServiceNames(kServiceCount)};
+  const std::wstring gate_name{L"SyntheticGate"};
+  service_names.push_back(gate_name);
+
+  for (const auto policy :
+       {DuplicatePolicy::kDrop, DuplicatePolicy::kTrailingRerun}) {
+    std::mt19937 random(42); // (The same patterns for every policy)
+    std::uint64_t actions{0};
+    std::uint64_t deduplicated{0};
+    std::uint64_t dropped{0};
+    std::size_t missing_recent_states{0};
+
+    for (std::size_t round{0}; round < rounds; ++round) {
+      std::atomic<bool> held{false};
+      std::atomic<bool> released{false};
+      std::unordered_map<std::wstring, std::vector<DWORD>> delivered;
+      std::mutex delivered_mutex;
+
+      ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+      DispatchOptions dispatch_options{1};
+      dispatch_options.strand_capacity = kStrandCapacity;
+      dispatch_options.overflow_policy = OverflowPolicy::kDropOldest;
+      dispatch_options.duplicate_policy = policy;
+      notifier.Start(
+          service_names, kFlappingMask,
+          [&](const std::wstring &service_name, const DWORD current_state) {
+            if (service_name == gate_name) {
+              held.store(true);
+              while (!released.load()) {
+                std::this_thread::yield();
+              }
+              return;
+            }
+            const std::scoped_lock lock(delivered_mutex);
+            delivered[service_name].push_back(current_state);
+          },
+          dispatch_options);
+
+      std::unordered_map<std::wstring, std::vector<DWORD>> recent_states;
+      std::vector<SyntheticServiceControl::Subscription> flapping;
+      const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+      for (const auto &subscription : subscriptions) {
+        if (subscription.ServiceName() == gate_name) {
+          subscription.Fire(SERVICE_NOTIFY_RUNNING);
+        } else {
+          flapping.push_back(subscription);
+        }
+      }
+      while (!held.load()) {
+        std::this_thread::yield();
+      }
+
+      for (const auto &subscription : flapping) {
+        std::vector<DWORD> fired;
+        for (std::size_t fire{0}; fire < kFiresPerService; ++fire) {
+          const auto state{kStates[random() % kStates.size()]};
+          subscription.Fire(state);
+          fired.push_back(state);
+        }
+        // (The distinct states of the latest fires, newest first.)
+        auto &recent{recent_states[subscription.ServiceName()]};
+        for (auto state{fired.rbegin()};
+             state != fired.rend() && recent.size() < kStrandCapacity;
+             ++state) {
+          if (std::ranges::find(recent, *state) == recent.end()) {
+            recent.push_back(*state);
+          }
+        }
+      }
+      released.store(true);
+      notifier.Stop(); // (Delivers what is still queued)
+
+      for (const auto &[service_name, recent] : recent_states) {
+        const auto &states{delivered[service_name]};
+        actions += states.size();
+        if (std::ranges::any_of(recent, [&states](const DWORD state) {
+              return std::ranges::find(states, state) == states.end();
+            })) {
+          ++missing_recent_states;
+        }
+      }
+      const auto counters{notifier.GetTotalCounters()};
+      deduplicated += counters.deduplicated;
+      dropped += counters.drops;
+    }
+
+    results.push_back(
+        {"bounded_flapping",
+         {{"policy", static_cast<double>(policy)},
+          {"services", kServiceCount},
+          {"strand_capacity", kStrandCapacity},
+          {"rounds", static_cast<double>(rounds)}},
+         {{"actions", static_cast<double>(actions)},
+          {"deduplicated", static_cast<double>(deduplicated)},
+          {"dropped", static_cast<double>(dropped)},
+          {"missing_recent_states",
+           static_cast<double>(missing_recent_states)}}});
+  }
+}
+
+// Rule engine: 10k services, 5k compound rules of 5 services each
+// ("a and b STOPPED, or at least 2 of c, d, e RUNNING"); ns per state update
+// with 1 and 4 updating threads. Baseline ("global_mutex"): the state table
+// under one mutex, every rule re-evaluated on every update.
+void BenchmarkRuleEngine(std::vector<BenchmarkResult> &results,
+                         const std::size_t updates) {
+  constexpr std::uint32_t kServiceCount{10000};
+  constexpr std::uint32_t kRuleCount{5000};
+
+  const auto rule_service = [](const std::uint32_t rule_id,
+                               const std::uint32_t operand) {
+    return (rule_id * 7919 + operand * 2003) % kServiceCount;
+  };
+  const auto update_state = [](const std::size_t index) {
+    return index % 3 == 0 ? SERVICE_NOTIFY_RUNNING : SERVICE_NOTIFY_STOPPED;
+  };
+
+  for (const std::size_t thread_count : {1, 4}) {
+    std::atomic<std::uint64_t> flips{0};
+    RuleEngine rule_engine;
+    for (std::uint32_t rule_id{0}; rule_id < kRuleCount; ++rule_id) {
+      const auto state = [&](const std::uint32_t operand,
+                             const std::uint32_t state_mask) {
+        return RuleExpression::ServiceState(rule_service(rule_id, operand),
+                                            state_mask);
+      };
+      rule_engine.AddRule(
+          (state(0, SERVICE_NOTIFY_STOPPED) &&
+           state(1, SERVICE_NOTIFY_STOPPED)) ||
+              RuleExpression::AtLeast(2, {state(2, SERVICE_NOTIFY_RUNNING),
+                                          state(3, SERVICE_NOTIFY_RUNNING),
+                                          state(4, SERVICE_NOTIFY_RUNNING)}),
+          [&flips](std::uint32_t, bool) {
+            flips.fetch_add(1, std::memory_order_relaxed);
+          });
+    }
+    rule_engine.Build();
+
+    const auto elapsed{
+        RunOnThreads(thread_count, [&](const std::size_t thread_index) {
+          for (std::size_t index{0}; index < updates; ++index) {
+            rule_engine.Update(static_cast<std::uint32_t>(
+                                   (index * 31 + thread_index) % kServiceCount),
+                               update_state(index));
+          }
+        })};
+    results.push_back(
+        {"rule_engine_indexed",
+         {{"threads", static_cast<double>(thread_count)},
+          {"services", kServiceCount},
+          {"rules", kRuleCount}},
+         {{"ns_per_update", static_cast<double>(elapsed) *
+                                static_cast<double>(thread_count) /
+                                static_cast<double>(thread_count * updates)},
+          {"flips", static_cast<double>(flips.load())}}});
+  }
+
+  for (const std::size_t thread_count : {1, 4}) {
+    std::mutex mutex;
+    std::vector<std::uint32_t> states(kServiceCount, 0);
+    std::vector<bool> rule_results(kRuleCount, false);
+    std::uint64_t flips{0};
+    const auto baseline_updates{std::max<std::size_t>(updates / 100, 1)};
+
+    const auto elapsed{
+        RunOnThreads(thread_count, [&](const std::size_t thread_index) {
+          for (std::size_t index{0}; index < baseline_updates; ++index) {
+            const std::lock_guard lock(mutex);
+            states[(index * 31 + thread_index) % kServiceCount] =
+                update_state(index);
+            for (std::uint32_t rule_id{0}; rule_id < kRuleCount; ++rule_id) {
+              const auto is = [&](const std::uint32_t operand,
+                                  const std::uint32_t state_mask) {
+                return (states[rule_service(rule_id, operand)] & state_mask) !=
+                       0;
+              };
+              const bool result{
+                  (is(0, SERVICE_NOTIFY_STOPPED) &&
+                   is(1, SERVICE_NOTIFY_STOPPED)) ||
+                  is(2, SERVICE_NOTIFY_RUNNING) +
+                          is(3, SERVICE_NOTIFY_RUNNING) +
+                          is(4, SERVICE_NOTIFY_RUNNING) >=
+                      2};
+              if (result != rule_results[rule_id]) {
+                rule_results[rule_id] = result;
+                ++flips;
+              }
+            }
+          }
+        })};
+    results.push_back(
+        {"rule_engine_global_mutex",
+         {{"threads", static_cast<double>(thread_count)},
+          {"services", kServiceCount},
+          {"rules", kRuleCount}},
+         {{"ns_per_update",
+           static_cast<double>(elapsed) * static_cast<double>(thread_count) /
+               static_cast<double>(thread_count * baseline_updates)},
+          {"flips", static_cast<double>(flips)}}});
+  }
+}
+
+// Service groups: 2000 services in 40 groups of 500 (each service in 10
+// groups); 4 threads fire notifications, each for its own services. ns per
+// notification without groups and with incrementally maintained group
+// aggregates, the group counts checked against a recount afterwards
+// (mismatches expected to be 0), and a recount-per-event baseline.
+void BenchmarkServiceGroups(std::vector<BenchmarkResult> &results,
+                            const std::size_t events_per_thread) {
+  constexpr std::size_t kServiceCount{2000};
+  constexpr std::size_t kGroupCount{40};
+  constexpr std::size_t kGroupSize{500};
+  constexpr std::size_t kThreadCount{4};
+  constexpr std::size_t kServicesPerThread{kServiceCount / kThreadCount};
+
+  const auto service_names{ServiceNames(kServiceCount)};
+  const auto group_member = [](const std::size_t group_index,
+                               const std::size_t member_index) {
+    return (group_index * 37 + member_index * 4) % kServiceCount;
+  };
+  const auto event_state = [](const std::size_t event) -> DWORD {
+    return event / kServicesPerThread & 1 ? SERVICE_NOTIFY_RUNNING
+                                          : SERVICE_NOTIFY_STOPPED;
+  };
+
+  for (const bool with_groups : {false, true}) {
+    ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+    std::vector<std::uint32_t> group_ids;
+    if (with_groups) {
+      for (std::size_t group_index{0}; group_index < kGroupCount;
+           ++group_index) {
+        std::vector<std::wstring> members;
+        for (std::size_t member_index{0}; member_index < kGroupSize;
+             ++member_index) {
+          members.push_back(
+              service_names[group_member(group_index, member_index)]);
+        }
+        group_ids.push_back(notifier.AddServiceGroup(
+            L"group" + std::to_wstring(group_index), members));
+      }
+    }
+    notifier.Start(service_names, kNotifyMask, NoOpAction);
+    const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+
+    std::vector<DWORD> last_states(kServiceCount, 0);
+    const auto elapsed{
+        RunOnThreads(kThreadCount, [&](const std::size_t thread_index) {
+          for (std::size_t event{0}; event < events_per_thread; ++event) {
+            const auto service_index{thread_index +
+                                     kThreadCount *
+                                         (event % kServicesPerThread)};
+            subscriptions[service_index].Fire(event_state(event));
+            last_states[service_index] = event_state(event);
+          }
+        })};
+
+    std::size_t mismatches{0};
+    for (std::size_t group_index{0}; group_index < group_ids.size();
+         ++group_index) {
+      std::uint32_t running{0};
+      for (std::size_t member_index{0}; member_index < kGroupSize;
+           ++member_index) {
+        running += last_states[group_member(group_index, member_index)] ==
+                   SERVICE_NOTIFY_RUNNING;
+      }
+      mismatches += notifier.CountInServiceGroup(group_ids[group_index],
+                                                 SERVICE_NOTIFY_RUNNING) !=
+                    running;
+    }
+    notifier.Stop();
+
+    results.push_back(
+        {with_groups ? "service_groups_incremental" : "service_groups_none",
+         {{"threads", static_cast<double>(kThreadCount)},
+          {"services", kServiceCount},
+          {"groups", static_cast<double>(group_ids.size())},
+          {"group_size", kGroupSize}},
+         {{"ns_per_event", static_cast<double>(elapsed) /
+                               static_cast<double>(events_per_thread)},
+          {"mismatches", static_cast<double>(mismatches)}}});
+  }
+
+  // Baseline: recount every group of the changed service on each event.
+  std::vector<std::vector<std::size_t>> service_groups(kServiceCount);
+  std::vector<std::vector<std::size_t>> group_members(kGroupCount);
+  for (std::size_t group_index{0}; group_index < kGroupCount; ++group_index) {
+    for (std::size_t member_index{0}; member_index < kGroupSize;
+         ++member_index) {
+      const auto service_index{group_member(group_index, member_index)};
+      service_groups[service_index].push_back(group_index);
+      group_members[group_index].push_back(service_index);
+    }
+  }
+  std::vector<DWORD> states(kServiceCount, 0);
+  std::vector<std::uint32_t> running_counts(kGroupCount, 0);
+  const auto baseline_events{std::max<std::size_t>(events_per_thread / 10, 1)};
+  const auto start{MonotonicNanoseconds()};
+  for (std::size_t event{0}; event < baseline_events; ++event) {
+    const auto service_index{event % kServiceCount};
+    states[service_index] = event_state(event);
+    for (const auto group_index : service_groups[service_index]) {
+      std::uint32_t running{0};
+      for (const auto member : group_members[group_index]) {
+        running += states[member] == SERVICE_NOTIFY_RUNNING;
+      }
+      running_counts[group_index] = running;
+    }
+  }
+  const auto elapsed{MonotonicNanoseconds() - start};
+  results.push_back(
+      {"service_groups_recount",
+       {{"threads", 1},
+        {"services", kServiceCount},
+        {"groups", kGroupCount},
+        {"group_size", kGroupSize}},
+       {{"ns_per_event",
+         static_cast<double>(elapsed) / static_cast<double>(baseline_events)},
+        {"running_in_group_0", static_cast<double>(running_counts[0])}}});
+}
+
+// Event correlation: 1000 services, 100 patterns of "5 of these 10 services
+// stopped within 1s"; a flapping storm at 100k transitions/s (synthetic
+// timestamps). ns per transition, incidents emitted, and the largest pattern
+// window seen (bounded by the window, not by the number of transitions).
+void BenchmarkEventCorrelation(std::vector<BenchmarkResult> &results,
+                               const std::size_t transitions) {
+  constexpr std::uint32_t kServiceCount{1000};
+  constexpr std::uint32_t kPatternCount{100};
+  constexpr std::uint32_t kTermCount{10};
+  constexpr std::int64_t kIntervalNanoseconds{10000}; // (100k/s)
+
+  std::uint64_t incidents{0};
+  EventCorrelator event_correlator;
+  for (std::uint32_t pattern_id{0}; pattern_id < kPatternCount; ++pattern_id) {
+    std::vector<CorrelationTerm> terms;
+    for (std::uint32_t term{0}; term < kTermCount; ++term) {
+      terms.push_back({pattern_id * kTermCount + term, SERVICE_NOTIFY_STOPPED});
+    }
+    event_correlator.AddPattern(terms, std::chrono::seconds(1), 5,
+                                [&incidents](const CorrelatedIncident &) {
+                                  ++incidents;
+                                });
+  }
+  event_correlator.Build();
+
+  std::vector<DWORD> states(kServiceCount, SERVICE_NOTIFY_RUNNING);
+  std::size_t largest_window{0};
+  std::int64_t update_time{0};
+  for (std::size_t index{0}; index < transitions; ++index) {
+    const auto service_id{static_cast<std::uint32_t>(index * 7919 %
+                                                     kServiceCount)};
+    states[service_id] = states[service_id] == SERVICE_NOTIFY_RUNNING
+                             ? SERVICE_NOTIFY_STOPPED
+                             : SERVICE_NOTIFY_RUNNING;
+    const auto start{MonotonicNanoseconds()};
+    event_correlator.Update(service_id, states[service_id],
+                            static_cast<std::int64_t>(index) *
+                                kIntervalNanoseconds);
+    update_time += MonotonicNanoseconds() - start;
+
+    if (index % 10000 == 0) {
+      for (std::uint32_t pattern_id{0}; pattern_id < kPatternCount;
+           ++pattern_id) {
+        largest_window = std::max(largest_window,
+                                  event_correlator.WindowSize(pattern_id));
+      }
+    }
+  }
+
+  results.push_back(
+      {"event_correlation",
+       {{"services", kServiceCount},
+        {"patterns", kPatternCount},
+        {"terms_per_pattern", kTermCount},
+        {"transitions_per_second", 1e9 / kIntervalNanoseconds}},
+       {{"ns_per_transition",
+         static_cast<double>(update_time) / static_cast<double>(transitions)},
+        {"incidents", static_cast<double>(incidents)},
+        {"largest_window", static_cast<double>(largest_window)}}});
+}
+
+// Dependency cascade: a base service, 100 services depending on it and 400
+// depending on those; each round stops all 501 in dependency order, then
+// starts them again. Per mode (no tracking, root tagging, tagging with
+// suppression): stop alerts delivered per cascade, how many named the base
+// service as their root, suppressed stops, and ns per notification.
+void BenchmarkDependencyCascade(std::vector<BenchmarkResult> &results,
+                                const std::size_t rounds) {
+  constexpr std::size_t kFirstLevel{100};
+  constexpr std::size_t kSecondLevel{400};
+  constexpr std::size_t kServiceCount{1 + kFirstLevel + kSecondLevel};
+
+  const auto service_names{ServiceNames(kServiceCount)};
+  std::unordered_map<std::wstring, std::vector<std::wstring>> dependencies;
+  for (std::size_t index{1}; index < kServiceCount; ++index) {
+    dependencies[service_names[index]].push_back(
+        index <= kFirstLevel ? service_names[0]
+                             : service_names[1 + (index - 1) % kFirstLevel]);
+  }
+  SyntheticServiceControl::SetDependencies(dependencies);
+
+  enum class Mode { kOff, kTag, kSuppress };
+  for (const Mode mode : {Mode::kOff, Mode::kTag, Mode::kSuppress}) {
+    std::atomic<std::uint64_t> stop_alerts{0};
+    std::atomic<std::uint64_t> tagged{0};
+    ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+    if (mode != Mode::kOff) {
+      notifier.EnableDependencyTracking(
+          {std::chrono::milliseconds(5000), mode == Mode::kSuppress});
+    }
+    notifier.Start(
+        service_names, kNotifyMask,
+        [&](const std::wstring &, const DWORD current_state,
+            const ServiceStatusChangedNotifier::NotificationDetails
+                &notification_details) {
+          if (current_state == SERVICE_NOTIFY_STOPPED) {
+            stop_alerts.fetch_add(1, std::memory_order_relaxed);
+            if (notification_details.root_service &&
+                *notification_details.root_service == service_names[0]) {
+              tagged.fetch_add(1, std::memory_order_relaxed);
+            }
+          }
+        });
+
+    // (Subscriptions come in no particular order: fire by service index.)
+    std::unordered_map<std::wstring, SyntheticServiceControl::Subscription>
+        by_name;
+    for (const auto &subscription : SyntheticServiceControl::Subscriptions()) {
+      by_name.emplace(subscription.ServiceName(), subscription);
+    }
+    std::vector<SyntheticServiceControl::Subscription> subscriptions;
+    for (const auto &service_name : service_names) {
+      subscriptions.push_back(by_name.at(service_name));
+    }
+
+    const auto start{MonotonicNanoseconds()};
+    for (std::size_t round{0}; round < rounds; ++round) {
+      for (const auto &subscription : subscriptions) {
+        subscription.Fire(SERVICE_NOTIFY_STOPPED);
+      }
+      for (const auto &subscription : subscriptions) {
+        subscription.Fire(SERVICE_NOTIFY_RUNNING);
+      }
+    }
+    const auto elapsed{MonotonicNanoseconds() - start};
+    notifier.Stop();
+
+    const char *const mode_names[]{"off", "tag", "suppress"};
+    results.push_back(
+        {std::string("dependency_cascade_") +
+             mode_names[static_cast<std::size_t>(mode)],
+         {{"services", kServiceCount}, {"rounds", static_cast<double>(rounds)}},
+         {{"stop_alerts_per_cascade",
+           static_cast<double>(stop_alerts.load()) /
+               static_cast<double>(rounds)},
+          {"tagged_with_base_per_cascade",
+           static_cast<double>(tagged.load()) / static_cast<double>(rounds)},
+          {"suppressed_per_cascade",
+           static_cast<double>(notifier.GetTotalCounters().suppressed) /
+               static_cast<double>(rounds)},
+          {"ns_per_event",
+           static_cast<double>(elapsed) /
+               static_cast<double>(rounds * kServiceCount * 2)}}});
+  }
+
+  SyntheticServiceControl::SetDependencies({});
+}
+
+// SimulatedServiceManager
+// Services that take a fixed (per service) time to start; the first
+// attempts of some of them fail. A start while a dependency is not running
+// counts as an ordering violation.
+class SimulatedServiceManager final {
+public:
+  SimulatedServiceManager(const ServiceDependencyGraph &graph,
+                          std::vector<std::chrono::microseconds> latencies,
+                          std::vector<std::uint32_t> failing_attempts)
+      : graph_{graph}, latencies_{std::move(latencies)},
+        failing_attempts_{std::move(failing_attempts)},
+        running_(graph.ServiceCount()) {}
+
+  bool StartService(const std::uint32_t service_id) {
+    for (const auto dependency : graph_.Dependencies(service_id)) {
+      if (!running_[dependency].load(std::memory_order_acquire)) {
+        ordering_violations_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    std::this_thread::sleep_for(latencies_[service_id]);
+    {
+      const std::scoped_lock lock(mutex_);
+      if (failing_attempts_[service_id] != 0) {
+        --failing_attempts_[service_id];
+        return false;
+      }
+    }
+    running_[service_id].store(true, std::memory_order_release);
+    return true;
+  }
+
+  [[nodiscard]] std::uint64_t OrderingViolations() const noexcept {
+    return ordering_violations_.load();
+  }
+
+private:
+  const ServiceDependencyGraph &graph_;
+  const std::vector<std::chrono::microseconds> latencies_;
+  std::mutex mutex_{};
+  std::vector<std::uint32_t> failing_attempts_; // (Guarded by mutex_)
+  std::vector<std::atomic<bool>> running_;
+  std::atomic<std::uint64_t> ordering_violations_{0};
+};
+
+// Remediation: 200 failed services in four levels (8 / 32 / 64 / 96, each
+// depending on two services of the level above), starting in 1 to 4ms; every
+// 16th service fails its first attempt. Per concurrency: makespan versus the
+// critical path (the lower bound), attempts, and ordering violations
+// (expected to be 0).
+void BenchmarkRemediation(std::vector<BenchmarkResult> &results,
+                          const std::size_t rounds) {
+  constexpr std::uint32_t kLevels[]{8, 32, 64, 96};
+  constexpr std::uint32_t kServiceCount{8 + 32 + 64 + 96};
+
+  std::vector<ServiceDependency> dependencies;
+  std::vector<std::chrono::microseconds> latencies;
+  std::vector<std::uint32_t> failing_attempts;
+  std::uint32_t level_start{0};
+  for (std::size_t level{0}; level < std::size(kLevels); ++level) {
+    for (std::uint32_t index{0}; index < kLevels[level]; ++index) {
+      const auto service_id{level_start + index};
+      if (level != 0) {
+        const auto parent_start{level_start - kLevels[level - 1]};
+        dependencies.push_back(
+            {service_id, parent_start + index % kLevels[level - 1]});
+        dependencies.push_back(
+            {service_id, parent_start + index * 7 % kLevels[level - 1]});
+      }
+      latencies.emplace_back(1000 + service_id * 7919 % 3000);
+      failing_attempts.push_back(service_id % 16 == 5 ? 1 : 0);
+    }
+    level_start += kLevels[level];
+  }
+  ServiceDependencyGraph graph;
+  graph.Build(kServiceCount, dependencies);
+
+  // (Critical path: the longest chain of start latencies, plus one retry
+  // for the failing services on it.)
+  const RemediationOptions base_options{1, 5, std::chrono::milliseconds(1),
+                                        std::chrono::milliseconds(8)};
+  std::vector<std::int64_t> finish(kServiceCount, 0); // (Microseconds)
+  std::int64_t critical_path{0};
+  for (const auto service_id : graph.TopologicalOrder()) {
+    std::int64_t start{0};
+    for (const auto dependency : graph.Dependencies(service_id)) {
+      start = std::max(start, finish[dependency]);
+    }
+    const auto latency{latencies[service_id].count()};
+    finish[service_id] =
+        start + latency +
+        failing_attempts[service_id] *
+            (latency + std::chrono::microseconds(base_options.initial_backoff)
+                           .count());
+    critical_path = std::max(critical_path, finish[service_id]);
+  }
+
+  std::vector<std::uint32_t> failed_services(kServiceCount);
+  for (std::uint32_t service_id{0}; service_id < kServiceCount; ++service_id) {
+    failed_services[service_id] = service_id;
+  }
+
+  for (const std::size_t concurrency : {1, 8, 32}) {
+    std::int64_t elapsed{0};
+    std::size_t attempts{0};
+    std::size_t restarted{0};
+    std::uint64_t ordering_violations{0};
+    for (std::size_t round{0}; round < rounds; ++round) {
+      SimulatedServiceManager service_manager(graph, latencies,
+                                              failing_attempts);
+      RemediationOptions options{base_options};
+      options.max_concurrency = concurrency;
+      const RemediationScheduler remediation_scheduler(
+          [&service_manager](const std::uint32_t service_id) {
+            return service_manager.StartService(service_id);
+          },
+          options);
+
+      const auto start{MonotonicNanoseconds()};
+      const auto result{remediation_scheduler.Run(graph, failed_services)};
+      elapsed += MonotonicNanoseconds() - start;
+      attempts += result.attempts;
+      restarted += result.restarted.size();
+      ordering_violations += service_manager.OrderingViolations();
+    }
+
+    results.push_back(
+        {"remediation",
+         {{"services", kServiceCount},
+          {"max_concurrency", static_cast<double>(concurrency)},
+          {"rounds", static_cast<double>(rounds)}},
+         {{"makespan_ms", static_cast<double>(elapsed) /
+                              static_cast<double>(rounds) / 1e6},
+          {"critical_path_ms", static_cast<double>(critical_path) / 1e3},
+          {"restarted", static_cast<double>(restarted) /
+                            static_cast<double>(rounds)},
+          {"attempts", static_cast<double>(attempts) /
+                           static_cast<double>(rounds)},
+          {"ordering_violations", static_cast<double>(ordering_violations)}}});
+  }
+}
+
+// Restart storm: 'service_count' services each stop three times in quick
+// succession; every stop submits a restart from the action callback to a
+// RestartGovernor (per service: 1 at once, then 2/s; global: 100 at once,
+// then 2000/s). Restarts run at once or deferred, none dropped. Reports the
+// restarts that ran at once / deferred, the peak restarts per 100ms (bounded
+// by 100 + 200), the deferral delay, and the time to drain the storm.
+void BenchmarkRestartStorm(std::vector<BenchmarkResult> &results,
+                           const std::size_t service_count) {
+  constexpr std::size_t kStopsPerService{3};
+  constexpr std::int64_t kWindowNanoseconds{100'000'000};
+
+  RestartGovernor restart_governor;
+  restart_governor.Start(service_count, {{2.0, 1}, {2000.0, 100}});
+
+  std::mutex restart_times_mutex;
+  std::vector<std::int64_t> restart_times;
+  restart_times.reserve(service_count * kStopsPerService);
+  const auto restart = [&] {
+    const auto now{MonotonicNanoseconds()};
+    const std::scoped_lock lock(restart_times_mutex);
+    restart_times.push_back(now);
+  };
+
+  const auto service_names{ServiceNames(service_count)};
+  ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+  notifier.Start(
+      service_names, kNotifyMask,
+      [&](const std::wstring &, const DWORD current_state,
+          const ServiceStatusChangedNotifier::NotificationDetails
+              &notification_details) {
+        if (current_state == SERVICE_NOTIFY_STOPPED) {
+          restart_governor.Submit(notification_details.service_id, restart);
+        }
+      });
+  const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+
+  const auto start{MonotonicNanoseconds()};
+  for (std::size_t stop{0}; stop < kStopsPerService; ++stop) {
+    for (const auto &subscription : subscriptions) {
+      subscription.Fire(SERVICE_NOTIFY_STOPPED);
+      subscription.Fire(SERVICE_NOTIFY_RUNNING);
+    }
+  }
+  const auto storm_time{MonotonicNanoseconds() - start};
+  while (restart_governor.GetStatistics().pending != 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  const auto drain_time{MonotonicNanoseconds() - start};
+  notifier.Stop();
+  restart_governor.Stop();
+
+  std::size_t peak_per_window{0};
+  std::ranges::sort(restart_times);
+  for (std::size_t first{0}, last{0}; last < restart_times.size(); ++last) {
+    while (restart_times[last] - restart_times[first] >= kWindowNanoseconds) {
+      ++first;
+    }
+    peak_per_window = std::max(peak_per_window, last - first + 1);
+  }
+
+  const auto statistics{restart_governor.GetStatistics()};
+  results.push_back(
+      {"restart_storm",
+       {{"services", static_cast<double>(service_count)},
+        {"stops_per_service", kStopsPerService}},
+       {{"restarts", static_cast<double>(restart_times.size())},
+        {"immediate", static_cast<double>(statistics.immediate)},
+        {"deferred", static_cast<double>(statistics.deferred)},
+        {"peak_restarts_per_100ms", static_cast<double>(peak_per_window)},
+        {"deferral_delay_p50_ms",
+         static_cast<double>(
+             statistics.deferral_delay.ValueAtPercentile(50.0)) /
+             1e6},
+        {"deferral_delay_p99_ms",
+         static_cast<double>(
+             statistics.deferral_delay.ValueAtPercentile(99.0)) /
+             1e6},
+        {"storm_ms", static_cast<double>(storm_time) / 1e6},
+        {"drain_ms", static_cast<double>(drain_time) / 1e6}}});
+}
+
+// Speculative preparation: 16 services enter STOP_PENDING at once; 20ms
+// later 8 of them reach STOPPED and 8 return to RUNNING. The STOPPED action
+// needs 30ms of expensive work (a dump, say) plus 1ms to finish. Without
+// preparation the action does it all; with it, the work starts on entry to
+// STOP_PENDING and the action only waits for what is left. Reports the
+// mean time from STOPPED to the end of its action, and how many
+// preparations were used and cancelled.
+void BenchmarkSpeculativePreparation(std::vector<BenchmarkResult> &results,
+                                     const std::size_t rounds) {
+  constexpr std::size_t kServiceCount{16};
+  constexpr auto kPendingPhase{std::chrono::milliseconds(20)};
+  constexpr auto kExpensiveWork{std::chrono::milliseconds(30)};
+  constexpr auto kFinishWork{std::chrono::milliseconds(1)};
+
+  // (Sleeps in 1ms steps; returns false if stopped first.)
+  const auto work = [](const std::chrono::milliseconds duration,
+                       const std::stop_token &stop_token) {
+    for (auto elapsed{std::chrono::milliseconds(0)}; elapsed < duration;
+         ++elapsed) {
+      if (stop_token.stop_requested()) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  };
+
+  const auto service_names{ServiceNames(kServiceCount)};
+  for (const bool prepare : {false, true}) {
+    ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+    if (prepare) {
+      notifier.EnableActionPreparation(
+          [&work](const std::wstring &, std::uint32_t,
+                  const std::stop_token stop_token) -> std::shared_ptr<void> {
+            return work(kExpensiveWork, stop_token)
+                       ? std::make_shared<bool>(true)
+                       : nullptr;
+          },
+          {SERVICE_NOTIFY_STOP_PENDING, kServiceCount});
+    }
+    notifier.Start(
+        service_names, kNotifyMask,
+        [&work](const std::wstring &, const DWORD current_state,
+                const ServiceStatusChangedNotifier::NotificationDetails
+                    &notification_details) {
+          if (current_state == SERVICE_NOTIFY_STOPPED) {
+            if (!notification_details.prepared) {
+              work(kExpensiveWork, {});
+            }
+            work(kFinishWork, {});
+          }
+        });
+    const auto subscriptions{SyntheticServiceControl::Subscriptions()};
+
+    std::int64_t remediation_time{0};
+    std::size_t remediations{0};
+    for (std::size_t round{0}; round < rounds; ++round) {
+      for (const auto &subscription : subscriptions) {
+        subscription.Fire(SERVICE_NOTIFY_STOP_PENDING);
+      }
+      std::this_thread::sleep_for(kPendingPhase);
+      for (std::size_t index{0}; index < subscriptions.size(); ++index) {
+        if (index % 2 == 0) {
+          const auto start{MonotonicNanoseconds()};
+          subscriptions[index].Fire(SERVICE_NOTIFY_STOPPED); // (Inline)
+          remediation_time += MonotonicNanoseconds() - start;
+          ++remediations;
+        } else {
+          subscriptions[index].Fire(SERVICE_NOTIFY_RUNNING);
+        }
+      }
+      for (std::size_t index{0}; index < subscriptions.size(); index += 2) {
+        subscriptions[index].Fire(SERVICE_NOTIFY_RUNNING);
+      }
+    }
+    notifier.Stop();
+
+    const auto statistics{notifier.GetPreparationStatistics()};
+    results.push_back(
+        {prepare ? "speculative_preparation_on" : "speculative_preparation_off",
+         {{"services", kServiceCount},
+          {"rounds", static_cast<double>(rounds)},
+          {"pending_phase_ms", static_cast<double>(kPendingPhase.count())},
+          {"expensive_work_ms", static_cast<double>(kExpensiveWork.count())}},
+         {{"time_to_remediation_ms",
+           static_cast<double>(remediation_time) /
+               static_cast<double>(remediations) / 1e6},
+          {"preparations_started", static_cast<double>(statistics.started)},
+          {"preparations_used", static_cast<double>(statistics.used)},
+          {"preparations_cancelled",
+           static_cast<double>(statistics.cancelled)}}});
+  }
+}
+
+// Deadline scheduling: 32 "relaxed" services (1s action deadline) stop, then
+// 32 "urgent" ones (10ms deadline); 4 workers run 1ms actions, so the last
+// action ends about 16ms later. Per scheduling policy: the urgent actions
+// that overran their deadline (FIFO serves the relaxed ones first; EDF the
+// urgent ones), as counted by the ActionWatchdog, and how long after a
+// deadline the watchdog reported it.
+void BenchmarkDeadlineScheduling(std::vector<BenchmarkResult> &results,
+                                 const std::size_t rounds) {
+  constexpr std::size_t kServiceCount{32}; // (Of each kind)
+  constexpr auto kUrgentDeadline{std::chrono::milliseconds(10)};
+  constexpr auto kRelaxedDeadline{std::chrono::milliseconds(1000)};
+
+  std::vector<std::wstring> urgent_names;
+  std::vector<std::wstring> relaxed_names;
+  for (std::size_t index{0}; index < kServiceCount; ++index) {
+    urgent_names.push_back(L"UrgentService" + std::to_wstring(index));
+    relaxed_names.push_back(L"RelaxedService" + std::to_wstring(index));
+  }
+
+  for (const auto scheduling_policy :
+       {SchedulingPolicy::kPriority, SchedulingPolicy::kEarliestDeadline}) {
+    std::atomic<std::size_t> completed{0};
+    std::mutex detection_mutex;
+    std::vector<std::int64_t> detection_lags;
+
+    ServiceStatusChangedNotifier notifier(SyntheticServiceControl::Api());
+    notifier.EnableActionWatchdog(
+        [&detection_mutex,
+         &detection_lags](const std::wstring &, DWORD,
+                          const WatchedAction &watched_action) {
+          const auto lag{MonotonicNanoseconds() - watched_action.deadline};
+          const std::scoped_lock lock(detection_mutex);
+          detection_lags.push_back(lag);
+        });
+    const auto action = [&completed](const std::wstring &, DWORD) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      completed.fetch_add(1);
+      completed.notify_all();
+    };
+    DispatchOptions dispatch_options{4};
+    dispatch_options.scheduling_policy = scheduling_policy;
+    dispatch_options.action_deadline = kRelaxedDeadline;
+    notifier.Start(relaxed_names, kNotifyMask, action, dispatch_options);
+    dispatch_options.action_deadline = kUrgentDeadline;
+    notifier.Start(urgent_names, kNotifyMask, action, dispatch_options);
+
+    std::vector<SyntheticServiceControl::Subscription> subscriptions;
+    for (const auto &subscription : SyntheticServiceControl::Subscriptions()) {
+      if (std::wstring_view(subscription.ServiceName())
+              .starts_with(L"Relaxed")) {
+        subscriptions.insert(subscriptions.begin(), subscription); // (First)
+      } else {
+        subscriptions.push_back(subscription);
+      }
+    }
+
+    for (std::size_t round{0}; round < rounds; ++round) {
+      for (const auto &subscription : subscriptions) {
+        subscription.Fire(SERVICE_NOTIFY_STOPPED);
+      }
+      const auto expected{(round + 1) * subscriptions.size()};
+      for (auto done{completed.load()}; done < expected;
+           done = completed.load()) {
+        completed.wait(done);
+      }
+    }
+    notifier.Stop();
+
+    std::uint64_t urgent_overruns{0};
+    for (const auto &service_name : urgent_names) {
+      urgent_overruns += notifier.GetServiceCounters(service_name)->overruns;
+    }
+    std::ranges::sort(detection_lags);
+    const auto statistics{notifier.GetWatchdogStatistics()};
+    results.push_back(
+        {scheduling_policy == SchedulingPolicy::kEarliestDeadline
+             ? "deadline_scheduling_edf"
+             : "deadline_scheduling_fifo",
+         {{"services", 2 * kServiceCount},
+          {"workers", 4},
+          {"rounds", static_cast<double>(rounds)},
+          {"urgent_deadline_ms", static_cast<double>(kUrgentDeadline.count())}},
+         {{"urgent_actions", static_cast<double>(rounds * kServiceCount)},
+          {"urgent_overruns", static_cast<double>(urgent_overruns)},
+          {"total_overruns",
+           static_cast<double>(notifier.GetTotalCounters().overruns)},
+          {"watched", static_cast<double>(statistics.watched)},
+          {"detection_lag_p50_us",
+           detection_lags.empty()
+               ? 0.0
+               : static_cast<double>(
+                     detection_lags[detection_lags.size() / 2]) /
+                     1e3},
+          {"overrun_time_p50_us",
+           static_cast<double>(
+               statistics.overrun_time.ValueAtPercentile(50.0)) /
+               1e3}}});
+  }
+}
+
+#if defined(__linux__)
+
+// /proc scan cost: a synthetic process table (ProcessScanOptions::proc_path)
+// of 20k PIDs, 10 of them of watched names, while other processes start and
+// exit every 20ms (a busy host). Reports the scanner's CPU time per scan, as
+// a share of one core over the run and at the interval it settled on (only
+// churn among the watched processes shortens it).
+void BenchmarkProcessScan(std::vector<BenchmarkResult> &results,
+                          const std::chrono::milliseconds duration) {
+  constexpr std::size_t kProcessCount{20000};
+  constexpr std::size_t kWatchedCount{10};
+  constexpr int kFirstPid{1000};
+
+  const auto proc_path{std::filesystem::temp_directory_path() /
+                       ("sscn-proc-" + std::to_string(getpid()))};
+  const auto add_process = [&proc_path](const int pid,
+                                        const std::string &comm) {
+    std::filesystem::create_directories(proc_path / std::to_string(pid));
+    std::ofstream(proc_path / std::to_string(pid) / "comm") << comm << '\n';
+  };
+  std::vector<std::string> service_names;
+  for (std::size_t index{0}; index < kProcessCount; ++index) {
+    const auto pid{kFirstPid + static_cast<int>(index)};
+    if (index % (kProcessCount / kWatchedCount) == 0) {
+      service_names.push_back("watched" + std::to_string(index));
+      add_process(pid, service_names.back());
+    } else {
+      add_process(pid, "worker");
+    }
+  }
+
+  ProcessScanOptions options;
+  options.proc_path = proc_path.string();
+  ProcessScanNotifier process_scan_notifier;
+  process_scan_notifier.Start(service_names, SERVICE_NOTIFY_RUNNING |
+                                                 SERVICE_NOTIFY_STOPPED,
+                              [](const std::string &, std::uint32_t) {},
+                              options);
+
+  // (Unwatched churn: one process exits and another starts every 20ms.)
+  const auto start{MonotonicNanoseconds()};
+  int next_pid{kFirstPid + static_cast<int>(kProcessCount)};
+  for (int exiting_pid{kFirstPid + 1};
+       MonotonicNanoseconds() - start <
+       std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+       ++exiting_pid) {
+    if ((exiting_pid - kFirstPid) %
+            static_cast<int>(kProcessCount / kWatchedCount) !=
+        0) {
+      std::filesystem::remove_all(proc_path / std::to_string(exiting_pid));
+    }
+    add_process(next_pid++, "worker");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  const auto elapsed{MonotonicNanoseconds() - start};
+  const auto statistics{process_scan_notifier.GetStatistics()};
+  process_scan_notifier.Stop();
+  std::filesystem::remove_all(proc_path);
+
+  results.push_back(
+      {"process_scan",
+       {{"processes", kProcessCount},
+        {"watched", kWatchedCount},
+        {"churn_per_second", 50}},
+       {{"scans", static_cast<double>(statistics.scans)},
+        {"cpu_per_scan_us",
+         statistics.scans == 0
+             ? 0.0
+             : static_cast<double>(statistics.scan_cpu_time) /
+                   static_cast<double>(statistics.scans) / 1e3},
+        {"cpu_percent_of_core", static_cast<double>(statistics.scan_cpu_time) /
+                                    static_cast<double>(elapsed) * 100.0},
+        {"final_interval_ms",
+         static_cast<double>(statistics.interval.count())},
+        {"steady_cpu_percent_of_core",
+         statistics.scans == 0 || statistics.interval.count() == 0
+             ? 0.0
+             : static_cast<double>(statistics.scan_cpu_time) /
+                   static_cast<double>(statistics.scans) /
+                   (static_cast<double>(statistics.interval.count()) * 1e6) *
+                   100.0}}});
+}
+
+#endif
+
+// Action worker (--action-worker): answers each "<id> TAB <state> TAB <name>"
+// line with "<id> TAB 0", flushing once its input is drained (so a batch is
+// answered with one write). The service names "crash" and "hang" make it
+// exit without answering, or stop answering.
+int RunActionWorker() {
+  std::ios::sync_with_stdio(false);
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    const auto name{line.substr(line.rfind('\t') + 1)};
+    if (name == "crash") {
+      std::_Exit(3);
+    }
+    if (name == "hang") {
+      std::this_thread::sleep_for(std::chrono::hours(1));
+    }
+    std::cout << line.substr(0, line.find('\t')) << "\t0\n";
+    if (std::cin.rdbuf()->in_avail() == 0) {
+      std::cout.flush();
+    }
+  }
+  return 0;
+}
+
+// Action executor: 'action_count' no-op actions through a pool of 4
+// pre-started workers fed batches of 32, versus a fresh process per action
+// (batch 1, recycled after every action). Then the pool with one action in
+// 100 crashing its worker, or (one in 500) hanging it, with action_timeout
+// 200ms: only those actions fail, the rest of their batches run again on a
+// restarted worker. Reports throughput, per-action latency and outcomes.
+void BenchmarkActionExecutor(std::vector<BenchmarkResult> &results,
+                             const char *const executable,
+                             const std::size_t action_count) {
+  struct Scenario {
+    const char *name;
+    std::size_t batch_size;
+    std::size_t max_actions_per_worker;
+    std::size_t action_count;
+    bool faults;
+  };
+  const Scenario scenarios[]{
+      {"action_executor_pooled", 32, 0, action_count, false},
+      {"action_executor_spawn_per_event", 1, 1, action_count / 20, false},
+      {"action_executor_faults", 32, 0, action_count, true}};
+
+  for (const auto &scenario : scenarios) {
+    ActionExecutorOptions options;
+    options.command = {executable, "--action-worker"};
+    options.worker_count = 4;
+    options.batch_size = scenario.batch_size;
+    options.max_actions_per_worker = scenario.max_actions_per_worker;
+    if (scenario.faults) {
+      options.action_timeout = std::chrono::milliseconds(200);
+    }
+
+    std::atomic<std::size_t> completed{0};
+    ActionExecutor action_executor;
+    if (!action_executor.Start(options, [&completed](const ActionResult &) {
+          completed.fetch_add(1);
+          completed.notify_all();
+        })) {
+      std::cerr << "Cannot start " << executable << " --action-worker\n";
+      return;
+    }
+
+    const auto start{MonotonicNanoseconds()};
+    for (std::size_t index{0}; index < scenario.action_count; ++index) {
+      std::string name{"SyntheticService" + std::to_string(index)};
+      if (scenario.faults && index % 100 == 50) {
+        name = index % 1000 == 450 || index % 1000 == 950 ? "hang" : "crash";
+      }
+      action_executor.Submit(name, SERVICE_NOTIFY_STOPPED);
+    }
+    for (auto done{completed.load()}; done < scenario.action_count;
+         done = completed.load()) {
+      completed.wait(done);
+    }
+    const auto elapsed{MonotonicNanoseconds() - start};
+    action_executor.Stop();
+
+    const auto statistics{action_executor.GetStatistics()};
+    const auto outcome = [&statistics](const ActionOutcome action_outcome) {
+      return static_cast<double>(
+          statistics.outcomes[static_cast<std::size_t>(action_outcome)]);
+    };
+    results.push_back(
+        {scenario.name,
+         {{"actions", static_cast<double>(scenario.action_count)},
+          {"workers", static_cast<double>(options.worker_count)},
+          {"batch_size", static_cast<double>(options.batch_size)}},
+         {{"actions_per_second", static_cast<double>(scenario.action_count) /
+                                     (static_cast<double>(elapsed) / 1e9)},
+          {"latency_p50_us",
+           static_cast<double>(statistics.latency.ValueAtPercentile(50.0)) /
+               1e3},
+          {"latency_p99_us",
+           static_cast<double>(statistics.latency.ValueAtPercentile(99.0)) /
+               1e3},
+          {"succeeded", outcome(ActionOutcome::kSucceeded)},
+          {"crashed", outcome(ActionOutcome::kCrashed)},
+          {"timed_out", outcome(ActionOutcome::kTimedOut)},
+          {"worker_starts", static_cast<double>(statistics.worker_starts)},
+          {"batches", static_cast<double>(statistics.batches)}}});
+  }
+}
+
+// Counter contention: 64 threads, each updating "its" service's counter.
+// Packed (adjacent atomics, shared cache lines) versus ServiceCounters (one
+// cache line per service); a single global atomic versus ShardedCounter.
+void BenchmarkCounterContention(std::vector<BenchmarkResult> &results,
+                                const std::size_t increments) {
+  constexpr std::size_t kThreadCount{64};
+
+  const auto report = [&](const char *const variant,
+                          const std::int64_t elapsed) {
+    const auto operations{static_cast<double>(kThreadCount * increments)};
+    results.push_back(
+        {std::string("counter_contention_") + variant,
+         {{"threads", static_cast<double>(kThreadCount)},
+          {"increments_per_thread", static_cast<double>(increments)}},
+         {{"ns_per_increment", static_cast<double>(elapsed) *
+                                   static_cast<double>(kThreadCount) /
+                                   operations},
+          {"increments_per_second",
+           operations * 1e9 / static_cast<double>(elapsed)}}});
+  };
+
+  {
+    std::vector<std::atomic<std::uint64_t>> packed(kThreadCount);
+    report("per_service_packed",
+           RunOnThreads(kThreadCount, [&](const std::size_t thread_index) {
+             for (std::size_t index{0}; index < increments; ++index) {
+               packed[thread_index].fetch_add(1, std::memory_order_relaxed);
+             }
+           }));
+  }
+  {
+    const auto padded{std::make_unique<ServiceCounters[]>(kThreadCount)};
+    report("per_service_cache_line",
+           RunOnThreads(kThreadCount, [&](const std::size_t thread_index) {
+             for (std::size_t index{0}; index < increments; ++index) {
+               padded[thread_index].events.fetch_add(
+                   1, std::memory_order_relaxed);
+             }
+           }));
+  }
+  {
+    std::atomic<std::uint64_t> global{0};
+    report("total_single_atomic",
+           RunOnThreads(kThreadCount, [&](std::size_t) {
+             for (std::size_t index{0}; index < increments; ++index) {
+               global.fetch_add(1, std::memory_order_relaxed);
+             }
+           }));
+  }
+  {
+    ShardedCounter sharded;
+    report("total_sharded",
+           RunOnThreads(kThreadCount, [&](std::size_t) {
+             for (std::size_t index{0}; index < increments; ++index) {
+               sharded.Add();
+             }
+           }));
+  }
+}
+
+} // namespace
+
+// Global allocation functions, replaced for the memory benchmark.
+void *operator new(const std::size_t size) {
+  return CountedAllocate(size, alignof(std::max_align_t));
+}
+void *operator new[](const std::size_t size) {
+  return CountedAllocate(size, alignof(std::max_align_t));
+}
+void *operator new(const std::size_t size, const std::align_val_t alignment) {
+  return CountedAllocate(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](const std::size_t size,
+                     const std::align_val_t alignment) {
+  return CountedAllocate(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *const pointer) noexcept { CountedFree(pointer); }
+void operator delete[](void *const pointer) noexcept { CountedFree(pointer); }
+void operator delete(void *const pointer, std::size_t) noexcept {
+  CountedFree(pointer);
+}
+void operator delete[](void *const pointer, std::size_t) noexcept {
+  CountedFree(pointer);
+}
+void operator delete(void *const pointer, std::align_val_t) noexcept {
+  CountedFree(pointer);
+}
+void operator delete[](void *const pointer, std::align_val_t) noexcept {
+  CountedFree(pointer);
+}
+void operator delete(void *const pointer, std::size_t,
+                     std::align_val_t) noexcept {
+  CountedFree(pointer);
+}
+void operator delete[](void *const pointer, std::size_t,
+                       std::align_val_t) noexcept {
+  CountedFree(pointer);
+}
+
+int main(const int argc, const char *const argv[]) {
+  if (argc > 1 && std::string_view(argv[1]) == "--action-worker") {
+    return RunActionWorker();
+  }
+  const bool quick{argc > 1 && std::string_view(argv[1]) == "--quick"};
+  const std::size_t scale{quick ? 10U : 1U};
+
+  std::vector<BenchmarkResult> results;
+  BenchmarkCallbackPath(results, 2'000'000 / scale);
+  BenchmarkSubscribeUnsubscribe(results, 100 / scale);
+  BenchmarkStartTime(results);
+  BenchmarkMemoryPerService(results);
+  BenchmarkThroughputVersusThreads(results, 4'000'000 / scale);
+  BenchmarkCounterContention(results, 1'000'000 / scale);
+  BenchmarkOrderingStress(results, 100'000 / scale);
+  BenchmarkDispatcherThroughput(results, 200'000 / scale);
+  BenchmarkPriorityStorm(results, 10 / scale);
+  BenchmarkBackpressureStorm(results, std::chrono::milliseconds(1000 / scale));
+  BenchmarkFlappingDedup(results, 1000 / scale);
+  BenchmarkBoundedFlapping(results, 100 / scale);
+  BenchmarkRuleEngine(results, 1'000'000 / scale);
+  BenchmarkServiceGroups(results, 1'000'000 / scale);
+  BenchmarkEventCorrelation(results, 1'000'000 / scale);
+  BenchmarkDependencyCascade(results, 1000 / scale);
+  BenchmarkRemediation(results, quick ? 1U : 3U);
+  BenchmarkRestartStorm(results, 2000 / scale);
+  BenchmarkSpeculativePreparation(results, 20 / scale);
+#if defined(__linux__)
+  BenchmarkProcessScan(results,
+                       std::chrono::milliseconds(quick ? 8000 : 20000));
+#endif
+  BenchmarkDeadlineScheduling(results, 100 / scale);
+  BenchmarkActionExecutor(results, argv[0], 20'000 / scale);
+
+  WriteJsonReport(std::cout, results, quick);
+}
@@ -0,0 +1,167 @@
+/*
+   CgroupEventsNotifierTest.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "CgroupEventsNotifier.h"
+#include "LinuxTest.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+
+namespace {
+
+constexpr std::uint32_t kNotifyMask{
+    SERVICE_NOTIFY_RUNNING | SERVICE_NOTIFY_STOPPED | SERVICE_NOTIFY_PAUSED};
+
+// SetEvents
+// Overwrites cgroup.events in place, as the kernel does (a truncating write
+// would expose an empty file, read as "not populated").
+void SetEvents(const std::string &cgroup, const bool populated,
+               const bool frozen) {
+  const std::string body{std::string("populated ") + (populated ? "1" : "0") +
+                         "\nfrozen " + (frozen ? "1" : "0") + "\n"};
+  const int fd{open((cgroup + "/cgroup.events").c_str(),
+                    O_WRONLY | O_CREAT | O_CLOEXEC, 0644)};
+  [[maybe_unused]] const auto written{
+      pwrite(fd, body.data(), body.size(), 0)};
+  close(fd);
+}
+
+// CreateCgroup
+// A cgroup directory with its cgroup.events, appearing at once (as mkdir on
+// cgroupfs does).
+void CreateCgroup(const std::string &cgroup, const bool populated) {
+  const auto staging{cgroup + ".new"};
+  std::filesystem::create_directory(staging);
+  SetEvents(staging, populated, false);
+  std::filesystem::rename(staging, cgroup);
+}
+
+// The cgroups are plain directories with a cgroup.events file.
+void TestStates() {
+  const TemporaryDirectory directory;
+  const std::string running{(directory.Path() / "running.service").string()};
+  const std::string frozen{(directory.Path() / "frozen.service").string()};
+  const std::string missing{(directory.Path() / "missing.service").string()};
+  CreateCgroup(running, true);
+  CreateCgroup(frozen, true);
+
+  NotificationLog log;
+  CgroupEventsNotifier notifier;
+  notifier.Start({running, frozen, missing}, kNotifyMask,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                 });
+
+  SetEvents(running, false, false);
+  SetEvents(frozen, true, true);
+  SSCN_CHECK(log.WaitFor(running, SERVICE_NOTIFY_STOPPED));
+  SSCN_CHECK(log.WaitFor(frozen, SERVICE_NOTIFY_PAUSED));
+
+  // (A rewrite with the same state is not a transition.)
+  SetEvents(frozen, true, true);
+  SetEvents(frozen, true, false);
+  SSCN_CHECK(log.WaitFor(frozen, SERVICE_NOTIFY_RUNNING));
+  notifier.Stop();
+
+  SSCN_CHECK(log.Count(running) == 1);
+  SSCN_CHECK(log.Count(frozen) == 2);
+  SSCN_CHECK(log.Count(missing) == 0);
+}
+
+// A removed cgroup reports STOPPED (its cgroup.events never says so); one
+// created again under the same path is watched again.
+void TestRemoval() {
+  const TemporaryDirectory directory;
+  const std::string cgroup{(directory.Path() / "removed.service").string()};
+  CreateCgroup(cgroup, true);
+
+  NotificationLog log;
+  CgroupEventsNotifier notifier;
+  notifier.Start({cgroup}, kNotifyMask,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                 });
+
+  std::filesystem::remove_all(cgroup);
+  SSCN_CHECK(log.WaitFor(cgroup, SERVICE_NOTIFY_STOPPED));
+
+  CreateCgroup(cgroup, true);
+  SSCN_CHECK(log.WaitFor(cgroup, SERVICE_NOTIFY_RUNNING));
+  SetEvents(cgroup, false, false);
+  SSCN_CHECK(log.WaitFor(cgroup, SERVICE_NOTIFY_STOPPED, 2));
+  notifier.Stop();
+  SSCN_CHECK(log.Count(cgroup) == 3);
+}
+
+// While the watcher thread is held in an action, more records are queued
+// than the inotify queue holds (fs.inotify.max_queued_events, 16384 by
+// default): the change of a cgroup with no record queued is lost with the
+// overflow, and found by the refresh of every cgroup that follows.
+void TestOverflow() {
+  const TemporaryDirectory directory;
+  const std::string blocker{(directory.Path() / "blocker.service").string()};
+  const std::string first{(directory.Path() / "first.service").string()};
+  const std::string second{(directory.Path() / "second.service").string()};
+  const std::string last{(directory.Path() / "last.service").string()};
+  for (const auto &cgroup : {blocker, first, second, last}) {
+    CreateCgroup(cgroup, true);
+  }
+
+  NotificationLog log;
+  std::atomic<bool> released{false};
+  CgroupEventsNotifier notifier;
+  notifier.Start({blocker, first, second, last}, kNotifyMask,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                   if (name == blocker) {
+                     released.wait(false); // (Holds the watcher thread)
+                   }
+                 });
+
+  SetEvents(blocker, false, false);
+  SSCN_CHECK(log.WaitFor(blocker, SERVICE_NOTIFY_STOPPED));
+  for (int index{0}; index < 20000; ++index) {
+    SetEvents(first, true, false); // (Alternating: records are not merged)
+    SetEvents(second, true, false);
+  }
+  SetEvents(last, false, false); // (No record queued for it: lost)
+  released = true;
+  released.notify_all();
+
+  SSCN_CHECK(log.WaitFor(last, SERVICE_NOTIFY_STOPPED));
+  notifier.Stop();
+  SSCN_CHECK(log.Count(first) == 0);
+  SSCN_CHECK(log.Count(second) == 0);
+}
+
+} // namespace
+
+int main() {
+  TestStates();
+  TestRemoval();
+  TestOverflow();
+  return TestResult();
+}
@@ -0,0 +1,175 @@
+#ifndef AMITG_FC_LINUX_TEST
+#define AMITG_FC_LINUX_TEST
+
+/*
+   LinuxTest.h
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The smoke tests of the Linux backends: plain executables (one per
+// backend, run by ctest) that exit with 0 when every check passed.
+
+// SSCN_CHECK
+// Reports a failed check and carries on (the test fails at exit).
+#define SSCN_CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+
+inline int &FailureCount() noexcept {
+  static int failure_count{0};
+  return failure_count;
+}
+
+inline bool Check(const bool passed, const char *const expression,
+                  const char *const file, const int line) noexcept {
+  if (!passed) {
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+    ++FailureCount();
+  }
+  return passed;
+}
+
+// The exit code of a test executable.
+inline int TestResult() noexcept {
+  if (FailureCount() != 0) {
+    std::fprintf(stderr, "%d check(s) failed\n", FailureCount());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// TemporaryDirectory
+// A fresh directory under the system temp path, removed with its contents.
+class TemporaryDirectory final {
+public:
+  TemporaryDirectory() {
+    std::string path{
+        (std::filesystem::temp_directory_path() / "sscn-test-XXXXXX").string()};
+    if (mkdtemp(path.data())) {
+      path_ = path;
+    }
+  }
+  ~TemporaryDirectory() { // (Non-default destructor)
+    std::error_code error_code;
+    std::filesystem::remove_all(path_, error_code);
+  }
+
+  // Since non-default destructor__
+
+  // Delete copy constructor and copy assignment operator
+  TemporaryDirectory(const TemporaryDirectory &) = delete;
+  TemporaryDirectory &operator=(const TemporaryDirectory &) = delete;
+
+  // Delete move constructor and move assignment operator
+  TemporaryDirectory(TemporaryDirectory &&) = delete;
+  TemporaryDirectory &operator=(TemporaryDirectory &&) = delete;
+
+  // __Since non-default destructor
+
+  [[nodiscard]] const std::filesystem::path &Path() const noexcept {
+    return path_;
+  }
+
+private:
+  std::filesystem::path path_{};
+};
+
+// WriteFile
+// Writes 'contents' to 'path' (replacing it in place).
+inline void WriteFile(const std::filesystem::path &path,
+                      const std::string_view contents) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+}
+
+// NotificationLog
+// Collects the notifications of a backend (its action function) and waits
+// for an expected one.
+class NotificationLog final {
+public:
+  NotificationLog() = default;
+  ~NotificationLog() = default;
+
+  // Delete copy constructor and copy assignment operator
+  NotificationLog(const NotificationLog &) = delete;
+  NotificationLog &operator=(const NotificationLog &) = delete;
+
+  // Delete move constructor and move assignment operator
+  NotificationLog(NotificationLog &&) = delete;
+  NotificationLog &operator=(NotificationLog &&) = delete;
+
+  // The action function (any thread).
+  void Add(const std::string &service_name, const std::uint32_t current_state) {
+    {
+      const std::scoped_lock lock(mutex_);
+      notifications_.emplace_back(service_name, current_state);
+    }
+    condition_.notify_all();
+  }
+
+  // Wait (up to 'timeout') until service_name was notified of current_state
+  // 'occurrences' times.
+  bool WaitFor(const std::string &service_name,
+               const std::uint32_t current_state,
+               const std::size_t occurrences = 1,
+               const std::chrono::milliseconds timeout =
+                   std::chrono::milliseconds(5000)) {
+    std::unique_lock lock(mutex_);
+    return condition_.wait_for(lock, timeout, [&] {
+      std::size_t count{0};
+      for (const auto &notification : notifications_) {
+        if (notification.first == service_name &&
+            notification.second == current_state) {
+          ++count;
+        }
+      }
+      return count >= occurrences;
+    });
+  }
+
+  // The number of notifications of service_name so far.
+  [[nodiscard]] std::size_t Count(const std::string &service_name) {
+    const std::scoped_lock lock(mutex_);
+    std::size_t count{0};
+    for (const auto &notification : notifications_) {
+      count += notification.first == service_name ? 1 : 0;
+    }
+    return count;
+  }
+
+private:
+  std::mutex mutex_{};
+  std::condition_variable condition_{};
+  std::vector<std::pair<std::string, std::uint32_t>> notifications_{};
+};
+
+#endif
@@ -0,0 +1,113 @@
+/*
+   ProcessLivenessNotifierTest.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "LinuxTest.h"
+#include "ProcessLivenessNotifier.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace {
+
+constexpr std::uint32_t kNotifyMask{SERVICE_NOTIFY_RUNNING |
+                                    SERVICE_NOTIFY_STOPPED};
+
+// SpawnChild
+// A child process that waits to be killed.
+pid_t SpawnChild() {
+  const pid_t pid{fork()};
+  if (pid == 0) {
+    for (;;) {
+      pause();
+    }
+  }
+  return pid;
+}
+
+void KillChild(const pid_t pid) {
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+}
+
+// A "pid:<n>" service reports its process' exit.
+void TestPidExit() {
+  const pid_t pid{SpawnChild()};
+  const std::string service_name{"pid:" + std::to_string(pid)};
+
+  NotificationLog log;
+  ProcessLivenessNotifier notifier;
+  notifier.Start({service_name}, kNotifyMask,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                 });
+
+  KillChild(pid);
+  SSCN_CHECK(log.WaitFor(service_name, SERVICE_NOTIFY_STOPPED));
+  notifier.Stop();
+  SSCN_CHECK(log.Count(service_name) == 1);
+}
+
+// A PID file service follows the process it names: exit, rewrite with a new
+// process, rewrite with a process that is already gone.
+void TestPidFile() {
+  const TemporaryDirectory directory;
+  const std::string pid_file{(directory.Path() / "service.pid").string()};
+
+  const pid_t first{SpawnChild()};
+  WriteFile(pid_file, std::to_string(first) + "\n");
+
+  NotificationLog log;
+  ProcessLivenessNotifier notifier;
+  notifier.Start({pid_file}, kNotifyMask,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                 });
+
+  KillChild(first);
+  SSCN_CHECK(log.WaitFor(pid_file, SERVICE_NOTIFY_STOPPED));
+
+  const pid_t second{SpawnChild()};
+  WriteFile(pid_file, std::to_string(second) + "\n");
+  SSCN_CHECK(log.WaitFor(pid_file, SERVICE_NOTIFY_RUNNING));
+
+  // (A PID file naming a dead process: the service is down.)
+  const pid_t gone{SpawnChild()};
+  KillChild(gone);
+  WriteFile(pid_file, std::to_string(gone) + "\n");
+  SSCN_CHECK(log.WaitFor(pid_file, SERVICE_NOTIFY_STOPPED, 2));
+  notifier.Stop();
+  SSCN_CHECK(log.Count(pid_file) == 3);
+
+  KillChild(second);
+}
+
+} // namespace
+
+int main() {
+  TestPidExit();
+  TestPidFile();
+  return TestResult();
+}
@@ -0,0 +1,87 @@
+/*
+   ProcessScanNotifierTest.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "LinuxTest.h"
+#include "ProcessScanNotifier.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+// AddProcess
+// A fake /proc/<pid> with its comm.
+void AddProcess(const std::filesystem::path &proc, const int pid,
+                const std::string &comm) {
+  const auto directory{proc / std::to_string(pid)};
+  std::filesystem::create_directory(directory);
+  WriteFile(directory / "comm", comm + "\n");
+}
+
+} // namespace
+
+// The scanner over a fake /proc (ProcessScanOptions::proc_path): a watched
+// process exits, another one of the same name starts later, and unwatched
+// processes come and go.
+int main() {
+  const TemporaryDirectory directory;
+  const auto proc{directory.Path() / "proc"};
+  std::filesystem::create_directory(proc);
+  std::filesystem::create_directory(proc / "self"); // (Not a PID: skipped)
+  AddProcess(proc, 1, "init");
+  AddProcess(proc, 100, "sscn-worker");
+
+  NotificationLog log;
+  ProcessScanNotifier notifier;
+  ProcessScanOptions options;
+  options.min_interval = std::chrono::milliseconds(5);
+  options.max_interval = std::chrono::milliseconds(20);
+  options.proc_path = proc.string();
+  notifier.Start({"sscn-worker", "sscn-missing"},
+                 SERVICE_NOTIFY_RUNNING | SERVICE_NOTIFY_STOPPED,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                 },
+                 options);
+
+  AddProcess(proc, 2, "unwatched");
+  std::filesystem::remove_all(proc / "100");
+  SSCN_CHECK(log.WaitFor("sscn-worker", SERVICE_NOTIFY_STOPPED));
+
+  AddProcess(proc, 200, "sscn-worker");
+  AddProcess(proc, 201, "sscn-worker");
+  SSCN_CHECK(log.WaitFor("sscn-worker", SERVICE_NOTIFY_RUNNING));
+  std::filesystem::remove_all(proc / "200"); // (201 still runs)
+  const auto scans{notifier.GetStatistics().scans};
+  while (notifier.GetStatistics().scans < scans + 3) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  notifier.Stop();
+
+  // (The initial states are not notified.)
+  SSCN_CHECK(log.Count("sscn-worker") == 2);
+  SSCN_CHECK(log.Count("sscn-missing") == 0);
+  SSCN_CHECK(notifier.GetStatistics().scans > 1);
+  return TestResult();
+}
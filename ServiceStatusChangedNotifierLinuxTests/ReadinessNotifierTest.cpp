@@ -0,0 +1,100 @@
+/*
+   ReadinessNotifierTest.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "LinuxTest.h"
+#include "ReadinessNotifier.h"
+
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace {
+
+// The service name: this process' comm (what the notifier matches senders
+// against).
+constexpr char kServiceName[]{"sscn-readiness"};
+
+// SendNotify
+// sd_notify(): one datagram to the notify socket.
+void SendNotify(const std::string &socket_path,
+                const std::string_view message) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+  const int fd{socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)};
+  [[maybe_unused]] const auto sent{
+      sendto(fd, message.data(), message.size(), 0,
+             reinterpret_cast<const sockaddr *>(&address), sizeof(address))};
+  close(fd);
+}
+
+} // namespace
+
+// READY=1 / STATUS= / a missed watchdog deadline / STOPPING=1, sent from
+// this process.
+int main() {
+  prctl(PR_SET_NAME, kServiceName);
+
+  const TemporaryDirectory directory;
+  const std::string socket_path{(directory.Path() / "notify").string()};
+
+  NotificationLog log;
+  std::string status; // (Of the RUNNING notification)
+  ReadinessNotifier notifier;
+  ReadinessOptions options;
+  options.watchdog_interval = std::chrono::milliseconds(100);
+  SSCN_CHECK(notifier.Start(
+      socket_path, {kServiceName, "other-service"},
+      SERVICE_NOTIFY_RUNNING | SERVICE_NOTIFY_STOP_PENDING |
+          SERVICE_NOTIFY_WATCHDOG_MISSED,
+      [&](const std::string &name, const std::uint32_t state,
+          const std::string_view status_text) {
+        if (state == SERVICE_NOTIFY_RUNNING) {
+          status = status_text;
+        }
+        log.Add(name, state);
+      },
+      options));
+
+  SendNotify(socket_path, "READY=1\nSTATUS=Serving");
+  SSCN_CHECK(log.WaitFor(kServiceName, SERVICE_NOTIFY_RUNNING));
+  SSCN_CHECK(status == "Serving");
+
+  // (READY=1 armed the watchdog; no WATCHDOG=1 follows.)
+  SSCN_CHECK(log.WaitFor(kServiceName, SERVICE_NOTIFY_WATCHDOG_MISSED));
+
+  SendNotify(socket_path, "STOPPING=1");
+  SSCN_CHECK(log.WaitFor(kServiceName, SERVICE_NOTIFY_STOP_PENDING));
+  notifier.Stop();
+
+  SSCN_CHECK(log.Count(kServiceName) == 3);
+  SSCN_CHECK(log.Count("other-service") == 0);
+  SSCN_CHECK(!std::filesystem::exists(socket_path)); // (Unlinked by Stop())
+  return TestResult();
+}
@@ -0,0 +1,275 @@
+/*
+   SupervisorStatusNotifierTest.cpp
+   Copyright (c) 2024, Amit Gefen
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "LinuxTest.h"
+#include "SupervisorStatusNotifier.h"
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace {
+
+// DaemontoolsStatus
+// 18 bytes: tai64na[12], pid[4] (little-endian), paused[1], want[1].
+std::vector<std::byte> DaemontoolsStatus(const std::uint32_t pid,
+                                         const bool paused) {
+  std::vector<std::byte> status(18);
+  for (std::size_t index{0}; index < 4; ++index) {
+    status[12 + index] = static_cast<std::byte>(pid >> (8 * index));
+  }
+  status[16] = static_cast<std::byte>(paused ? 1 : 0);
+  status[17] = static_cast<std::byte>('u');
+  return status;
+}
+
+// RunitStatus
+// 20 bytes: daemontools + term[1], state[1] (0 down, 1 run, 2 finish).
+std::vector<std::byte> RunitStatus(const std::uint32_t pid, const bool paused,
+                                   const std::uint8_t run_state) {
+  auto status{DaemontoolsStatus(pid, paused)};
+  status.push_back(std::byte{0});
+  status.push_back(static_cast<std::byte>(run_state));
+  return status;
+}
+
+// S6Status
+// 35 bytes: stamp[12], readystamp[12], pid[8] (big-endian), wstat[2],
+// flags[1]; 43 bytes (with_pgid): pgid[8] before wstat.
+std::vector<std::byte> S6Status(const std::uint64_t pid,
+                                const std::uint8_t flags,
+                                const bool with_pgid) {
+  std::vector<std::byte> status(24);
+  for (std::size_t index{0}; index < 8; ++index) {
+    status.push_back(static_cast<std::byte>(pid >> (8 * (7 - index))));
+  }
+  status.resize(status.size() + (with_pgid ? 8 : 0) + 2);
+  status.push_back(static_cast<std::byte>(flags));
+  return status;
+}
+
+std::uint32_t Decode(const std::vector<std::byte> &status) {
+  SupervisorStatus decoded;
+  return DecodeSupervisorStatus(status, decoded) ? decoded.current_state : 0;
+}
+
+// Every record layout and state of DecodeSupervisorStatus().
+void TestDecode() {
+  SSCN_CHECK(DaemontoolsStatus(42, false).size() == 18);
+  SSCN_CHECK(Decode(DaemontoolsStatus(42, false)) == SERVICE_NOTIFY_RUNNING);
+  SSCN_CHECK(Decode(DaemontoolsStatus(42, true)) == SERVICE_NOTIFY_PAUSED);
+  SSCN_CHECK(Decode(DaemontoolsStatus(0, false)) == SERVICE_NOTIFY_STOPPED);
+
+  SSCN_CHECK(RunitStatus(42, false, 1).size() == 20);
+  SSCN_CHECK(Decode(RunitStatus(42, false, 1)) == SERVICE_NOTIFY_RUNNING);
+  SSCN_CHECK(Decode(RunitStatus(42, true, 1)) == SERVICE_NOTIFY_PAUSED);
+  SSCN_CHECK(Decode(RunitStatus(0, false, 2)) == SERVICE_NOTIFY_STOP_PENDING);
+  SSCN_CHECK(Decode(RunitStatus(0, false, 0)) == SERVICE_NOTIFY_STOPPED);
+
+  for (const bool with_pgid : {false, true}) {
+    SSCN_CHECK(S6Status(42, 0x0, with_pgid).size() == (with_pgid ? 43U : 35U));
+    SSCN_CHECK(Decode(S6Status(42, 0x4 | 0x8, with_pgid)) ==
+               SERVICE_NOTIFY_RUNNING);
+    SSCN_CHECK(Decode(S6Status(42, 0x4, with_pgid)) ==
+               SERVICE_NOTIFY_START_PENDING);
+    SSCN_CHECK(Decode(S6Status(42, 0x1 | 0x8, with_pgid)) ==
+               SERVICE_NOTIFY_PAUSED);
+    SSCN_CHECK(Decode(S6Status(0, 0x2, with_pgid)) ==
+               SERVICE_NOTIFY_STOP_PENDING);
+    SSCN_CHECK(Decode(S6Status(0, 0x0, with_pgid)) == SERVICE_NOTIFY_STOPPED);
+  }
+
+  SupervisorStatus decoded;
+  SSCN_CHECK(!DecodeSupervisorStatus(std::vector<std::byte>(19), decoded));
+  SSCN_CHECK(!DecodeSupervisorStatus({}, decoded));
+
+  // (s6 pids are 64-bit big-endian; daemontools / runit 32-bit little-endian.)
+  SSCN_CHECK(DecodeSupervisorStatus(S6Status(0x0102030405, 0x8, true),
+                                    decoded) &&
+             decoded.pid == 0x0102030405);
+  SSCN_CHECK(DecodeSupervisorStatus(RunitStatus(0x01020304, false, 1),
+                                    decoded) &&
+             decoded.pid == 0x01020304);
+}
+
+// ReplaceStatus
+// Writes supervise/status the way the supervisors do: status.new, renamed.
+void ReplaceStatus(const std::string &service_directory,
+                   const std::vector<std::byte> &status) {
+  const auto supervise{std::filesystem::path(service_directory) / "supervise"};
+  WriteFile(supervise / "status.new",
+            {reinterpret_cast<const char *>(status.data()), status.size()});
+  std::filesystem::rename(supervise / "status.new", supervise / "status");
+}
+
+// The notifier over <tmp>/<svc>/supervise/status, one service per format.
+void TestNotifier() {
+  const TemporaryDirectory directory;
+  const std::string runit{(directory.Path() / "runit").string()};
+  const std::string daemontools{(directory.Path() / "daemontools").string()};
+  const std::string s6{(directory.Path() / "s6").string()};
+  for (const auto &service_directory : {runit, daemontools, s6}) {
+    std::filesystem::create_directories(service_directory + "/supervise");
+  }
+  ReplaceStatus(runit, RunitStatus(42, false, 1));
+  ReplaceStatus(daemontools, DaemontoolsStatus(43, false));
+  ReplaceStatus(s6, S6Status(44, 0x4 | 0x8, true));
+
+  NotificationLog log;
+  SupervisorStatusNotifier notifier;
+  notifier.Start({runit, daemontools, s6},
+                 SERVICE_NOTIFY_RUNNING | SERVICE_NOTIFY_STOPPED |
+                     SERVICE_NOTIFY_PAUSED | SERVICE_NOTIFY_STOP_PENDING |
+                     SERVICE_NOTIFY_START_PENDING,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                 });
+
+  ReplaceStatus(runit, RunitStatus(0, false, 2));
+  SSCN_CHECK(log.WaitFor(runit, SERVICE_NOTIFY_STOP_PENDING));
+  ReplaceStatus(runit, RunitStatus(0, false, 0));
+  SSCN_CHECK(log.WaitFor(runit, SERVICE_NOTIFY_STOPPED));
+
+  ReplaceStatus(daemontools, DaemontoolsStatus(43, true));
+  SSCN_CHECK(log.WaitFor(daemontools, SERVICE_NOTIFY_PAUSED));
+
+  ReplaceStatus(s6, S6Status(45, 0x4, false));
+  SSCN_CHECK(log.WaitFor(s6, SERVICE_NOTIFY_START_PENDING));
+  ReplaceStatus(s6, S6Status(45, 0x4 | 0x8, false));
+  SSCN_CHECK(log.WaitFor(s6, SERVICE_NOTIFY_RUNNING));
+  notifier.Stop();
+
+  // (The initial states are not notified.)
+  SSCN_CHECK(log.Count(runit) == 2);
+  SSCN_CHECK(log.Count(daemontools) == 1);
+  SSCN_CHECK(log.Count(s6) == 2);
+}
+
+// A removed supervise directory reports STOPPED; one created again (the
+// supervisor restarted) is watched again.
+void TestRemoval() {
+  const TemporaryDirectory directory;
+  const std::string service{(directory.Path() / "removed").string()};
+  std::filesystem::create_directories(service + "/supervise");
+  ReplaceStatus(service, RunitStatus(42, false, 1));
+
+  NotificationLog log;
+  SupervisorStatusNotifier notifier;
+  notifier.Start({service}, SERVICE_NOTIFY_RUNNING | SERVICE_NOTIFY_STOPPED,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                 });
+
+  std::filesystem::remove_all(service + "/supervise");
+  SSCN_CHECK(log.WaitFor(service, SERVICE_NOTIFY_STOPPED));
+
+  std::filesystem::create_directories(service + "/staging/supervise");
+  ReplaceStatus(service + "/staging", RunitStatus(43, false, 1));
+  std::filesystem::rename(service + "/staging/supervise",
+                          service + "/supervise");
+  SSCN_CHECK(log.WaitFor(service, SERVICE_NOTIFY_RUNNING));
+  ReplaceStatus(service, RunitStatus(0, false, 0));
+  SSCN_CHECK(log.WaitFor(service, SERVICE_NOTIFY_STOPPED, 2));
+  notifier.Stop();
+  SSCN_CHECK(log.Count(service) == 3);
+}
+
+// A service not supervised yet at Start() is watched from the moment its
+// supervisor creates the supervise directory.
+void TestLateSupervise() {
+  const TemporaryDirectory directory;
+  const std::string service{(directory.Path() / "late").string()};
+  const std::string missing{(directory.Path() / "missing").string()};
+  std::filesystem::create_directories(service);
+
+  NotificationLog log;
+  SupervisorStatusNotifier notifier;
+  notifier.Start({service, missing},
+                 SERVICE_NOTIFY_RUNNING | SERVICE_NOTIFY_STOPPED,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                 });
+
+  std::filesystem::create_directory(service + "/supervise");
+  ReplaceStatus(service, RunitStatus(42, false, 1));
+  SSCN_CHECK(log.WaitFor(service, SERVICE_NOTIFY_RUNNING));
+  ReplaceStatus(service, RunitStatus(0, false, 0));
+  SSCN_CHECK(log.WaitFor(service, SERVICE_NOTIFY_STOPPED));
+  notifier.Stop();
+  SSCN_CHECK(log.Count(service) == 2);
+  SSCN_CHECK(log.Count(missing) == 0);
+}
+
+// While the watcher thread is held in an action, the inotify queue overflows:
+// the status change of a service with no record queued is lost with it, and
+// found by the re-read of every status file that follows.
+void TestOverflow() {
+  const TemporaryDirectory directory;
+  const std::string blocker{(directory.Path() / "blocker").string()};
+  const std::string first{(directory.Path() / "first").string()};
+  const std::string second{(directory.Path() / "second").string()};
+  const std::string last{(directory.Path() / "last").string()};
+  for (const auto &service_directory : {blocker, first, second, last}) {
+    std::filesystem::create_directories(service_directory + "/supervise");
+    ReplaceStatus(service_directory, RunitStatus(42, false, 1));
+  }
+
+  NotificationLog log;
+  std::atomic<bool> released{false};
+  SupervisorStatusNotifier notifier;
+  notifier.Start({blocker, first, second, last},
+                 SERVICE_NOTIFY_RUNNING | SERVICE_NOTIFY_STOPPED,
+                 [&](const std::string &name, const std::uint32_t state) {
+                   log.Add(name, state);
+                   if (name == blocker) {
+                     released.wait(false); // (Holds the watcher thread)
+                   }
+                 });
+
+  ReplaceStatus(blocker, RunitStatus(0, false, 0));
+  SSCN_CHECK(log.WaitFor(blocker, SERVICE_NOTIFY_STOPPED));
+  for (int index{0}; index < 10000; ++index) {
+    ReplaceStatus(first, RunitStatus(42, false, 1)); // (2 records each)
+    ReplaceStatus(second, RunitStatus(42, false, 1));
+  }
+  ReplaceStatus(last, RunitStatus(0, false, 0)); // (No record queued: lost)
+  released = true;
+  released.notify_all();
+
+  SSCN_CHECK(log.WaitFor(last, SERVICE_NOTIFY_STOPPED));
+  notifier.Stop();
+  SSCN_CHECK(log.Count(first) == 0);
+  SSCN_CHECK(log.Count(second) == 0);
+}
+
+} // namespace
+
+int main() {
+  TestDecode();
+  TestNotifier();
+  TestRemoval();
+  TestLateSupervise();
+  TestOverflow();
+  return TestResult();
+}